@@ -8,6 +8,7 @@
  */
 #include "config.h"
 #include "platform_runtime.h"
+#include "config_store.h"
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
 extern int maxSpeed;
@@ -23,11 +24,10 @@ void load_config(std::string serie)
     serieSelected = false;
     etcsDialMaxSpeed = 400;
     stm_layout_file = "stm_windows.json";
-    auto contents = platform->read_file("config.json");
-    if (contents) {
-        json j = json::parse(*contents);
-        if (j.contains(serie)) {
-            json &cfg = j[serie];
+    ConfigStore::Document j = config_store.get("config.json");
+    if (j) {
+        if (j->contains(serie)) {
+            const json &cfg = (*j)[serie];
             etcsDialMaxSpeed = cfg.value("SpeedDial", 400);
             if (cfg.contains("STMLayout")) {
                 stm_layout_file = cfg["STMLayout"];
@@ -21,6 +21,7 @@
 #include "../../EVC/Packets/STM/38.h"
 #include "../../EVC/Packets/STM/39.h"
 #include "platform_runtime.h"
+#include "config_store.h"
 std::map<int, std::vector<int>> but_pos; 
 std::map<int, std::vector<int>> ind_pos;
 ntc_window *active_ntc_window;
@@ -69,14 +70,14 @@ void setup_areas()
 ntc_window::ntc_window(int nid_stm) : nid_stm(nid_stm)
 {
     customized = nullptr;
-    auto contents = platform->read_file(stm_layout_file);
-    if (contents) {
-        json j = json::parse(*contents);
-        for (json &stm : j["STM"])
+    ConfigStore::Document j = config_store.get(stm_layout_file);
+    if (j && j->contains("STM")) {
+        for (const json &stm : (*j)["STM"])
         {
-            if (stm["nid_stm"].get<int>() == nid_stm)
+            if (stm.value("nid_stm", -1) == nid_stm)
             {
-                customized = new customized_dmi(stm);
+                json layout = stm;
+                customized = new customized_dmi(layout);
                 break;
             }
         }
@@ -57,7 +57,7 @@ void setWindow(json &data)
         }
     }
     if (!data.contains("ActiveWindow")) return;
-    json j = data["ActiveWindow"];
+    json &j = data["ActiveWindow"];
     subwindow *w = nullptr;
     std::string name = j["active"].get<std::string>();
     if (name == "default")
@@ -47,6 +47,11 @@ void present_request()
     platform->set_color(DarkBlue);
     platform->draw_rect_filled(0, 0, 640, 480);
     displayETCS();
+    // Asked for before presenting, since a platform may complete the
+    // frame within present()
+    uint32_t update = status_drawn();
+    if (update != 0)
+        platform->on_present_completed().then([update]() { status_presented(update); }).detach();
     platform->present();
     platform->on_present_request().then(present_request).detach();
 }
@@ -27,7 +27,7 @@ void set_language(std::string lang)
     if (lang == "en" || lang == "") {
         language = "en";
     } else {
-        auto contents = platform->read_file("locales/dmi/" + lang + ".mo");
+        auto contents = platform->map_file("locales/dmi/" + lang + ".mo");
         reader.ClearTable();
         if (!contents || reader.ParseData(*contents) != moFileLib::moFileReader::EC_SUCCESS) {
             platform->debug_print(reader.GetErrorDescription());
@@ -24,6 +24,8 @@
 #include "../Config/config.h"
 #include "../softkeys/softkey.h"
 #include "platform_runtime.h"
+#include "config_store.h"
+#include "status_reader.h"
 
 int WallClockTime::hour;
 int WallClockTime::minute;
@@ -40,16 +42,6 @@ void fill_non_existent(json &j, std::string str, std::nullptr_t null)
 {
     if (!j.contains("str")) j[str] = nullptr;
 }
-void from_json(const json&j, speed_element &e)
-{
-    e.distance = j["DistanceToTrainM"].get<double>();
-    e.speed = std::round(j["TargetSpeedMpS"].get<double>()*3.6);
-}
-void from_json(const json&j, gradient_element &e)
-{
-    e.distance = j["DistanceToTrainM"].get<double>();
-    e.val = j["GradientPerMille"].get<double>();
-}
 enum struct TrackConditionType
 {
     Custom,
@@ -81,11 +73,8 @@ enum struct TractionSystem
     DC1500V,
     DC750V
 };
-void from_json(const json&j, planning_element &e)
+static int planning_texture(TrackConditionType type, bool yellow, TractionSystem traction)
 {
-    e.distance = j["DistanceToTrainM"].get<double>();
-    TrackConditionType type = (TrackConditionType)j["Type"].get<int>();
-    bool yellow = j["YellowColour"].get<bool>();
     int tex = 0;
     switch(type)
     {
@@ -125,8 +114,7 @@ void from_json(const json&j, planning_element &e)
         case TrackConditionType::SoundHorn:
             tex = 24;
             break;
-        case TrackConditionType::TractionSystemChange:{
-            TractionSystem traction = (TractionSystem)j["TractionSystem"].get<int>();
+        case TrackConditionType::TractionSystemChange:
             switch(traction)
             {
                 case TractionSystem::NonFitted:
@@ -150,7 +138,7 @@ void from_json(const json&j, planning_element &e)
                 default:
                     break;
             }
-            break;}
+            break;
         case TrackConditionType::Tunnel:
             tex = 40;
             break;
@@ -166,8 +154,96 @@ void from_json(const json&j, planning_element &e)
         default:
             break;
     }
-    e.condition = tex;
+    return tex;
+}
+// Update not drawn yet
+static uint32_t undrawn_update;
+// Takes the update the frame being drawn shows, 0 if none is new
+uint32_t status_drawn()
+{
+    uint32_t update = undrawn_update;
+    undrawn_update = 0;
+    return update;
+}
+void status_presented(uint32_t update)
+{
+    write_command("presented", std::to_string(update));
+}
+static void apply_status(const dmi_status &s)
+{
+    undrawn_update = s.update_id;
+    if (level != Level::NTC || (mode != Mode::SN && mode != Mode::NL))
+    {
+        Vperm = (int)(s.allowed_speed*3.6+0.01);
+        Vtarget = round(s.target_speed*3.6);
+        Vsbi = (int)(s.intervention_speed*3.6+0.01);
+        Dtarg = round(s.target_distance);
+        Vrelease = round(s.release_speed*3.6);
+    }
+    Vest = s.speed*3.6;
+    TTP = s.time_to_permitted;
+    TTI = s.time_to_indication;
+    setMonitor((MonitoringStatus)s.monitoring);
+    setSupervision((SupervisionStatus)s.supervision);
+    mode = (Mode)s.mode;
+    level = (Level)s.level;
+    slippery_rail = s.slippery_rail;
+    bot_driver = s.bot_driver;
+    if (level == Level::NTC) nid_ntc = s.ntc;
+    pk = s.geographical_position ? *s.geographical_position : -1;
+    WallClockTime::hour = s.hour;
+    WallClockTime::minute = s.minute;
+    WallClockTime::second = s.second;
+    if (s.mode_acknowledgement)
+    {
+        ackMode = (Mode)*s.mode_acknowledgement;
+        setAck(AckType::Mode, 0, true);
+    }
+    else
+    {
+        setAck(AckType::Mode, 0, false);
+    }
+    if (s.level_transition)
+    {
+        ackLevel = (Level)s.level_transition->level;
+        if (ackLevel == Level::NTC) ackNTC = s.level_transition->ntc;
+        setAck(AckType::Level, s.level_transition->acknowledge+1, true);
+    }
+    else
+    {
+        setAck(AckType::Level, 0, false);
+    }
+    ovEOA = s.override_active;
+    radioStatus = s.radio_status;
+    EB = SB = s.brake_commanded;
+    extern bool display_taf;
+    display_taf = s.display_taf;
+    if (s.lssma) setLSSMA((int)(*s.lssma*3.6 + 0.01));
+    else setLSSMA(-1);
+    extern bool ackAllowed;
+    ackAllowed = s.allowed_ack;
+    setAck(AckType::Brake, 0, s.brake_acknowledge);
+    {
+        speed_elements.clear();
+        for (auto &e : s.speed_targets)
+            speed_elements.push_back({(int)std::round(e.speed*3.6), (float)e.distance});
+        imarker.start_distance = s.indication_marker_distance ? *s.indication_marker_distance : 0;
+        if (s.indication_marker_target)
+            imarker.element = {(int)std::round(s.indication_marker_target->speed*3.6), (float)s.indication_marker_target->distance};
+        gradient_elements.clear();
+        for (auto &e : s.gradients)
+            gradient_elements.push_back({e.value, (float)e.distance});
+        planning_elements.clear();
+        for (auto &e : s.track_conditions)
+            planning_elements.push_back({planning_texture((TrackConditionType)e.type, e.yellow, (TractionSystem)e.traction), (float)e.distance});
+    }
+    {
+        void updateTc(std::set<int> &syms);
+        std::set<int> syms(s.active_track_conditions.begin(), s.active_track_conditions.end());
+        updateTc(syms);
+    }
 }
+dmi_status_decoder status_decoder;
 void parseData(std::string str)
 {
     int index = str.find_first_of('(');
@@ -232,82 +308,19 @@ void parseData(std::string str)
         if (command[3] == 'F') softF[stoi(command.substr(4, 1))].setPressed(value == "1" || value == "true");
         else if (command[3] == 'H') softH[stoi(command.substr(4, 1))].setPressed(value == "1" || value == "true");
     }
-    if (command != "json") return;
-    json j = json::parse(value);
-    setWindow(j);
-    if (!j.contains("Status")) return;
-    j = j["Status"];
-    /*fill_non_existent(j, "TargetSpeedMpS", 1000);
-    fill_non_existent(j, "ReleaseSpeedMpS", 0);
-    fill_non_existent(j, "ModeAcknowledgement", nullptr);
-    fill_non_existent(j, "LevelTransition", nullptr);*/
-    if (level != Level::NTC || (mode != Mode::SN && mode != Mode::NL))
-    {
-        Vperm = (int)(j["AllowedSpeedMpS"].get<double>()*3.6+0.01);
-        Vtarget = round(j["TargetSpeedMpS"].get<double>()*3.6);
-        Vsbi = (int)(j["InterventionSpeedMpS"].get<double>()*3.6+0.01);
-        Dtarg = round(j["TargetDistanceM"].get<double>());
-        Vrelease = round(j["ReleaseSpeedMpS"].get<double>()*3.6);
-    }
-    Vest = j["SpeedMpS"].get<double>()*3.6;
-    TTP = j["TimeToPermittedS"].get<double>();
-    TTI = j["TimeToIndicationS"].get<double>();
-    setMonitor((MonitoringStatus)j["CurrentMonitoringStatus"].get<int>());
-    setSupervision((SupervisionStatus)j["CurrentSupervisionStatus"].get<int>());
-    mode = (Mode)j["CurrentMode"].get<int>();
-    level = (Level)j["CurrentLevel"].get<int>();
-    slippery_rail = j["SlipperyRail"].get<bool>();
-    bot_driver = j["BotDriver"].get<bool>();
-    if (level == Level::NTC) nid_ntc = j["CurrentNTC"].get<int>();
-    if (j["GeographicalPositionKM"].is_null()) pk = -1;
-    else pk = j["GeographicalPositionKM"].get<double>();
-    json &clock = j["WallClockTime"];
-    WallClockTime::hour = clock["Hour"];
-    WallClockTime::minute = clock["Minute"];
-    WallClockTime::second = clock["Second"];
-    if (!j["ModeAcknowledgement"].is_null())
-    {
-        ackMode = (Mode)j["ModeAcknowledgement"].get<int>();
-        setAck(AckType::Mode, 0, true);
-    }
-    else
-    {
-        setAck(AckType::Mode, 0, false);
-    }
-    if (!j["LevelTransition"].is_null())
+    else if (command == "status")
     {
-        ackLevel = (Level)j["LevelTransition"]["Level"].get<int>();
-        if (ackLevel == Level::NTC) ackNTC = j["LevelTransition"]["NTC"].get<int>();
-        setAck(AckType::Level, j["LevelTransition"]["Acknowledge"].get<bool>()+1, true);
-    }
-    else
-    {
-        setAck(AckType::Level, 0, false);
-    }
-    ovEOA = j["OverrideActive"].get<bool>();
-    radioStatus = j["RadioStatus"].get<int>();
-    EB = SB = j["BrakeCommanded"].get<bool>();
-    extern bool display_taf;
-    display_taf = j["DisplayTAF"].get<bool>();
-    if (j.contains("LSSMA")) setLSSMA((int)(j["LSSMA"].get<double>()*3.6 + 0.01));
-    else setLSSMA(-1);
-    extern bool ackAllowed;
-    ackAllowed = j.contains("AllowedAck") && j["AllowedAck"];
-    setAck(AckType::Brake, 0, j["BrakeAcknowledge"].get<bool>());
-    {
-        speed_elements = j["SpeedTargets"].get<std::vector<speed_element>>();
-        if (j["IndicationMarkerDistanceM"].is_null()) imarker.start_distance = 0;
-        else imarker.start_distance = j["IndicationMarkerDistanceM"].get<double>();
-        if (!j["IndicationMarkerTarget"].is_null()) imarker.element = j["IndicationMarkerTarget"].get<speed_element>();
-        gradient_elements = j["GradientProfile"].get<std::vector<gradient_element>>();
-        planning_elements = j["PlanningTrackConditions"].get<std::vector<planning_element>>();
-        
-    }
-    {
-        void updateTc(std::set<int> &syms);
-        std::set<int> syms = j["ActiveTrackConditions"].get<std::set<int>>();
-        updateTc(syms);
+        dmi_status status;
+        if (status_decoder.decode(value, status))
+            apply_status(status);
     }
+    if (command != "json") return;
+    dmi_status status;
+    bool has_status;
+    json j;
+    if (!read_status_json(value, status, has_status, j)) return;
+    setWindow(j);
+    if (has_status) apply_status(status);
 }
 std::unique_ptr<BasePlatform::BusSocket> evc_socket;
 uint32_t evc_peer;
@@ -317,13 +330,18 @@ void data_received(BasePlatform::BusSocket::ReceiveResult &&result)
 
     if (std::holds_alternative<BasePlatform::BusSocket::JoinNotification>(result)) {
         auto &join = std::get<BasePlatform::BusSocket::JoinNotification>(result);
-        if (!evc_peer && join.peer.tid == BasePlatform::BusSocket::PeerId::fourcc("EVC"))
+        if (!evc_peer && join.peer.tid == BasePlatform::BusSocket::PeerId::fourcc("EVC")) {
             evc_peer = join.peer.uid;
+            // Ask for the binary status instead of JSON
+            status_decoder.reset();
+            evc_socket->send_to(evc_peer, "protocol(" + std::to_string(DMI_STATUS_VERSION) + ")");
+        }
     }
     if (std::holds_alternative<BasePlatform::BusSocket::LeaveNotification>(result)) {
         auto &leave = std::get<BasePlatform::BusSocket::LeaveNotification>(result);
         if (leave.peer.uid == evc_peer) {
             evc_peer = 0;
+            config_store.reload();
             load_config({});
             revokeMessages();
         }
@@ -8,7 +8,12 @@
  */
 #ifndef _SERVER_H
 #define _SERVER_H
+#include <cstdint>
 #include <string>
 void startSocket();
 void write_command(std::string command, std::string value);
+// Update id of a status shown for the first time in the frame being drawn,
+// or 0, and the reply to the EVC once that frame is on screen
+uint32_t status_drawn();
+void status_presented(uint32_t update);
 #endif
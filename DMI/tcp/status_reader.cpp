@@ -0,0 +1,327 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <vector>
+#include "status_reader.h"
+// Where the reader is inside the document
+enum struct status_scope
+{
+    Root,
+    Status,
+    LevelTransition,
+    WallClockTime,
+    IndicationMarkerTarget,
+    SpeedTargets,
+    SpeedTarget,
+    GradientProfile,
+    Gradient,
+    PlanningTrackConditions,
+    TrackCondition,
+    ActiveTrackConditions,
+    // Members copied into the rest document
+    Copy,
+    // Anything the DMI does not use, such as TextMessages
+    Skip,
+};
+// Handler for json::sax_parse(). Members are matched by name as they come,
+// and values are stored directly in their place in dmi_status.
+class status_sax
+{
+    dmi_status &s;
+    bool &has_status;
+    json &rest;
+    std::vector<status_scope> scopes;
+    // Containers being copied into rest, innermost last
+    std::vector<json*> copies;
+    // Name of the member being read
+    std::string name;
+    void status_number(double v);
+    void status_boolean(bool v);
+    void status_null();
+    void number(double v);
+    void flag(bool v);
+    void value(json &&v);
+    bool open(bool array);
+public:
+    status_sax(dmi_status &status, bool &has_status, json &rest) : s(status), has_status(has_status), rest(rest) {}
+    bool null()
+    {
+        if (!scopes.empty() && scopes.back() == status_scope::Status)
+            status_null();
+        else
+            value(nullptr);
+        return true;
+    }
+    bool boolean(bool v)
+    {
+        if (!scopes.empty() && (scopes.back() == status_scope::Root || scopes.back() == status_scope::Copy))
+            value(v);
+        else
+            flag(v);
+        return true;
+    }
+    bool number_integer(json::number_integer_t v)
+    {
+        if (!scopes.empty() && (scopes.back() == status_scope::Root || scopes.back() == status_scope::Copy))
+            value(v);
+        else
+            number((double)v);
+        return true;
+    }
+    bool number_unsigned(json::number_unsigned_t v)
+    {
+        if (!scopes.empty() && (scopes.back() == status_scope::Root || scopes.back() == status_scope::Copy))
+            value(v);
+        else
+            number((double)v);
+        return true;
+    }
+    bool number_float(json::number_float_t v, const json::string_t &)
+    {
+        if (!scopes.empty() && (scopes.back() == status_scope::Root || scopes.back() == status_scope::Copy))
+            value(v);
+        else
+            number(v);
+        return true;
+    }
+    bool string(json::string_t &v)
+    {
+        value(std::move(v));
+        return true;
+    }
+    bool binary(json::binary_t &)
+    {
+        return true;
+    }
+    bool key(json::string_t &k)
+    {
+        name = std::move(k);
+        return true;
+    }
+    bool start_object(std::size_t)
+    {
+        return open(false);
+    }
+    bool start_array(std::size_t)
+    {
+        return open(true);
+    }
+    bool end_object()
+    {
+        if (scopes.back() == status_scope::Copy)
+            copies.pop_back();
+        scopes.pop_back();
+        return true;
+    }
+    bool end_array()
+    {
+        return end_object();
+    }
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &)
+    {
+        return false;
+    }
+};
+// Values that are only copied, or thrown away
+void status_sax::value(json &&v)
+{
+    if (scopes.empty())
+        return;
+    if (scopes.back() == status_scope::Root) {
+        rest[name] = std::move(v);
+    } else if (scopes.back() == status_scope::Copy) {
+        json &parent = *copies.back();
+        if (parent.is_array())
+            parent.push_back(std::move(v));
+        else
+            parent[name] = std::move(v);
+    }
+}
+bool status_sax::open(bool array)
+{
+    status_scope scope = status_scope::Skip;
+    json *copy = nullptr;
+    if (scopes.empty()) {
+        scope = array ? status_scope::Skip : status_scope::Root;
+    } else {
+        switch (scopes.back()) {
+            case status_scope::Root:
+                if (name == "Status" && !array) {
+                    scope = status_scope::Status;
+                    has_status = true;
+                } else {
+                    scope = status_scope::Copy;
+                    copy = &(rest[name] = array ? json::array() : json::object());
+                }
+                break;
+            case status_scope::Copy: {
+                json &parent = *copies.back();
+                json child = array ? json::array() : json::object();
+                if (parent.is_array()) {
+                    parent.push_back(std::move(child));
+                    copy = &parent.back();
+                } else {
+                    copy = &(parent[name] = std::move(child));
+                }
+                scope = status_scope::Copy;
+                break;
+            }
+            case status_scope::Status:
+                if (!array && name == "LevelTransition") {
+                    s.level_transition = dmi_status::level_change{0, 0, false};
+                    scope = status_scope::LevelTransition;
+                } else if (!array && name == "WallClockTime") {
+                    scope = status_scope::WallClockTime;
+                } else if (!array && name == "IndicationMarkerTarget") {
+                    s.indication_marker_target = dmi_status::speed_target{0, 0};
+                    scope = status_scope::IndicationMarkerTarget;
+                } else if (array && name == "SpeedTargets") {
+                    s.speed_targets.clear();
+                    scope = status_scope::SpeedTargets;
+                } else if (array && name == "GradientProfile") {
+                    s.gradients.clear();
+                    scope = status_scope::GradientProfile;
+                } else if (array && name == "PlanningTrackConditions") {
+                    s.track_conditions.clear();
+                    scope = status_scope::PlanningTrackConditions;
+                } else if (array && name == "ActiveTrackConditions") {
+                    s.active_track_conditions.clear();
+                    scope = status_scope::ActiveTrackConditions;
+                }
+                break;
+            case status_scope::SpeedTargets:
+                if (!array) {
+                    s.speed_targets.push_back({0, 0});
+                    scope = status_scope::SpeedTarget;
+                }
+                break;
+            case status_scope::GradientProfile:
+                if (!array) {
+                    s.gradients.push_back({0, 0});
+                    scope = status_scope::Gradient;
+                }
+                break;
+            case status_scope::PlanningTrackConditions:
+                if (!array) {
+                    s.track_conditions.push_back({0, 0, false, 0});
+                    scope = status_scope::TrackCondition;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    scopes.push_back(scope);
+    if (copy != nullptr)
+        copies.push_back(copy);
+    return true;
+}
+void status_sax::status_number(double v)
+{
+    if (name == "SpeedMpS") s.speed = v;
+    else if (name == "AllowedSpeedMpS") s.allowed_speed = v;
+    else if (name == "InterventionSpeedMpS") s.intervention_speed = v;
+    else if (name == "TargetSpeedMpS") s.target_speed = v;
+    else if (name == "TargetDistanceM") s.target_distance = v;
+    else if (name == "ReleaseSpeedMpS") s.release_speed = v;
+    else if (name == "TimeToPermittedS") s.time_to_permitted = v;
+    else if (name == "TimeToIndicationS") s.time_to_indication = v;
+    else if (name == "CurrentMonitoringStatus") s.monitoring = (int)v;
+    else if (name == "CurrentSupervisionStatus") s.supervision = (int)v;
+    else if (name == "CurrentMode") s.mode = (int)v;
+    else if (name == "CurrentLevel") s.level = (int)v;
+    else if (name == "CurrentNTC") s.ntc = (int)v;
+    else if (name == "RadioStatus") s.radio_status = (int)v;
+    else if (name == "ModeAcknowledgement") s.mode_acknowledgement = (int)v;
+    else if (name == "GeographicalPositionKM") s.geographical_position = v;
+    else if (name == "LSSMA") s.lssma = v;
+    else if (name == "IndicationMarkerDistanceM") s.indication_marker_distance = v;
+    else if (name == "UpdateId") s.update_id = (uint32_t)v;
+}
+void status_sax::status_boolean(bool v)
+{
+    if (name == "BotDriver") s.bot_driver = v;
+    else if (name == "SlipperyRail") s.slippery_rail = v;
+    else if (name == "OverrideActive") s.override_active = v;
+    else if (name == "BrakeCommanded") s.brake_commanded = v;
+    else if (name == "BrakeAcknowledge") s.brake_acknowledge = v;
+    else if (name == "DisplayTAF") s.display_taf = v;
+    else if (name == "AllowedAck") s.allowed_ack = v;
+    else if (name == "ReversingPermitted") s.reversing_permitted = v;
+}
+void status_sax::status_null()
+{
+    if (name == "ModeAcknowledgement") s.mode_acknowledgement.reset();
+    else if (name == "LevelTransition") s.level_transition.reset();
+    else if (name == "GeographicalPositionKM") s.geographical_position.reset();
+    else if (name == "IndicationMarkerTarget") s.indication_marker_target.reset();
+    else if (name == "IndicationMarkerDistanceM") s.indication_marker_distance.reset();
+    else if (name == "LSSMA") s.lssma.reset();
+}
+void status_sax::number(double v)
+{
+    switch (scopes.empty() ? status_scope::Skip : scopes.back()) {
+        case status_scope::Status:
+            status_number(v);
+            break;
+        case status_scope::LevelTransition:
+            if (name == "Level") s.level_transition->level = (int)v;
+            else if (name == "NTC") s.level_transition->ntc = (int)v;
+            break;
+        case status_scope::WallClockTime:
+            if (name == "Hour") s.hour = (int)v;
+            else if (name == "Minute") s.minute = (int)v;
+            else if (name == "Second") s.second = (int)v;
+            break;
+        case status_scope::IndicationMarkerTarget:
+            if (name == "DistanceToTrainM") s.indication_marker_target->distance = v;
+            else if (name == "TargetSpeedMpS") s.indication_marker_target->speed = v;
+            break;
+        case status_scope::SpeedTarget:
+            if (name == "DistanceToTrainM") s.speed_targets.back().distance = v;
+            else if (name == "TargetSpeedMpS") s.speed_targets.back().speed = v;
+            break;
+        case status_scope::Gradient:
+            if (name == "DistanceToTrainM") s.gradients.back().distance = v;
+            else if (name == "GradientPerMille") s.gradients.back().value = (int)v;
+            break;
+        case status_scope::TrackCondition:
+            if (name == "DistanceToTrainM") s.track_conditions.back().distance = v;
+            else if (name == "Type") s.track_conditions.back().type = (int)v;
+            else if (name == "TractionSystem") s.track_conditions.back().traction = (int)v;
+            break;
+        case status_scope::ActiveTrackConditions:
+            s.active_track_conditions.push_back((int)v);
+            break;
+        default:
+            break;
+    }
+}
+void status_sax::flag(bool v)
+{
+    switch (scopes.empty() ? status_scope::Skip : scopes.back()) {
+        case status_scope::Status:
+            status_boolean(v);
+            break;
+        case status_scope::LevelTransition:
+            if (name == "Acknowledge") s.level_transition->acknowledge = v;
+            break;
+        case status_scope::TrackCondition:
+            if (name == "YellowColour") s.track_conditions.back().yellow = v;
+            break;
+        default:
+            break;
+    }
+}
+bool read_status_json(std::string_view text, dmi_status &status, bool &has_status, json &rest)
+{
+    has_status = false;
+    rest = json::object();
+    status_sax sax(status, has_status, rest);
+    return json::sax_parse(text.begin(), text.end(), &sax);
+}
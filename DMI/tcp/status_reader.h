@@ -0,0 +1,21 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#ifndef _STATUS_READER_H
+#define _STATUS_READER_H
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "../../EVC/DMI/dmi_status.h"
+using json = nlohmann::json;
+// Reads the argument of a json(...) command from the EVC in one pass.
+// The Status member goes straight into status, without building a
+// document for it, and has_status tells whether it was there. Every other
+// member, such as ActiveWindow, is copied into rest. Returns false if the
+// text is not valid JSON.
+bool read_status_json(std::string_view text, dmi_status &status, bool &has_status, json &rest);
+#endif
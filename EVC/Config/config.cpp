@@ -15,7 +15,7 @@
 #include "../Supervision/locomotive_data.h"
 #include <orts/common.h>
 #include <nlohmann/json.hpp>
-#include "platform_runtime.h"
+#include "config_store.h"
 using json = nlohmann::json;
 extern ORserver::ParameterManager manager;
 extern std::string traindata_file;
@@ -29,19 +29,19 @@ extern bool message_when_driver_ack_level;
 extern bool message_when_driver_ack_mode;
 extern bool message_when_driver_ack_mode;
 extern bool entering_mode_message_is_time_dependent;
+extern int dmi_min_update_interval;
 extern std::map<std::string, std::string> const_train_data;
 extern std::map<std::string, std::vector<std::string>> custom_train_data_inputs;
+static std::string loaded_serie;
 
 void load_config(std::string serie)
 {
+	loaded_serie = serie;
 	traindata_file = "traindata.json";
 	data_entry_type = 0;
-	json j;
-	auto contents = platform->read_file("config.json");
-	if (contents)
-		j = json::parse(*contents);
-	if (j.contains(serie)) {
-		json& cfg = j[serie];
+	ConfigStore::Document j = config_store.get("config.json");
+	if (j && j->contains(serie)) {
+		const json& cfg = (*j)[serie];
 		if (cfg.contains("TrainData")) {
 			traindata_file = cfg["TrainData"];
 			if (data_entry_type_tiu >= 0)
@@ -60,20 +60,21 @@ void load_config(std::string serie)
 		message_when_driver_ack_mode = cfg.value("MessageWhenModeAck", false);
 		message_when_driver_ack_level = cfg.value("MessageWhenLevelAck", false);
 		entering_mode_message_is_time_dependent = cfg.value("EnteringModeMessageIsTimeDependent", false);
+		dmi_min_update_interval = cfg.value("DMIMinUpdateInterval", 20);
 		const_train_data.clear();
 		if (cfg.contains("ConstTrainDataValues"))
 		{
-			for (json& j : cfg["ConstTrainDataValues"])
+			for (const json& j : cfg["ConstTrainDataValues"])
 			{
-				const_train_data[j["Field"].get<std::string>()] = j["Value"].get<std::string>();
+				const_train_data[j.at("Field").get<std::string>()] = j.at("Value").get<std::string>();
 			}
 		}
 		custom_train_data_inputs.clear();
 		if (cfg.contains("CustomTrainDataInputs"))
 		{
-			for (json& j : cfg["CustomTrainDataInputs"])
+			for (const json& j : cfg["CustomTrainDataInputs"])
 			{
-				custom_train_data_inputs[j["Field"].get<std::string>()] = j["Value"].get<std::vector<std::string>>();
+				custom_train_data_inputs[j.at("Field").get<std::string>()] = j.at("Value").get<std::vector<std::string>>();
 			}
 		}
 		ntc_available_no_stm.clear();
@@ -120,9 +121,9 @@ void load_config(std::string serie)
 		}
 		ntc_to_stm_lookup_table.clear();
 		if (cfg.contains("STMPriorityTable")) {
-			for (json& j : cfg["STMPriorityTable"])
+			for (const json& j : cfg["STMPriorityTable"])
 			{
-				ntc_to_stm_lookup_table[j["nid_ntc"].get<int>()] = j["nid_stms"].get<std::vector<int>>();
+				ntc_to_stm_lookup_table[j.at("nid_ntc").get<int>()] = j.at("nid_stms").get<std::vector<int>>();
 			}
 		}
 		traction_cutoff_implemented = cfg.value("TractionCutOffImplemented", true);
@@ -140,4 +141,8 @@ void load_config(std::string serie)
 		L_locomotive = cfg.value("RearCabOffset", 0.0);
 	}
 	set_persistent_command("setSerie", serie);
+}
+void reload_config()
+{
+	load_config(loaded_serie);
 }
\ No newline at end of file
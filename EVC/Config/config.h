@@ -8,4 +8,5 @@
  */
 #pragma once
 #include <string>
-void load_config(std::string serie);
\ No newline at end of file
+void load_config(std::string serie);
+void reload_config();
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <list>
 #include <algorithm>
 #include <map>
+#include <deque>
+#include <tuple>
 #include "../language/language.h"
 #include "../Supervision/supervision.h"
 #include "../Supervision/supervision_targets.h"
@@ -32,7 +34,9 @@
 #include "text_message.h"
 #include "windows.h"
 #include "acks.h"
+#include "dmi_status.h"
 #include "platform_runtime.h"
+#include "bus_metrics.h"
 
 using std::map;
 using std::set;
@@ -41,10 +45,36 @@ using std::string;
 using std::to_string;
 int dmi_pid;
 std::unique_ptr<BasePlatform::BusSocket> dmi_socket;
+// Connected DMIs, and those that negotiated the binary status
+std::set<uint32_t> dmi_peers;
+std::set<uint32_t> binary_dmi_peers;
+dmi_status_encoder status_encoder;
+std::string last_window_dmi;
+// Status is pushed as soon as something the driver must see changes, but
+// never more often than this. Set by DMIMinUpdateInterval in config.json.
+int dmi_min_update_interval = 20;
+int64_t last_dmi_update;
+// Time at which a change not yet sent was detected, or -1
+int64_t dmi_change_time = -1;
+bool dmi_push_scheduled;
+// Updates waiting for the DMI to report them presented, with the time
+// the state they carry was taken and whether they were pushed by a change
+struct dmi_sent_update
+{
+    uint32_t id;
+    int64_t state_time;
+    bool change;
+};
+std::deque<dmi_sent_update> dmi_sent_updates;
+uint32_t dmi_update_id;
+Log2Histogram dmi_change_latency;
+Log2Histogram dmi_update_latency;
+int64_t last_latency_report;
 void dmi_receive(BasePlatform::BusSocket::JoinNotification &&msg);
 void dmi_receive(BasePlatform::BusSocket::LeaveNotification &&msg);
 void dmi_receive(BasePlatform::BusSocket::Message &&msg);
 void dmi_update_func();
+void send_dmi_status();
 void sim_write_line(const std::string &str);
 void dmi_receive_handler(BasePlatform::BusSocket::ReceiveResult &&result)
 {
@@ -212,6 +242,7 @@ std::map<string, string> persistent_commands;
 void dmi_receive(BasePlatform::BusSocket::JoinNotification &&msg)
 {
     if (msg.peer.tid == BasePlatform::BusSocket::PeerId::fourcc("DMI")) {
+        dmi_peers.insert(msg.peer.uid);
         for (const auto &entry : persistent_commands)
             dmi_socket->send_to(msg.peer.uid, entry.first+"("+entry.second+")");
         for (auto &t : messages) {
@@ -220,9 +251,38 @@ void dmi_receive(BasePlatform::BusSocket::JoinNotification &&msg)
     }
 }
 void dmi_receive(BasePlatform::BusSocket::LeaveNotification &&msg) {
+    dmi_peers.erase(msg.peer.uid);
+    binary_dmi_peers.erase(msg.peer.uid);
 }
 void dmi_receive(BasePlatform::BusSocket::Message &&msg)
 {
+    if (msg.data.rfind("presented(", 0) == 0) {
+        // State-to-pixel latency, including the way back over the bus
+        uint32_t id = strtoul(msg.data.c_str() + 10, nullptr, 10);
+        int64_t now = get_milliseconds();
+        for (auto &u : dmi_sent_updates) {
+            if (u.id != id)
+                continue;
+            dmi_update_latency.add(now - u.state_time);
+            if (u.change)
+                dmi_change_latency.add(now - u.state_time);
+            break;
+        }
+        if (now - last_latency_report > 60000) {
+            last_latency_report = now;
+            platform->debug_print("DMI latency: changes " + dmi_change_latency.to_string("ms") + ", all updates " + dmi_update_latency.to_string("ms"));
+        }
+        return;
+    }
+    if (msg.data.rfind("protocol(", 0) == 0) {
+        // Sent by DMIs able to decode the binary status
+        if (dmi_peers.count(msg.peer.uid) && msg.data == "protocol(" + std::to_string(DMI_STATUS_VERSION) + ")") {
+            binary_dmi_peers.insert(msg.peer.uid);
+            status_encoder.reset();
+            last_window_dmi.clear();
+        }
+        return;
+    }
     parse_command(std::move(msg.data));
 }
 bool sendtoor=false;
@@ -240,32 +300,22 @@ void send_command(string command, string value)
         sim_write_line("noretain(etcs::dmi::command="+command+"("+value+"))");
 }
 double calc_ceiling_limit();
-struct speed_element
+void to_json(json&j, const dmi_status::speed_target &e)
 {
-    double Distance;
-    double Speed;
-};
-struct gradient_element
-{
-    double Distance;
-    int Gradient;
-};
-void to_json(json&j, const speed_element &e)
-{
-    j["DistanceToTrainM"] = e.Distance;
-    j["TargetSpeedMpS"] = e.Speed;
+    j["DistanceToTrainM"] = e.distance;
+    j["TargetSpeedMpS"] = e.speed;
 }
-void to_json(json&j, const gradient_element &e)
+void to_json(json&j, const dmi_status::gradient &e)
 {
-    j["DistanceToTrainM"] = e.Distance;
-    j["GradientPerMille"] = e.Gradient;
+    j["DistanceToTrainM"] = e.distance;
+    j["GradientPerMille"] = e.value;
 }
-void to_json(json&j, const PlanningTrackCondition &e)
+void to_json(json&j, const dmi_status::track_condition &e)
 {
-    j["DistanceToTrainM"] = e.DistanceToTrainM;
-    j["YellowColour"] = e.YellowColour;
-    j["Type"] = e.Type;
-    j["TractionSystem"] = e.TractionSystem;
+    j["DistanceToTrainM"] = e.distance;
+    j["YellowColour"] = e.yellow;
+    j["Type"] = e.type;
+    j["TractionSystem"] = e.traction;
 }
 void to_json(json&j, const text_message &t)
 {
@@ -273,139 +323,210 @@ void to_json(json&j, const text_message &t)
     j["FirstGroup"] = t.firstGroup;
     j["Acknowledge"] = t.ack;
 }
-void dmi_update_func()
+void to_json(json&j, const dmi_status &s)
 {
-    if ((!cab_active[0] && !cab_active[1]) || mode == Mode::NP || mode == Mode::PS || mode == Mode::SL) {
-        dmi_socket = nullptr;
-        platform->delay(100).then(dmi_update_func).detach();
-        return;
-    }
-    if (!dmi_socket) {
-        dmi_socket = platform->open_socket("evc_dmi", BasePlatform::BusSocket::PeerId::fourcc("EVC"));
-        if (!dmi_socket)
-            return;
-        dmi_socket->receive().then(dmi_receive_handler).detach();
+    j["UpdateId"] = s.update_id;
+    j["BotDriver"] = s.bot_driver;
+    j["SlipperyRail"] = s.slippery_rail;
+    j["AllowedSpeedMpS"] = s.allowed_speed;
+    j["InterventionSpeedMpS"] = s.intervention_speed;
+    j["TargetSpeedMpS"] = s.target_speed;
+    j["TargetDistanceM"] = s.target_distance;
+    j["SpeedMpS"] = s.speed;
+    j["ReleaseSpeedMpS"] = s.release_speed;
+    j["CurrentMonitoringStatus"] = s.monitoring;
+    j["CurrentSupervisionStatus"] = s.supervision;
+    j["CurrentMode"] = s.mode;
+    j["CurrentLevel"] = s.level;
+    if (s.level == (int)Level::NTC)
+        j["CurrentNTC"] = s.ntc;
+    j["TimeToPermittedS"] = s.time_to_permitted;
+    j["TimeToIndicationS"] = s.time_to_indication;
+    if (s.mode_acknowledgement) j["ModeAcknowledgement"] = *s.mode_acknowledgement;
+    if (s.level_transition) {
+        j["LevelTransition"]["Acknowledge"] = s.level_transition->acknowledge;
+        j["LevelTransition"]["Level"] = s.level_transition->level;
+        if (s.level_transition->level == (int)Level::NTC)
+            j["LevelTransition"]["NTC"] = s.level_transition->ntc;
     }
-    platform->delay(100).then(dmi_update_func).detach();
-    sendtoor = get_milliseconds() - lastor > 250;
-    if (sendtoor) lastor = get_milliseconds();
-    json j;
-    j["BotDriver"] = bot_driver;
-    j["SlipperyRail"] = slippery_rail_driver;
-    j["AllowedSpeedMpS"] = V_perm;
-    j["InterventionSpeedMpS"] = V_sbi;
-    j["TargetSpeedMpS"] = V_target;
-    j["TargetDistanceM"] = D_target;
-    j["SpeedMpS"] = V_est;
-    j["ReleaseSpeedMpS"] = V_release;
-    j["CurrentMonitoringStatus"] = (int)monitoring;
-    j["CurrentSupervisionStatus"] = (int)supervision;
-    j["CurrentMode"] = (int)mode;
-    j["CurrentLevel"] = (int)(level_valid ? level : Level::Unknown);
-    if (level == Level::NTC)
-        j["CurrentNTC"] = nid_ntc;
-    j["TimeToPermittedS"] = TTP;
-    j["TimeToIndicationS"] = TTI;
-    if (mode_acknowledgeable) j["ModeAcknowledgement"] = (int)mode_to_ack;
-    else j["ModeAcknowledgement"] = nullptr;
-    if (ongoing_transition || level_acknowledgeable) {
-        j["LevelTransition"]["Acknowledge"] = level_acknowledgeable;
-        j["LevelTransition"]["Level"] = (int)level_to_ack;
-        if (level_to_ack == Level::NTC)
-            j["LevelTransition"]["NTC"] = ntc_to_ack;
-    } else {
-        j["LevelTransition"] = nullptr;
-    }
-    j["OverrideActive"] = overrideProcedure;
-    j["RadioStatus"] = (int)radio_status_driver;
-    j["BrakeCommanded"] = EB_command || SB_command;
-    j["BrakeAcknowledge"] = brake_acknowledgeable;
-    if (valid_geo_reference) j["GeographicalPositionKM"] = valid_geo_reference->get_position(d_estfront);
-    else j["GeographicalPositionKM"]=nullptr;
-    j["TextMessages"] = messages;
-    j["DisplayTAF"] = start_display_taf && !stop_display_taf;
-    j["AllowedAck"] = ack_allowed;
-    j["ReversingPermitted"] = reversing_permitted;
+    j["OverrideActive"] = s.override_active;
+    j["RadioStatus"] = s.radio_status;
+    j["BrakeCommanded"] = s.brake_commanded;
+    j["BrakeAcknowledge"] = s.brake_acknowledge;
+    if (s.geographical_position) j["GeographicalPositionKM"] = *s.geographical_position;
+    else j["GeographicalPositionKM"] = nullptr;
+    j["DisplayTAF"] = s.display_taf;
+    j["AllowedAck"] = s.allowed_ack;
+    j["ReversingPermitted"] = s.reversing_permitted;
     json clock;
-    clock["Hour"] = WallClockTime::hour;
-    clock["Minute"] = WallClockTime::minute;
-    clock["Second"] = WallClockTime::second;
+    clock["Hour"] = s.hour;
+    clock["Minute"] = s.minute;
+    clock["Second"] = s.second;
     j["WallClockTime"] = clock;
-    if (display_lssma) j["LSSMA"] = lssma;
+    if (s.lssma) j["LSSMA"] = *s.lssma;
+    if (s.indication_marker_target) j["IndicationMarkerTarget"] = *s.indication_marker_target;
+    else j["IndicationMarkerTarget"] = nullptr;
+    if (s.indication_marker_distance) j["IndicationMarkerDistanceM"] = *s.indication_marker_distance;
+    else j["IndicationMarkerDistanceM"] = nullptr;
+    j["SpeedTargets"] = s.speed_targets;
+    j["GradientProfile"] = s.gradients;
+    j["PlanningTrackConditions"] = s.track_conditions;
+    j["ActiveTrackConditions"] = s.active_track_conditions;
+}
+// Planning data that only depends on the MRSP and gradient profiles.
+// It is rebuilt when they change, so that each update only has to
+// offset it by the train position and clip it to the planning range.
+struct planning_cache
+{
+    unsigned MRSP_version = -1;
+    unsigned gradient_version = -1;
+    std::vector<const relocable_dist_base*> mrsp_points;
+    std::vector<double> mrsp_speeds;
+    // Whether the speed decreases at each point, which selects the
+    // max safe front instead of the min safe front
+    std::vector<bool> mrsp_decreasing;
+    std::vector<std::pair<dist_base, int>> gradient;
+    // Safe front positions of mrsp_points
+    safe_front_scratch safe_front;
+};
+planning_cache planning;
+void update_planning_cache()
+{
+    if (planning.MRSP_version != MRSP_version) {
+        planning.MRSP_version = MRSP_version;
+        auto &MRSP = get_MRSP();
+        planning.mrsp_points.clear();
+        planning.mrsp_speeds.clear();
+        planning.mrsp_decreasing.clear();
+        double prevMRSP = 5000;
+        for (auto &it : MRSP) {
+            planning.mrsp_points.push_back(&it.first);
+            planning.mrsp_speeds.push_back(it.second);
+            planning.mrsp_decreasing.push_back(prevMRSP > it.second);
+            prevMRSP = it.second;
+        }
+    }
+    if (planning.gradient_version != gradient_version) {
+        planning.gradient_version = gradient_version;
+        planning.gradient.clear();
+        for (auto &it : get_gradient())
+            planning.gradient.push_back({it.first, (int)(it.second*1000)});
+    }
+}
+void fill_dmi_status(dmi_status &s)
+{
+    s.bot_driver = bot_driver;
+    s.slippery_rail = slippery_rail_driver;
+    s.allowed_speed = V_perm;
+    s.intervention_speed = V_sbi;
+    s.target_speed = V_target;
+    s.target_distance = D_target;
+    s.speed = V_est;
+    s.release_speed = V_release;
+    s.monitoring = (int)monitoring;
+    s.supervision = (int)supervision;
+    s.mode = (int)mode;
+    s.level = (int)(level_valid ? level : Level::Unknown);
+    s.ntc = nid_ntc;
+    s.time_to_permitted = TTP;
+    s.time_to_indication = TTI;
+    if (mode_acknowledgeable) s.mode_acknowledgement = (int)mode_to_ack;
+    if (ongoing_transition || level_acknowledgeable)
+        s.level_transition = dmi_status::level_change{(int)level_to_ack, ntc_to_ack, level_acknowledgeable};
+    s.override_active = overrideProcedure;
+    s.radio_status = (int)radio_status_driver;
+    s.brake_commanded = EB_command || SB_command;
+    s.brake_acknowledge = brake_acknowledgeable;
+    if (valid_geo_reference) s.geographical_position = valid_geo_reference->get_position(d_estfront);
+    s.display_taf = start_display_taf && !stop_display_taf;
+    s.allowed_ack = ack_allowed;
+    s.reversing_permitted = reversing_permitted;
+    s.hour = WallClockTime::hour;
+    s.minute = WallClockTime::minute;
+    s.second = WallClockTime::second;
+    if (display_lssma) s.lssma = lssma;
+    // Lists are measured ahead of the front in the running direction, so
+    // the origin is the odometer reading taken in that direction
+    const dist_base &list_front = d_estfront_dir[odometer_orientation == -1];
+    s.list_origin = list_front.orientation * list_front.dist;
     if (mode == Mode::FS || mode == Mode::OS)
     {
-        std::vector<speed_element> speeds;
+        std::vector<dmi_status::speed_target> &speeds = s.speed_targets;
         double v = calc_ceiling_limit();
         speeds.push_back({0,v});
-        auto &MRSP = get_MRSP();
         extern double indication_distance;
-        double last_distance = MA ? MA->get_abs_end().min-d_minsafefront(MA->get_abs_end()) : 0;
+        safe_front_context ctx = safe_front_context::current();
+        double last_distance = MA ? MA->get_abs_end().min-ctx.minsafefront(MA->get_abs_end().est) : 0;
         const std::list<std::shared_ptr<target>> &targets = get_supervised_targets();
         for (auto &t : targets)
         {
-            relocable_dist_base td = t->get_target_position();
-            double d = td - (t->is_EBD_based ? d_maxsafefront(td) : d_estfront);
+            const relocable_dist_base &td = t->get_target_position();
+            double d = td - (t->is_EBD_based ? ctx.maxsafefront(td) : d_estfront);
             if (t->get_target_speed() == 0 && d<last_distance)
                 last_distance = d;
         }
-        j["IndicationMarkerTarget"] = nullptr;
-        j["IndicationMarkerDistanceM"] = nullptr;
-        double prevMRSP = 5000;
-        for (auto it=MRSP.begin(); it!=MRSP.end(); ++it) {
-            relocable_dist_base dist = it->first;
-            float safedist = dist-(prevMRSP > it->second ? d_maxsafefront(dist) : d_minsafefront(dist));
-            prevMRSP = it->second;
+        update_planning_cache();
+        size_t count = planning.mrsp_points.size();
+        ctx.evaluate(planning.mrsp_points.data(), count, planning.safe_front);
+        const std::vector<dist_base> &minsafe = planning.safe_front.minsafe, &maxsafe = planning.safe_front.maxsafe;
+        for (size_t i = 0; i < count; i++) {
+            const relocable_dist_base &dist = *planning.mrsp_points[i];
+            double speed = planning.mrsp_speeds[i];
+            float safedist = dist-(planning.mrsp_decreasing[i] ? maxsafe[i] : minsafe[i]);
             if (safedist < 0)
                 continue;
             if (safedist > last_distance + 1)
                 break;
-            if (indication_target != nullptr && indication_target->get_target_position() == dist && indication_target->get_target_speed() == it->second && indication_target->type == target_class::MRSP && monitoring == CSM) {
-                j["IndicationMarkerTarget"]["TargetSpeedMpS"] = indication_target->get_target_speed();
-                j["IndicationMarkerTarget"]["DistanceToTrainM"] = safedist;
-                j["IndicationMarkerDistanceM"] = indication_distance;
+            if (indication_target != nullptr && indication_target->get_target_position() == dist && indication_target->get_target_speed() == speed && indication_target->type == target_class::MRSP && monitoring == CSM) {
+                s.indication_marker_target = dmi_status::speed_target{safedist, indication_target->get_target_speed()};
+                s.indication_marker_distance = indication_distance;
             }
-            speeds.push_back({safedist, it->second});
+            speeds.push_back({safedist, speed});
         }
-        if (SvL && SvL->max-d_maxsafefront(*SvL) <= last_distance + 1) {
+        double svl_distance = SvL ? SvL->max-ctx.maxsafefront(SvL->est) : 0;
+        if (SvL && svl_distance <= last_distance + 1) {
             if (monitoring == CSM && indication_target != nullptr && (indication_target->type == target_class::SvL || indication_target->type == target_class::EoA)){
-                j["IndicationMarkerTarget"]["TargetSpeedMpS"] = 0;
-                j["IndicationMarkerTarget"]["DistanceToTrainM"] = SvL->max-d_maxsafefront(*SvL);
-                j["IndicationMarkerDistanceM"] = indication_distance;
+                s.indication_marker_target = dmi_status::speed_target{svl_distance, 0};
+                s.indication_marker_distance = indication_distance;
             }
-            speeds.push_back({SvL->max-d_maxsafefront(*SvL), 0});
-            last_distance = SvL->max-d_maxsafefront(*SvL);
+            speeds.push_back({svl_distance, 0});
+            last_distance = svl_distance;
         }
         else if (EoA && EoA->est-d_estfront <= last_distance + 1) {
             if (monitoring == CSM && indication_target != nullptr && (indication_target->type == target_class::SvL || indication_target->type == target_class::EoA)) {
-                j["IndicationMarkerTarget"]["TargetSpeedMpS"] = 0;
-                j["IndicationMarkerTarget"]["DistanceToTrainM"] = EoA->est-d_estfront;
-                j["IndicationMarkerDistanceM"] = indication_distance;
+                s.indication_marker_target = dmi_status::speed_target{EoA->est-d_estfront, 0};
+                s.indication_marker_distance = indication_distance;
             }
             speeds.push_back({EoA->est-d_estfront, 0});
             last_distance = EoA->est-d_estfront;
         }
-        if (LoA && LoA->first.max-d_maxsafefront(LoA->first) <= last_distance + 1) {
+        double loa_distance = LoA ? LoA->first.max-ctx.maxsafefront(LoA->first.est) : 0;
+        if (LoA && loa_distance <= last_distance + 1) {
             if (monitoring == CSM && indication_target != nullptr && (indication_target->type == target_class::LoA)) {
-                j["IndicationMarkerTarget"]["TargetSpeedMpS"] = LoA->second;
-                j["IndicationMarkerTarget"]["DistanceToTrainM"] = LoA->first.max-d_maxsafefront(LoA->first);
-                j["IndicationMarkerDistanceM"] = indication_distance;
+                s.indication_marker_target = dmi_status::speed_target{loa_distance, LoA->second};
+                s.indication_marker_distance = indication_distance;
             }
-            speeds.push_back({LoA->first.max-d_maxsafefront(LoA->first), LoA->second});
-            last_distance = LoA->first.max-d_maxsafefront(LoA->first);
+            speeds.push_back({loa_distance, LoA->second});
+            last_distance = loa_distance;
         }
-        j["SpeedTargets"] = speeds;
-        std::map<dist_base,double> gradient = get_gradient();
-        std::vector<gradient_element> grad;
-        grad.push_back({0, (int)((--gradient.upper_bound(d_estfront))->second*1000)});
-        for (auto it=gradient.upper_bound(d_estfront); it!=gradient.end(); ++it) {
+        std::vector<dmi_status::gradient> &grad = s.gradients;
+        const auto &gradient = planning.gradient;
+        auto next = std::upper_bound(gradient.begin(), gradient.end(), d_estfront, [](const dist_base &d, const std::pair<dist_base, int> &g) {
+            return d < g.first;
+        });
+        if (next != gradient.begin())
+            grad.push_back({0, (next-1)->second});
+        for (auto it = next; it != gradient.end(); ++it) {
             float dist = it->first-d_estfront;
-            if (it == --gradient.end() || dist >= last_distance + 1)
+            if (it == gradient.end()-1 || dist >= last_distance + 1)
                 break;
-            grad.push_back({dist,(int)(it->second*1000)});
+            grad.push_back({dist, it->second});
         }
         grad.push_back({std::max(last_distance, 0.0),0});
-        j["GradientProfile"] = grad;
-        std::vector<PlanningTrackCondition> objs;
+        std::vector<dmi_status::track_condition> &objs = s.track_conditions;
+        auto add_symbol = [&objs](const PlanningTrackCondition &o) {
+            objs.push_back({o.DistanceToTrainM, (int)o.Type, o.YellowColour, (int)o.TractionSystem});
+        };
         for (auto it = track_conditions.begin(); it != track_conditions.end(); ++it) {
             track_condition *tc = it->get();
             double start = tc->announce_distance;
@@ -413,14 +534,13 @@ void dmi_update_func()
             tc->start_symbol.DistanceToTrainM = start;
             tc->end_symbol.DistanceToTrainM = end;
             if (tc->start_symbol.Type != TrackConditionType_DMI::None && start > 0 && start <= last_distance + 1) {
-                objs.push_back(tc->start_symbol);
+                add_symbol(tc->start_symbol);
             }
             if (tc->end_symbol.Type != TrackConditionType_DMI::None && end > 0 && end <= last_distance + 1) {
-                objs.push_back(tc->end_symbol);
+                add_symbol(tc->end_symbol);
             }
         }
-        std::sort(objs.begin(), objs.end(), [](PlanningTrackCondition x, PlanningTrackCondition y) {return x.DistanceToTrainM < y.DistanceToTrainM;});
-        j["PlanningTrackConditions"] = objs;
+        std::stable_sort(objs.begin(), objs.end(), [](const dmi_status::track_condition &x, const dmi_status::track_condition &y) {return x.distance < y.distance;});
         std::set<int> active_symbols;
         for (auto it = track_conditions.begin(); it != track_conditions.end(); ++it) {
             track_condition *tc = it->get();
@@ -434,19 +554,132 @@ void dmi_update_func()
         }
         extern bool inform_lx;
         if (inform_lx) active_symbols.insert(100);
-        j["ActiveTrackConditions"] = active_symbols;
+        s.active_track_conditions.assign(active_symbols.begin(), active_symbols.end());
+    }
+}
+// What the driver must see without waiting for the next periodic update
+struct dmi_alert_state
+{
+    MonitoringStatus monitoring;
+    SupervisionStatus supervision;
+    Mode mode;
+    Level level;
+    bool mode_acknowledgeable;
+    bool level_acknowledgeable;
+    bool level_transition;
+    bool brake_commanded;
+    bool brake_acknowledgeable;
+    bool override_active;
+    bool ack_allowed;
+    int permitted_speed;
+    int intervention_speed;
+    auto tie() const
+    {
+        return std::tie(monitoring, supervision, mode, level, mode_acknowledgeable, level_acknowledgeable, level_transition,
+            brake_commanded, brake_acknowledgeable, override_active, ack_allowed, permitted_speed, intervention_speed);
     }
-    else
+    bool operator==(const dmi_alert_state &o) const
     {
-        j["PlanningTrackConditions"] = "[]"_json;
-        j["GradientProfile"] = "[]"_json;
-        j["SpeedTargets"] = "[]"_json;
-        j["ActiveTrackConditions"] = "[]"_json;
+        return tie() == o.tie();
+    }
+};
+dmi_alert_state last_alert_state;
+dmi_alert_state get_alert_state()
+{
+    return {monitoring, supervision, mode, level, mode_acknowledgeable, level_acknowledgeable, (bool)ongoing_transition,
+        EB_command || SB_command, brake_acknowledgeable, overrideProcedure, ack_allowed, (int)(V_perm*3.6+0.01), (int)(V_sbi*3.6+0.01)};
+}
+// Sends the status now, or as soon as the minimum interval allows
+void publish_dmi_status()
+{
+    if (!dmi_socket)
+        return;
+    int64_t wait = last_dmi_update + dmi_min_update_interval - get_milliseconds();
+    if (wait > 0) {
+        if (!dmi_push_scheduled) {
+            dmi_push_scheduled = true;
+            platform->delay(wait).then([]() {
+                dmi_push_scheduled = false;
+                publish_dmi_status();
+            }).detach();
+        }
+        return;
+    }
+    send_dmi_status();
+}
+void update_dmi()
+{
+    if (!dmi_socket)
+        return;
+    if (get_alert_state() == last_alert_state)
+        return;
+    if (dmi_change_time < 0)
+        dmi_change_time = get_milliseconds();
+    publish_dmi_status();
+}
+void dmi_update_func()
+{
+    if ((!cab_active[0] && !cab_active[1]) || mode == Mode::NP || mode == Mode::PS || mode == Mode::SL) {
+        dmi_socket = nullptr;
+        platform->delay(100).then(dmi_update_func).detach();
+        return;
+    }
+    if (!dmi_socket) {
+        dmi_socket = platform->open_socket("evc_dmi", BasePlatform::BusSocket::PeerId::fourcc("EVC"));
+        if (!dmi_socket)
+            return;
+        dmi_peers.clear();
+        binary_dmi_peers.clear();
+        dmi_socket->receive().then(dmi_receive_handler).detach();
+    }
+    platform->delay(100).then(dmi_update_func).detach();
+    publish_dmi_status();
+}
+void send_dmi_status()
+{
+    int64_t now = get_milliseconds();
+    sendtoor = now - lastor > 250;
+    if (sendtoor) lastor = now;
+    dmi_status status;
+    fill_dmi_status(status);
+    last_alert_state = get_alert_state();
+    if (++dmi_update_id == 0)
+        dmi_update_id = 1;
+    status.update_id = dmi_update_id;
+    dmi_sent_updates.push_back({dmi_update_id, dmi_change_time < 0 ? now : dmi_change_time, dmi_change_time >= 0});
+    if (dmi_sent_updates.size() > 32)
+        dmi_sent_updates.pop_front();
+    dmi_change_time = -1;
+    last_dmi_update = now;
+    std::string status_json;
+    if (sendtoor || binary_dmi_peers.size() < dmi_peers.size() || binary_dmi_peers.empty()) {
+        json j = status;
+        j["TextMessages"] = messages;
+        json j2;
+        j2["Status"] = j;
+        j2["ActiveWindow"] = active_window_dmi;
+        status_json = j2.dump();
+    }
+    if (binary_dmi_peers.empty()) {
+        send_command("json", status_json);
+    } else {
+        // The window only goes to binary DMIs when it changes
+        std::string window = active_window_dmi.dump();
+        bool window_changed = window != last_window_dmi;
+        last_window_dmi = window;
+        std::string binary = "status(" + status_encoder.encode(status) + ")";
+        for (uint32_t uid : dmi_peers) {
+            if (binary_dmi_peers.count(uid)) {
+                if (window_changed)
+                    dmi_socket->send_to(uid, "json({\"ActiveWindow\":" + window + "})");
+                dmi_socket->send_to(uid, binary);
+            } else {
+                dmi_socket->send_to(uid, "json(" + status_json + ")");
+            }
+        }
+        if (sendtoor)
+            sim_write_line("noretain(etcs::dmi::command=json("+status_json+"))");
     }
-    json j2;
-    j2["Status"] = j;
-    j2["ActiveWindow"] = active_window_dmi;
-    send_command("json", j2.dump());
     send_command("setVset", to_string(V_set * 3.6));
     /*
     send_command("setGeoPosition", valid_geo_reference ? to_string(valid_geo_reference->get_position(d_estfront)) : "-1");
@@ -10,6 +10,7 @@
 #define _DMI_H
 #include <string>
 void start_dmi();
+void update_dmi();
 void send_command(std::string command, std::string value);
 void set_persistent_command(std::string command, std::string value);
 #endif
\ No newline at end of file
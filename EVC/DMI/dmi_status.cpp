@@ -0,0 +1,414 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "dmi_status.h"
+// Layout, little endian:
+//   u8 version, u16 flags, varint update id
+//   f64 allowed, intervention, target and release speeds, current speed
+//   f32 target distance, time to permitted, time to indication
+//   u8 monitoring, supervision, mode, level, ntc, radio status, hour, minute, second
+//   optional fields, in flag order
+//   f64 list origin, u8 mask of the lists that follow
+//   each list: varint count, then its entries
+// Positions in lists are varints holding the zigzagged difference to the
+// previous position shifted left by one, with the low bit set for
+// elements at the train front, which have no position. Elements behind
+// the front keep negative distances, which the DMI does not draw.
+enum status_flags
+{
+    BotDriver = 1<<0,
+    SlipperyRail = 1<<1,
+    OverrideActive = 1<<2,
+    BrakeCommanded = 1<<3,
+    BrakeAcknowledge = 1<<4,
+    DisplayTAF = 1<<5,
+    AllowedAck = 1<<6,
+    ReversingPermitted = 1<<7,
+    HasModeAcknowledgement = 1<<8,
+    HasLevelTransition = 1<<9,
+    LevelTransitionAcknowledge = 1<<10,
+    HasGeographicalPosition = 1<<11,
+    HasLSSMA = 1<<12,
+    HasIndicationMarkerDistance = 1<<13,
+    HasIndicationMarkerTarget = 1<<14,
+};
+static void put_u8(std::string &out, uint32_t v)
+{
+    out.push_back((char)(uint8_t)v);
+}
+static void put_u16(std::string &out, uint32_t v)
+{
+    put_u8(out, v);
+    put_u8(out, v >> 8);
+}
+static void put_u64(std::string &out, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        put_u8(out, (uint32_t)(v >> (8 * i)));
+}
+static void put_f64(std::string &out, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u64(out, bits);
+}
+static void put_f32(std::string &out, double v)
+{
+    float f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    for (int i = 0; i < 4; i++)
+        put_u8(out, bits >> (8 * i));
+}
+static void put_varint(std::string &out, uint64_t v)
+{
+    while (v >= 0x80) {
+        put_u8(out, (uint32_t)(v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    put_u8(out, (uint32_t)v);
+}
+static uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+static int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+static void put_position(std::string &out, double distance, double origin, int64_t &prev)
+{
+    if (distance == 0 || std::isnan(distance)) {
+        put_varint(out, 1);
+        return;
+    }
+    // Rounding must not move an element to the other side of the front
+    int64_t pos = std::llround(origin + distance);
+    if (distance > 0)
+        pos = std::max(pos, (int64_t)std::floor(origin) + 1);
+    else
+        pos = std::min(pos, (int64_t)std::ceil(origin) - 1);
+    put_varint(out, zigzag(pos - prev) << 1);
+    prev = pos;
+}
+struct reader
+{
+    const unsigned char *ptr;
+    const unsigned char *end;
+    bool ok = true;
+    bool need(size_t n)
+    {
+        if ((size_t)(end - ptr) < n)
+            ok = false;
+        return ok;
+    }
+    uint32_t u8()
+    {
+        if (!need(1))
+            return 0;
+        return *ptr++;
+    }
+    uint32_t u16()
+    {
+        uint32_t v = u8();
+        return v | u8() << 8;
+    }
+    uint64_t u64()
+    {
+        if (!need(8))
+            return 0;
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++)
+            v |= (uint64_t)ptr[i] << (8 * i);
+        ptr += 8;
+        return v;
+    }
+    double f64()
+    {
+        uint64_t bits = u64();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    double f32()
+    {
+        if (!need(4))
+            return 0;
+        uint32_t bits = (uint32_t)ptr[0] | (uint32_t)ptr[1] << 8 | (uint32_t)ptr[2] << 16 | (uint32_t)ptr[3] << 24;
+        ptr += 4;
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+    uint64_t varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint32_t b = u8();
+            if (!ok)
+                return 0;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+    // Returns NaN for elements at the train front
+    double position(int64_t &prev)
+    {
+        uint64_t v = varint();
+        if (v & 1)
+            return std::numeric_limits<double>::quiet_NaN();
+        prev += unzigzag(v >> 1);
+        return (double)prev;
+    }
+};
+static double to_distance(double position, double origin)
+{
+    if (std::isnan(position))
+        return 0;
+    return position - origin;
+}
+void dmi_status_encoder::reset()
+{
+    for (int i = 0; i < LISTS; i++)
+        last_lists[i].clear();
+}
+std::string dmi_status_encoder::encode(const dmi_status &s)
+{
+    std::string out;
+    out.reserve(128);
+    put_u8(out, DMI_STATUS_VERSION);
+    uint32_t flags = 0;
+    if (s.bot_driver) flags |= BotDriver;
+    if (s.slippery_rail) flags |= SlipperyRail;
+    if (s.override_active) flags |= OverrideActive;
+    if (s.brake_commanded) flags |= BrakeCommanded;
+    if (s.brake_acknowledge) flags |= BrakeAcknowledge;
+    if (s.display_taf) flags |= DisplayTAF;
+    if (s.allowed_ack) flags |= AllowedAck;
+    if (s.reversing_permitted) flags |= ReversingPermitted;
+    if (s.mode_acknowledgement) flags |= HasModeAcknowledgement;
+    if (s.level_transition) flags |= HasLevelTransition;
+    if (s.level_transition && s.level_transition->acknowledge) flags |= LevelTransitionAcknowledge;
+    if (s.geographical_position) flags |= HasGeographicalPosition;
+    if (s.lssma) flags |= HasLSSMA;
+    if (s.indication_marker_distance) flags |= HasIndicationMarkerDistance;
+    if (s.indication_marker_target) flags |= HasIndicationMarkerTarget;
+    put_u16(out, flags);
+    put_varint(out, s.update_id);
+    put_f64(out, s.allowed_speed);
+    put_f64(out, s.intervention_speed);
+    put_f64(out, s.target_speed);
+    put_f64(out, s.release_speed);
+    put_f64(out, s.speed);
+    put_f32(out, s.target_distance);
+    put_f32(out, s.time_to_permitted);
+    put_f32(out, s.time_to_indication);
+    put_u8(out, s.monitoring);
+    put_u8(out, s.supervision);
+    put_u8(out, s.mode);
+    put_u8(out, s.level);
+    put_u8(out, s.ntc);
+    put_u8(out, s.radio_status);
+    put_u8(out, s.hour);
+    put_u8(out, s.minute);
+    put_u8(out, s.second);
+    if (s.mode_acknowledgement)
+        put_u8(out, *s.mode_acknowledgement);
+    if (s.level_transition) {
+        put_u8(out, s.level_transition->level);
+        put_u8(out, s.level_transition->ntc);
+    }
+    if (s.geographical_position)
+        put_f64(out, *s.geographical_position);
+    if (s.lssma)
+        put_f64(out, *s.lssma);
+    if (s.indication_marker_distance)
+        put_f32(out, *s.indication_marker_distance);
+    if (s.indication_marker_target) {
+        put_f32(out, s.indication_marker_target->distance);
+        put_f64(out, s.indication_marker_target->speed);
+    }
+    put_f64(out, s.list_origin);
+
+    std::string lists[LISTS];
+    int64_t prev = 0;
+    put_varint(lists[0], s.speed_targets.size());
+    for (auto &e : s.speed_targets) {
+        put_position(lists[0], e.distance, s.list_origin, prev);
+        put_f64(lists[0], e.speed);
+    }
+    prev = 0;
+    put_varint(lists[1], s.gradients.size());
+    for (auto &e : s.gradients) {
+        put_position(lists[1], e.distance, s.list_origin, prev);
+        put_varint(lists[1], zigzag(e.value));
+    }
+    prev = 0;
+    put_varint(lists[2], s.track_conditions.size());
+    for (auto &e : s.track_conditions) {
+        put_position(lists[2], e.distance, s.list_origin, prev);
+        put_u8(lists[2], e.type);
+        put_u8(lists[2], (e.yellow ? 1 : 0) | e.traction << 1);
+    }
+    prev = 0;
+    put_varint(lists[3], s.active_track_conditions.size());
+    for (int v : s.active_track_conditions) {
+        put_varint(lists[3], zigzag(v - prev));
+        prev = v;
+    }
+
+    uint32_t mask = 0;
+    for (int i = 0; i < LISTS; i++) {
+        if (lists[i] != last_lists[i])
+            mask |= 1<<i;
+    }
+    put_u8(out, mask);
+    for (int i = 0; i < LISTS; i++) {
+        if (mask & (1<<i)) {
+            out += lists[i];
+            last_lists[i] = std::move(lists[i]);
+        }
+    }
+    return out;
+}
+void dmi_status_decoder::reset()
+{
+    speed_targets.clear();
+    gradients.clear();
+    track_conditions.clear();
+    active_track_conditions.clear();
+}
+bool dmi_status_decoder::decode(std::string_view data, dmi_status &s)
+{
+    reader r{(const unsigned char*)data.data(), (const unsigned char*)data.data() + data.size()};
+    if (r.u8() != DMI_STATUS_VERSION)
+        return false;
+    uint32_t flags = r.u16();
+    s.update_id = (uint32_t)r.varint();
+    s.bot_driver = flags & BotDriver;
+    s.slippery_rail = flags & SlipperyRail;
+    s.override_active = flags & OverrideActive;
+    s.brake_commanded = flags & BrakeCommanded;
+    s.brake_acknowledge = flags & BrakeAcknowledge;
+    s.display_taf = flags & DisplayTAF;
+    s.allowed_ack = flags & AllowedAck;
+    s.reversing_permitted = flags & ReversingPermitted;
+    s.allowed_speed = r.f64();
+    s.intervention_speed = r.f64();
+    s.target_speed = r.f64();
+    s.release_speed = r.f64();
+    s.speed = r.f64();
+    s.target_distance = r.f32();
+    s.time_to_permitted = r.f32();
+    s.time_to_indication = r.f32();
+    s.monitoring = r.u8();
+    s.supervision = r.u8();
+    s.mode = r.u8();
+    s.level = r.u8();
+    s.ntc = r.u8();
+    s.radio_status = r.u8();
+    s.hour = r.u8();
+    s.minute = r.u8();
+    s.second = r.u8();
+    s.mode_acknowledgement.reset();
+    if (flags & HasModeAcknowledgement)
+        s.mode_acknowledgement = r.u8();
+    s.level_transition.reset();
+    if (flags & HasLevelTransition) {
+        int level = r.u8();
+        int ntc = r.u8();
+        s.level_transition = dmi_status::level_change{level, ntc, (flags & LevelTransitionAcknowledge) != 0};
+    }
+    s.geographical_position.reset();
+    if (flags & HasGeographicalPosition)
+        s.geographical_position = r.f64();
+    s.lssma.reset();
+    if (flags & HasLSSMA)
+        s.lssma = r.f64();
+    s.indication_marker_distance.reset();
+    if (flags & HasIndicationMarkerDistance)
+        s.indication_marker_distance = r.f32();
+    s.indication_marker_target.reset();
+    if (flags & HasIndicationMarkerTarget) {
+        double distance = r.f32();
+        double speed = r.f64();
+        s.indication_marker_target = dmi_status::speed_target{distance, speed};
+    }
+    s.list_origin = r.f64();
+
+    uint32_t mask = r.u8();
+    if (!r.ok)
+        return false;
+    // Lists are only replaced once they have been read in full
+    if (mask & 1) {
+        std::vector<dmi_status::speed_target> list(std::min<uint64_t>(r.varint(), data.size()));
+        int64_t prev = 0;
+        for (auto &e : list) {
+            e.distance = r.position(prev);
+            e.speed = r.f64();
+        }
+        if (!r.ok)
+            return false;
+        speed_targets = std::move(list);
+    }
+    if (mask & 2) {
+        std::vector<dmi_status::gradient> list(std::min<uint64_t>(r.varint(), data.size()));
+        int64_t prev = 0;
+        for (auto &e : list) {
+            e.distance = r.position(prev);
+            e.value = (int)unzigzag(r.varint());
+        }
+        if (!r.ok)
+            return false;
+        gradients = std::move(list);
+    }
+    if (mask & 4) {
+        std::vector<dmi_status::track_condition> list(std::min<uint64_t>(r.varint(), data.size()));
+        int64_t prev = 0;
+        for (auto &e : list) {
+            e.distance = r.position(prev);
+            e.type = r.u8();
+            uint32_t bits = r.u8();
+            e.yellow = bits & 1;
+            e.traction = bits >> 1;
+        }
+        if (!r.ok)
+            return false;
+        track_conditions = std::move(list);
+    }
+    if (mask & 8) {
+        std::vector<int> list(std::min<uint64_t>(r.varint(), data.size()));
+        int64_t prev = 0;
+        for (int &v : list) {
+            prev += unzigzag(r.varint());
+            v = (int)prev;
+        }
+        if (!r.ok)
+            return false;
+        active_track_conditions = std::move(list);
+    }
+
+    s.speed_targets = speed_targets;
+    for (auto &e : s.speed_targets)
+        e.distance = to_distance(e.distance, s.list_origin);
+    s.gradients = gradients;
+    for (auto &e : s.gradients)
+        e.distance = to_distance(e.distance, s.list_origin);
+    s.track_conditions = track_conditions;
+    for (auto &e : s.track_conditions)
+        e.distance = to_distance(e.distance, s.list_origin);
+    s.active_track_conditions = active_track_conditions;
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+// Version of the binary status encoding. A DMI that understands it sends
+// protocol(<version>) to the EVC, which then replaces the "Status" member
+// of json(...) with status(<binary>) for that DMI. Shared by the EVC and DMI.
+#define DMI_STATUS_VERSION 2
+// Supervision state shown by the DMI, as sent by the EVC on every update
+struct dmi_status
+{
+    // Echoed by the DMI in presented(<id>) once a frame showing this
+    // status has been presented. Zero if no echo is wanted.
+    uint32_t update_id = 0;
+    struct speed_target
+    {
+        double distance;
+        double speed;
+    };
+    struct gradient
+    {
+        double distance;
+        int value;
+    };
+    struct track_condition
+    {
+        double distance;
+        int type;
+        bool yellow;
+        int traction;
+    };
+    struct level_change
+    {
+        int level;
+        int ntc;
+        bool acknowledge;
+    };
+    bool bot_driver = false;
+    bool slippery_rail = false;
+    bool override_active = false;
+    bool brake_commanded = false;
+    bool brake_acknowledge = false;
+    bool display_taf = false;
+    bool allowed_ack = false;
+    bool reversing_permitted = false;
+    double allowed_speed = 0;
+    double intervention_speed = 0;
+    double target_speed = 0;
+    double target_distance = 0;
+    double speed = 0;
+    double release_speed = 0;
+    double time_to_permitted = 0;
+    double time_to_indication = 0;
+    int monitoring = 0;
+    int supervision = 0;
+    int mode = 0;
+    int level = 0;
+    int ntc = 0;
+    int radio_status = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    std::optional<int> mode_acknowledgement;
+    std::optional<level_change> level_transition;
+    std::optional<double> geographical_position;
+    std::optional<double> lssma;
+    std::optional<double> indication_marker_distance;
+    std::optional<speed_target> indication_marker_target;
+    // Distances in the lists below are to the train front. For the binary
+    // encoding they are turned into positions by adding this value, which
+    // must grow by as much as the train moves forward.
+    double list_origin = 0;
+    std::vector<speed_target> speed_targets;
+    std::vector<gradient> gradients;
+    std::vector<track_condition> track_conditions;
+    std::vector<int> active_track_conditions;
+};
+// Lists are sent as positions rounded to the metre, and only when they
+// differ from the ones sent before. All DMIs fed from one encoder must
+// receive every message it produces since the last reset().
+class dmi_status_encoder
+{
+    static constexpr int LISTS = 4;
+    std::string last_lists[LISTS];
+public:
+    // Makes the next message carry every list
+    void reset();
+    std::string encode(const dmi_status &status);
+};
+class dmi_status_decoder
+{
+    static constexpr int LISTS = 4;
+    // Lists as last received, with positions instead of distances
+    std::vector<dmi_status::speed_target> speed_targets;
+    std::vector<dmi_status::gradient> gradients;
+    std::vector<dmi_status::track_condition> track_conditions;
+    std::vector<int> active_track_conditions;
+public:
+    void reset();
+    // Returns false if the data is malformed or from another version
+    bool decode(std::string_view data, dmi_status &status);
+};
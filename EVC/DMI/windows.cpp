@@ -22,6 +22,7 @@
 #include "../Version/version.h"
 #include "dmi.h"
 #include "platform_runtime.h"
+#include "config_store.h"
 dialog_sequence active_dialog;
 std::string active_dialog_step;
 json default_window = R"({"active":"default"})"_json;
@@ -203,13 +204,12 @@ json fixed_train_data_window()
     json j = R"({"active":"fixed_train_data_window"})"_json;
     std::vector<json> inputs;
 
-    json j2;
-    auto contents = platform->read_file(traindata_file);
-    if (contents)
-        j2 = json::parse(*contents);
+    ConfigStore::Document j2 = config_store.get(traindata_file);
     std::vector<std::string> types;
-    for (auto it = j2.begin(); it!=j2.end(); ++it) {
-        types.push_back(it.key());
+    if (j2) {
+        for (auto it = j2->begin(); it!=j2->end(); ++it) {
+            types.push_back(it.key());
+        }
     }
     j["WindowDefinition"] = build_input_window(get_text("Train data"), {build_input_field(get_text("Train type"), special_train_data, types)});
     j["Switchable"] = data_entry_type == 2;
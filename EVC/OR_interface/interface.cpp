@@ -23,6 +23,7 @@
 #include "../Config/config.h"
 #include <orts/common.h>
 #include "platform_runtime.h"
+#include "config_store.h"
 #include "orts_wrapper.h"
 #include "../language/language.h"
 
@@ -285,6 +286,33 @@ void SetParameters()
     };
     manager.AddParameter(p);
 
+    p = new ORserver::Parameter("etcs::reload_config");
+    p->SetValue = [](std::string val) {
+        config_store.reload();
+        reload_config();
+    };
+    manager.AddParameter(p);
+
+    p = new ORserver::Parameter("etcs::file_write_stats");
+    p->GetValue = []() {
+        auto st = platform->file_write_stats();
+        if (!st)
+            return std::string();
+        return std::to_string(st->writes)+";"+std::to_string(st->coalesced)+";"+std::to_string(st->failed)+";"+
+            std::to_string(st->queued_bytes)+";"+std::to_string(st->peak_queued_bytes)+";"+std::to_string(st->last_latency)+";"+std::to_string(st->max_latency);
+    };
+    manager.AddParameter(p);
+
+    p = new ORserver::Parameter("etcs::timer_stats");
+    p->GetValue = []() {
+        auto st = platform->timer_stats();
+        if (!st)
+            return std::string();
+        return std::to_string(st->fired)+";"+std::to_string(st->cancelled)+";"+std::to_string(st->last_lateness)+";"+
+            std::to_string(st->max_lateness)+";"+std::to_string(st->total_lateness);
+    };
+    manager.AddParameter(p);
+
     p = new ORserver::Parameter("language");
     p->SetValue = [](std::string val) {
         set_language(val);
@@ -322,7 +350,7 @@ void SetParameters()
         else
             data_entry_type_tiu = stoi(val);
         if (data_entry_type >= 0) {
-            if (platform->read_file(traindata_file))
+            if (config_store.get(traindata_file))
                 data_entry_type = data_entry_type_tiu;
             else
                 data_entry_type = 0;
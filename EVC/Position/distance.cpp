@@ -12,6 +12,7 @@
 #include "../Supervision/locomotive_data.h"
 #include "linking.h"
 #include <limits>
+#include <vector>
 relocable_dist_base *relocable_dist_base::begin = nullptr;
 relocable_dist_base *relocable_dist_base::end = nullptr;
 dist_base dist_base::max = dist_base(std::numeric_limits<double>::max(), 0);
@@ -92,42 +93,6 @@ distance::distance(double val, int orientation, double ref)
     est.type = 0;
     min.type = -1;
 }
-dist_base &dist_base::operator=(const dist_base &d)
-{
-    dist = d.dist;
-    orientation = d.orientation;
-    return *this;
-}
-dist_base &dist_base::operator+=(const double d)
-{
-    if (dist <= std::numeric_limits<double>::lowest() || dist >= std::numeric_limits<double>::max()) return *this;
-    dist += orientation * d;
-    return *this;
-}
-double dist_base::operator-(const dist_base &d) const
-{
-    int dir = 1;
-    if (orientation * d.orientation < 0) abort();
-    if (orientation == -1 || d.orientation == -1) dir = -1;
-    if (dist <= std::numeric_limits<double>::lowest() ||
-    d.dist >= std::numeric_limits<double>::max())
-        return std::numeric_limits<double>::lowest();
-    if (dist >= std::numeric_limits<double>::max() ||
-    d.dist <= std::numeric_limits<double>::lowest())
-        return std::numeric_limits<double>::max();
-    return dir*(dist-d.dist);
-}
-bool dist_base::operator<(const dist_base &d) const
-{
-    if (orientation * d.orientation < 0) abort();
-    int dir = 1;
-    if (orientation == -1 || d.orientation == -1) dir = -1;
-    if (dist <= std::numeric_limits<double>::lowest() ||
-    d.dist <= std::numeric_limits<double>::lowest() ||
-    dist >= std::numeric_limits<double>::max() ||
-    d.dist >= std::numeric_limits<double>::max()) dir = 1;
-    return dir == -1 ? dist>d.dist : dist<d.dist;
-}
 confidence_data confidence_data::from_distance(const relocable_dist_base &d)
 {
     confidence_data c;
@@ -179,13 +144,13 @@ dist_base d_minsafefront(const confidence_data &conf)
 }
 dist_base d_maxsafefront(const relocable_dist_base&ref)
 {
-    if (ref.dist <= std::numeric_limits<double>::lowest() || ref.dist >= std::numeric_limits<double>::max())
+    if (ref.is_infinite())
         return d_estfront;
     return d_maxsafe(ref.orientation == 0 ? d_estfront : d_estfront_dir[ref.orientation == -1], confidence_data::from_distance(ref));
 }
 dist_base d_minsafefront(const relocable_dist_base&ref)
 {
-    if (ref.dist <= std::numeric_limits<double>::lowest() || ref.dist >= std::numeric_limits<double>::max())
+    if (ref.is_infinite())
         return d_estfront;
     return d_minsafe(ref.orientation == 0 ? d_estfront : d_estfront_dir[ref.orientation == -1], confidence_data::from_distance(ref));
 }
@@ -197,6 +162,91 @@ dist_base d_minsafefront(const distance&ref)
 {
     return d_minsafefront(ref.est);
 }
+safe_front_context safe_front_context::current()
+{
+    safe_front_context c;
+    c.estfront[0] = d_estfront_dir[1];
+    c.estfront[1] = d_estfront;
+    c.estfront[2] = d_estfront_dir[0];
+    c.has_lrbg = solr.has_value();
+    c.lrbg_locacc = solr ? solr->locacc : 0;
+    c.nv_locacc = Q_NVLOCACC;
+    return c;
+}
+confidence_data safe_front_context::confidence(const relocable_dist_base &d) const
+{
+    confidence_data c;
+    c.ref = d.ref;
+    c.locacc = 0;
+    if (d.balise_based) {
+#if BASELINE < 4
+        if (d.ref.dist != 0) {
+            c.locacc = nv_locacc;
+            return c;
+        }
+#endif
+        if (!has_lrbg)
+            abort();
+        c.locacc = lrbg_locacc;
+    }
+    return c;
+}
+dist_base safe_front_context::maxsafefront(const relocable_dist_base &ref) const
+{
+    if (ref.is_infinite())
+        return estfront[1];
+    return d_maxsafe(estfront[ref.orientation+1], confidence(ref));
+}
+dist_base safe_front_context::minsafefront(const relocable_dist_base &ref) const
+{
+    if (ref.is_infinite())
+        return estfront[1];
+    return d_minsafe(estfront[ref.orientation+1], confidence(ref));
+}
+void safe_front_context::evaluate(const relocable_dist_base *const *refs, size_t count, safe_front_scratch &scratch) const
+{
+    // Locations are first flattened into plain arrays, so that the odometer
+    // error envelope is computed by a branch-free loop over doubles
+    std::vector<double> &ref = scratch.ref, &sign = scratch.sign, &diff = scratch.diff, &locacc = scratch.locacc;
+    std::vector<double> &lo = scratch.lo, &hi = scratch.hi;
+    ref.resize(count);
+    sign.resize(count);
+    diff.resize(count);
+    locacc.resize(count);
+    lo.resize(count);
+    hi.resize(count);
+    scratch.minsafe.resize(count);
+    scratch.maxsafe.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const relocable_dist_base &d = *refs[i];
+        if (d.is_infinite() || d.ref.is_infinite()) {
+            ref[i] = sign[i] = diff[i] = locacc[i] = 0;
+            continue;
+        }
+        confidence_data conf = confidence(d);
+        ref[i] = conf.ref.dist;
+        sign[i] = conf.ref.orientation;
+        diff[i] = estfront[d.orientation+1] - conf.ref;
+        locacc[i] = conf.locacc;
+    }
+    for (size_t i = 0; i < count; i++) {
+        bool ahead = diff[i] > 0;
+        hi[i] = ref[i] + sign[i]*(diff[i]*(ahead ? 1.01 : 0.99));
+        hi[i] += sign[i]*locacc[i];
+        lo[i] = ref[i] + sign[i]*(diff[i]*(ahead ? 0.99 : 1.01));
+        lo[i] += sign[i]*-locacc[i];
+    }
+    for (size_t i = 0; i < count; i++) {
+        const relocable_dist_base &d = *refs[i];
+        if (d.is_infinite() || d.ref.is_infinite()) {
+            scratch.minsafe[i] = minsafefront(d);
+            scratch.maxsafe[i] = maxsafefront(d);
+            continue;
+        }
+        scratch.minsafe[i] = dist_base(lo[i], d.ref.orientation);
+        scratch.maxsafe[i] = dist_base(hi[i], d.ref.orientation);
+    }
+}
 dist_base d_estfront(0,0);
 dist_base d_estfront_dir[2] = {dist_base(0,1),dist_base(0,-1)};
 double odometer_value=0;
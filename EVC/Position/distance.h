@@ -9,6 +9,8 @@
 #pragma once
 #include <limits>
 #include <cstdlib>
+#include <cmath>
+#include <vector>
 using std::abort;
 #define DISTANCE_COW
 extern double odometer_value;
@@ -16,16 +18,32 @@ extern double odometer_reference;
 extern int odometer_orientation;
 extern int current_odometer_orientation;
 extern int odometer_direction;
+#ifdef DISTANCE_VALIDATION
+#define DIST_CHECK_ORIENTATION(a, b) do { if ((a) * (b) < 0) abort(); } while (0)
+#else
+#define DIST_CHECK_ORIENTATION(a, b) do { } while (0)
+#endif
+// min and max are represented by the lowest and highest finite doubles,
+// which never move and compare the same way regardless of orientation
 struct dist_base
 {
     double dist;
     int orientation;
     dist_base() = default;
     dist_base(double dist, int orientation) : dist(dist), orientation(orientation) {}
-    dist_base &operator = (const dist_base& d);
     static dist_base max;
     static dist_base min;
-    bool operator<(const dist_base &d) const;
+    bool is_infinite() const
+    {
+        return !(std::abs(dist) < std::numeric_limits<double>::max());
+    }
+    bool operator<(const dist_base &d) const
+    {
+        DIST_CHECK_ORIENTATION(orientation, d.orientation);
+        bool reversed = (orientation + d.orientation < 0) & !is_infinite() & !d.is_infinite();
+        double dir = reversed ? -1 : 1;
+        return dir*dist < dir*d.dist;
+    }
     bool operator>(const dist_base &d) const
     {
         return d<*this;
@@ -58,13 +76,26 @@ struct dist_base
         dist+=-d;
         return dist;
     }
-    dist_base &operator+=(const double d);
+    dist_base &operator+=(const double d)
+    {
+        dist += is_infinite() ? 0 : orientation * d;
+        return *this;
+    }
     dist_base &operator-=(const double d)
     {
         *this += -d;
         return *this;
     }
-    double operator-(const dist_base &d) const;
+    double operator-(const dist_base &d) const
+    {
+        DIST_CHECK_ORIENTATION(orientation, d.orientation);
+        if (dist <= std::numeric_limits<double>::lowest() || d.dist >= std::numeric_limits<double>::max())
+            return std::numeric_limits<double>::lowest();
+        if (dist >= std::numeric_limits<double>::max() || d.dist <= std::numeric_limits<double>::lowest())
+            return std::numeric_limits<double>::max();
+        double dir = orientation + d.orientation < 0 ? -1 : 1;
+        return dir*(dist-d.dist);
+    }
 };
 struct relocable_dist_base;
 struct confidence_data
@@ -154,5 +185,34 @@ dist_base d_maxsafefront(const distance&ref);
 dist_base d_minsafefront(const distance&ref);
 dist_base d_maxsafefront(const relocable_dist_base&ref);
 dist_base d_minsafefront(const relocable_dist_base&ref);
+// Working storage of safe_front_context::evaluate(). It is kept by the
+// caller between passes, so that evaluating does not allocate once the
+// buffers have grown to the number of locations.
+struct safe_front_scratch
+{
+    // Locations to evaluate, for callers that gather them from a profile
+    std::vector<const relocable_dist_base*> refs;
+    std::vector<double> ref, sign, diff, locacc, lo, hi;
+    // Results, one per location
+    std::vector<dist_base> minsafe, maxsafe;
+};
+// Snapshot of the estimated front end and location accuracies, so that many
+// locations can be evaluated without looking them up again for each one.
+// A balise reading may change the confidence interval at any point of the
+// cycle, so take a fresh snapshot for every evaluation pass.
+struct safe_front_context
+{
+    dist_base estfront[3];
+    bool has_lrbg;
+    double lrbg_locacc;
+    double nv_locacc;
+    static safe_front_context current();
+    confidence_data confidence(const relocable_dist_base &d) const;
+    dist_base maxsafefront(const relocable_dist_base &ref) const;
+    dist_base minsafefront(const relocable_dist_base &ref) const;
+    // Min and max safe front ends of each location, into scratch.minsafe
+    // and scratch.maxsafe
+    void evaluate(const relocable_dist_base *const *refs, size_t count, safe_front_scratch &scratch) const;
+};
 void update_odometer();
 void reset_odometer(double dist);
@@ -188,7 +188,7 @@ void relocate()
     std::optional<lrbg_info> prevsolr = solr;
     double offset = 0;
     dist_base zero;
-    dist_base prev_dist;
+    dist_base prev_dist(0, 0);
     for (auto &rbg : orbgs) {
         if (rbg.first.nid_lrbg == newsolr) {
             zero = dist_base(0, rbg.first.position.orientation);
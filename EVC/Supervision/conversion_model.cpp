@@ -144,28 +144,35 @@ double Kwet_rst(double V, dist_base d)
     return (--Kwet_rst_combination[(--active_combination.upper_bound(d))->second.second].upper_bound(V))->second;
 }
 std::map<double,double> Kn[2];
-void set_brake_model(json &traindata)
+// Lists that may be left out, which then hold no entries
+static const json &section(const json &j, const char *key)
+{
+    static const json none;
+    auto it = j.find(key);
+    return it != j.end() ? *it : none;
+}
+void set_brake_model(const json &traindata)
 {
     reset();
-    json &brakes = traindata["brakes"];
-    json &emergency = brakes["emergency"];
+    const json &brakes = traindata.at("brakes");
+    const json &emergency = section(brakes, "emergency");
     for (auto it = emergency.begin(); it!=emergency.end(); ++it) {
-        std::string valid = (*it)["validity"].get<std::string>();
-        json &curves = (*it)["curves"];
+        std::string valid = it->at("validity").get<std::string>();
+        const json &curves = section(*it, "curves");
         std::map<double,std::map<double,double>> dry;
         std::map<double,double> wet;
         std::map<double,double> accel;
-        double build_time = (*it)["build_up_time"].get<double>();
+        double build_time = it->at("build_up_time").get<double>();
         for (auto it2 = curves.begin(); it2!=curves.end(); ++it2) {
-            json &step = *it2;
-            double spd = step["speed"].get<double>()/3.6;
-            accel[spd] = step["value"].get<double>();
-            wet[spd] = step["kwet"].get<double>();
-            json &dries = step["kdry"];
+            const json &step = *it2;
+            double spd = step.at("speed").get<double>()/3.6;
+            accel[spd] = step.at("value").get<double>();
+            wet[spd] = step.at("kwet").get<double>();
+            const json &dries = section(step, "kdry");
             for (auto it3 = dries.begin(); it3!=dries.end(); ++it3) {
-                json &conf = *it3;
-                double ebcl = conf["confidence"].get<double>()/100;
-                dry[spd][ebcl] = conf["value"].get<double>();
+                const json &conf = *it3;
+                double ebcl = conf.at("confidence").get<double>()/100;
+                dry[spd][ebcl] = conf.at("value").get<double>();
             }
         }
         for (int i=0; i<16; i++) {
@@ -187,16 +194,16 @@ void set_brake_model(json &traindata)
             }
         }
     }
-    json &service = brakes["service"];
+    const json &service = section(brakes, "service");
     for (auto it = service.begin(); it!=service.end(); ++it) {
-        std::string valid = (*it)["validity"].get<std::string>();
-        json &curves = (*it)["curves"];
+        std::string valid = it->at("validity").get<std::string>();
+        const json &curves = section(*it, "curves");
         std::map<double,double> accel;
-        double build_time = (*it)["build_up_time"].get<double>();
+        double build_time = it->at("build_up_time").get<double>();
         for (auto it2 = curves.begin(); it2!=curves.end(); ++it2) {
-            json &step = *it2;
-            double spd = step["speed"].get<double>()/3.6;
-            accel[spd] = step["value"].get<double>();
+            const json &step = *it2;
+            double spd = step.at("speed").get<double>()/3.6;
+            accel[spd] = step.at("value").get<double>();
         }
         for (int i=0; i<8; i++) {
             bool applies = true;
@@ -215,29 +222,29 @@ void set_brake_model(json &traindata)
             }
         }
     }
-    json &normal = brakes["normal_service"];
+    const json &normal = section(brakes, "normal_service");
     for (auto it = normal.begin(); it!=normal.end(); ++it) {
         std::string position = it.key();
         if (position == "kn+") {
             for (auto it2 = it->begin(); it2!=it->end(); ++it2) {
-                Kn[0][(*it2)["speed"].get<double>()] = (*it2)["value"].get<double>();
+                Kn[0][it2->at("speed").get<double>()] = it2->at("value").get<double>();
             }
             continue;
         }
         if (position == "kn-") {
             for (auto it2 = it->begin(); it2!=it->end(); ++it2) {
-                Kn[1][(*it2)["speed"].get<double>()] = (*it2)["value"].get<double>();
+                Kn[1][it2->at("speed").get<double>()] = it2->at("value").get<double>();
             }
             continue;
         }
         int p = position=="passenger" ? 0 : 1;
         for (auto it2 = it->begin(); it2!=it->end(); ++it2) {
             double sbaccel = stod(it2.key());
-            json &curves = (*it2)["curves"];
+            const json &curves = section(*it2, "curves");
             for (auto it3 = curves.begin(); it3!=curves.end(); ++it3) {
-                json &step = *it3;
-                double spd = step["speed"].get<double>()/3.6;
-                A_brake_normal_service_combination[p][sbaccel][spd] = step["value"].get<double>();
+                const json &step = *it3;
+                double spd = step.at("speed").get<double>()/3.6;
+                A_brake_normal_service_combination[p][sbaccel][spd] = step.at("value").get<double>();
             }
         }
     }
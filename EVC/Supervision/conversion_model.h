@@ -15,7 +15,7 @@
 #define EP_AVAILABLE 2
 #define MAGNETIC_AVAILABLE 3
 using json = nlohmann::json;
-void set_brake_model(json &traindata);
+void set_brake_model(const json &traindata);
 void set_conversion_model();
 acceleration get_A_gradient(const std::map<dist_base, double> &gradient, double default_gradient);
 extern double T_brake_emergency_cm0;
@@ -39,6 +39,8 @@ struct gradient_profile_element
 };
 std::list<gradient_profile_element> gradient_profile;
 std::map<dist_base, double> gradient;
+unsigned MRSP_version;
+unsigned gradient_version;
 int default_gradient_tsr;
 void delete_back_info()
 {
@@ -136,6 +138,7 @@ void recalculate_MRSP()
     delete_back_info();
     recalculate_gradient();
     MRSP.clear();
+    MRSP_version++;
     std::list<std::reference_wrapper<speed_restriction>> restrictions;
     if (mode == Mode::FS || mode == Mode::OS || mode == Mode::LS)
         restrictions.insert(restrictions.end(), SSP.begin(), SSP.end());
@@ -261,6 +264,7 @@ void update_gradient(std::vector<std::pair<distance,double>> grad)
 void recalculate_gradient()
 {
     gradient.clear();
+    gradient_version++;
     std::set<dist_base> critical_points;
     for (auto it = gradient_profile.begin(); it != gradient_profile.end(); ++it) {
         critical_points.insert(it->start.max);
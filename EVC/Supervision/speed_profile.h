@@ -32,6 +32,10 @@ void delete_TSR(const distance &from);
 void delete_PBD();
 void delete_PBD(const distance &from);
 std::map<relocable_dist_base,double,std::less<>> &get_MRSP();
+// Incremented each time the MRSP or the gradient map are rebuilt, so that
+// data derived from them can be kept until they change
+extern unsigned MRSP_version;
+extern unsigned gradient_version;
 inline double dV_ebi(double vel)
 {
     return std::max(dV_ebi_min, std::min(dV_ebi_min*(dV_ebi_max - dV_ebi_min)/(V_ebi_max-V_ebi_min)*(vel-V_ebi_min), dV_ebi_max));
@@ -52,17 +52,23 @@ double T_bs;
 double T_bs1;
 double T_bs2;
 double T_be;
+static safe_front_scratch ceiling_scratch;
 double calc_ceiling_limit()
 {
     auto &MRSP = get_MRSP();
+    std::vector<const relocable_dist_base*> &refs = ceiling_scratch.refs;
+    refs.clear();
+    for (auto &it : MRSP)
+        refs.push_back(&it.first);
+    safe_front_context::current().evaluate(refs.data(), refs.size(), ceiling_scratch);
+    const std::vector<dist_base> &min = ceiling_scratch.minsafe, &max = ceiling_scratch.maxsafe;
     double V_MRSP = 1000;
-    for (auto it = MRSP.begin(); it!=MRSP.end(); ++it) {
+    size_t i = 0;
+    for (auto it = MRSP.begin(); it!=MRSP.end(); ++it, ++i) {
         auto &d = it->first;
-        dist_base min = d_minsafefront(d);
-        dist_base max = d_maxsafefront(d);
         auto next = it;
         ++next;
-        if (max >= d && (next == MRSP.end() || min < next->first))
+        if (max[i] >= d && (next == MRSP.end() || min[i] < next->first))
             V_MRSP = std::min(it->second, V_MRSP);
     }
     return V_MRSP;
@@ -138,14 +138,15 @@ void target::calculate_curves(double V_est, double A_est, double V_delta) const
         d_I = d_P - T_indication*V_est;
         
         double D_be_display = (V_est+V_delta0+V_delta1/2)*T_traction + (V_est + V_delta0 + V_delta1 + V_delta2/2)*T_berem;
-        dist_base v_sbi_dappr = d_maxsafefront(d_target) + V_est*T_bs2 + D_be_display;
+        dist_base d_maxsafe = d_maxsafefront(d_target);
+        dist_base v_sbi_dappr = d_maxsafe + V_est*T_bs2 + D_be_display;
         V_SBI2 = v_sbi_dappr < get_distance_curve(V_target) ? std::max(get_speed_curve(v_sbi_dappr)-(V_delta0+V_delta1+V_delta2),V_target + dV_sbi(V_target)) : (V_target + dV_sbi(V_target));
         
-        dist_base v_p_dappr = d_maxsafefront(d_target) + V_est*(T_driver+T_bs2) + D_be_display;
-        if (v_p_dappr < get_distance_curve(V_target) || (Q_NVGUIPERM && d_maxsafefront(d_target) < get_distance_gui_curve(V_target))) {
+        dist_base v_p_dappr = d_maxsafe + V_est*(T_driver+T_bs2) + D_be_display;
+        if (v_p_dappr < get_distance_curve(V_target) || (Q_NVGUIPERM && d_maxsafe < get_distance_gui_curve(V_target))) {
             V_P = get_speed_curve(v_p_dappr) - (V_delta0+V_delta1+V_delta2);
             if (Q_NVGUIPERM)
-                V_P = std::min(V_P, get_speed_gui_curve(d_maxsafefront(d_target)));
+                V_P = std::min(V_P, get_speed_gui_curve(d_maxsafe));
             V_P = std::max(V_P, V_target);
         } else {
             V_P = V_target;
@@ -181,6 +182,7 @@ double V_releaseSvL=0;
 static std::list<std::shared_ptr<target>> supervised_targets;
 bool changed = false;
 void recalculate_all_decelerations();
+static safe_front_scratch targets_scratch;
 void set_supervised_targets()
 {
     update_brake_contributions();
@@ -190,10 +192,17 @@ void set_supervised_targets()
     if (mode != Mode::SR && mode != Mode::UN && mode != Mode::FS && mode != Mode::OS && mode != Mode::LS) return;
     auto &MRSP = get_MRSP();
     if (!MRSP.empty()) {
+        std::vector<const relocable_dist_base*> &refs = targets_scratch.refs;
+        refs.clear();
+        for (auto &it : MRSP)
+            refs.push_back(&it.first);
+        safe_front_context::current().evaluate(refs.data(), refs.size(), targets_scratch);
+        const std::vector<dist_base> &maxsafe = targets_scratch.maxsafe;
+        size_t i = 1;
         auto minMRSP = MRSP.begin();
         auto prev = minMRSP;
-        for (auto it=++minMRSP; it!=MRSP.end(); ++it) {
-            if (it->second < prev->second && d_maxsafefront(it->first)<it->first) {
+        for (auto it=++minMRSP; it!=MRSP.end(); ++it, ++i) {
+            if (it->second < prev->second && maxsafe[i]<it->first) {
                 bool is_TSR = false;
                 for (auto &tsr : TSRs) {
                     if (it->first == tsr.restriction.get_start() && it->second == tsr.restriction.get_speed()) {
@@ -230,8 +239,9 @@ void set_supervised_targets()
 bool supervised_targets_changed()
 {
     bool removed = false;
+    safe_front_context ctx = safe_front_context::current();
     for (auto it = supervised_targets.begin(); it!=supervised_targets.end(); ) {
-        if ((*it)->type == target_class::MRSP && d_maxsafefront((*it)->get_target_position()) >= (*it)->get_target_position()) {
+        if ((*it)->type == target_class::MRSP && ctx.maxsafefront((*it)->get_target_position()) >= (*it)->get_target_position()) {
             removed = true;
             it = supervised_targets.erase(it);
         } else {
@@ -41,7 +41,7 @@ public:
         is_EBD_based = type != target_class::EoA;
     }
     double get_target_speed() const { return V_target; }
-    relocable_dist_base get_target_position() const { return d_target; }
+    const relocable_dist_base &get_target_position() const { return d_target; }
     bool operator== (const basic_target &t) const
     {
         return V_target == t.V_target && std::abs(d_target-t.d_target)<2.1f && (int)type==(int)t.type;
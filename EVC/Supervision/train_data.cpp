@@ -12,7 +12,7 @@
 #include "../Supervision/speed_profile.h"
 #include "../TrainSubsystems/brake.h"
 #include <list>
-#include "platform_runtime.h"
+#include "config_store.h"
 using json = nlohmann::json;
 double A_ebmax;
 double L_TRAIN=0;
@@ -41,16 +41,13 @@ void set_train_data(std::string spec)
     conversion_model_used = false;
     train_category = "";
     if (!special_train_data.empty()) {
-        json j;
-        auto contents = platform->read_file(traindata_file);
-        if (contents)
-            j = json::parse(*contents);
-        if (j.contains(special_train_data)) {
+        ConfigStore::Document j = config_store.get(traindata_file);
+        if (j && j->contains(special_train_data)) {
             train_data_valid = true;
-            json &traindata = j[special_train_data];
-            if (traindata.contains("brake_percentage")) brake_percentage = (int)traindata["brake_percentage"].get<double>();
-            L_TRAIN = traindata["length"].get<double>();
-            V_train = traindata["speed"].get<double>()/3.6;
+            const json &traindata = j->at(special_train_data);
+            if (traindata.contains("brake_percentage")) brake_percentage = (int)traindata.at("brake_percentage").get<double>();
+            L_TRAIN = traindata.at("length").get<double>();
+            V_train = traindata.at("speed").get<double>()/3.6;
             set_train_max_speed(V_train);
             if (!traindata.contains("brakes")) {
                 set_conversion_model();
@@ -59,10 +56,10 @@ void set_train_data(std::string spec)
             } else {
                 set_brake_model(traindata);
             }
-            cant_deficiency = (int)traindata["cant_deficiency"].get<double>();
-            T_traction_cutoff = traindata["t_traction_cutoff"].get<double>();
-            Q_airtight = traindata["airtight"].get<int>();
-            std::string gauge = traindata.contains("loading_gauge") ? traindata["loading_gauge"].get<std::string>() : "";
+            cant_deficiency = (int)traindata.at("cant_deficiency").get<double>();
+            T_traction_cutoff = traindata.at("t_traction_cutoff").get<double>();
+            Q_airtight = traindata.at("airtight").get<int>();
+            std::string gauge = traindata.contains("loading_gauge") ? traindata.at("loading_gauge").get<std::string>() : "";
             if (gauge == "G1")
                 loading_gauge = loading_gauges::G1;
             else if (gauge == "GA")
@@ -73,7 +70,7 @@ void set_train_data(std::string spec)
                 loading_gauge = loading_gauges::GC;
             else 
                 loading_gauge = loading_gauges::OutGC;
-            std::string axleload = traindata.contains("axle_load_category") ? traindata["axle_load_category"].get<std::string>() : "";
+            std::string axleload = traindata.contains("axle_load_category") ? traindata.at("axle_load_category").get<std::string>() : "";
             if (axleload == "A")
                 axle_load_category = axle_load_categories::A;
             else if (axleload == "HS17")
@@ -100,10 +97,12 @@ void set_train_data(std::string spec)
                 axle_load_category = axle_load_categories::E4;
             else
                 axle_load_category = axle_load_categories::E5;
-            json &tracts = traindata["traction_systems"];
+            auto tracts_it = traindata.find("traction_systems");
+            static const json no_tracts;
+            const json &tracts = tracts_it != traindata.end() ? *tracts_it : no_tracts;
             traction_systems.clear();
             for (auto it = tracts.begin(); it != tracts.end(); ++it) {
-                std::string name = (*it)["name"].get<std::string>();
+                std::string name = it->at("name").get<std::string>();
                 Electrifications elec;
                 if (name == "DC600/750V")
                     elec = DC600_750V;
@@ -119,7 +118,7 @@ void set_train_data(std::string spec)
                     elec = NonElectrical;
                 int info = 0;
                 if (elec != NonElectrical)
-                    info = (*it)["nid_ctraction"].get<int>();
+                    info = it->at("nid_ctraction").get<int>();
                 traction_systems.push_back({elec,info});
             }
         }
@@ -14,6 +14,7 @@
 #include "../Position/linking.h"
 #include "../Procedures/level_transition.h"
 #include "platform_runtime.h"
+#include <optional>
 int cold_movement_status;
 void initialize_cold_movement()
 {
@@ -41,21 +42,31 @@ void initialize_cold_movement()
     load_train_position();
     load_level();
 }
+// cold_data.json is only written by this EVC, so it is parsed once and
+// then kept in memory; saves update the cached tree and write it through
+static json &cold_data()
+{
+    static std::optional<json> j;
+    if (!j) {
+        auto contents = platform->read_file("cold_data.json", ETCS_STORAGE_FILE);
+        if (contents)
+            j = json::parse(*contents, nullptr, false);
+        if (!j || j->is_discarded())
+            j = json::object();
+    }
+    return *j;
+}
 void save_cold_data(std::string field, json &value)
 {
-    auto contents = platform->read_file("cold_data.json", ETCS_STORAGE_FILE);
-    json j;
-    if (contents)
-        j = json::parse(*contents);
+    json &j = cold_data();
     j[field] = value;
-    platform->write_file("cold_data.json", j.dump());
+    platform->write_file_async("cold_data.json", j.dump());
 }
 json load_cold_data(std::string field)
 {
-    auto contents = platform->read_file("cold_data.json", ETCS_STORAGE_FILE);
-    if (!contents)
+    json &j = cold_data();
+    auto it = j.find(field);
+    if (it == j.end())
         return json();
-    json j = json::parse(*contents);
-    if (!j.contains(field)) j[field] = json();
-    return j[field];
+    return *it;
 }
\ No newline at end of file
@@ -209,6 +209,7 @@ void update()
     update_national_functions();
     update_train_subsystems();
     update_dmi_windows();
+    update_dmi();
     update_track_ahead_free_request();
     for (auto *session : active_sessions) {
         session->send_pending();
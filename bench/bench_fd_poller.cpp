@@ -0,0 +1,110 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// Event loop cost of the poll() and epoll pollers with many connections
+// of which only a few are active, as on a bus server hosting a fleet of
+// simulated EVCs. Each connection is a socket pair whose reading end
+// waits for POLLIN and registers again once it has been drained, like a
+// TcpSocket does.
+
+#include "console_fd_poller.h"
+#include "epoll_fd_poller.h"
+#include "platform_runtime.h"
+#include <chrono>
+#include <cstdio>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+static constexpr int ACTIVE = 4;
+static constexpr int ROUNDS = 5000;
+
+template <typename Poller>
+struct Connection {
+	Poller *poller;
+	int fds[2];
+	int *handled;
+	PlatformUtil::Promise<short> ready;
+
+	void wait() {
+		ready = poller->on_fd_ready(fds[0], POLLIN).then([this](short) {
+			char c;
+			while (::read(fds[0], &c, 1) == 1)
+				(*handled)++;
+			wait();
+		});
+	}
+};
+
+// Average time of one loop iteration in which ACTIVE connections have
+// data, or a negative value if some wakeup got lost
+template <typename Poller>
+static double run(int count) {
+	Poller poller;
+	int handled = 0;
+	std::vector<Connection<Poller>> conns(count);
+	for (auto &c : conns) {
+		c.poller = &poller;
+		c.handled = &handled;
+		if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, c.fds) != 0)
+			return -1;
+		c.wait();
+	}
+
+	auto round = [&](int r) {
+		for (int i = 0; i < ACTIVE; i++)
+			::write(conns[(r * ACTIVE + i) % count].fds[1], "x", 1);
+		int expected = handled + ACTIVE;
+		for (int spins = 0; handled < expected && spins < 100; spins++) {
+			poller.poll(10);
+			while (PlatformUtil::DeferredFulfillment::execute());
+		}
+		return handled == expected;
+	};
+
+	bool ok = true;
+	for (int r = 0; r < 100; r++)
+		ok &= round(r);
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < ROUNDS; r++)
+		ok &= round(r);
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+
+	for (auto &c : conns) {
+		c.ready = {};
+		poller.forget_fd(c.fds[0]);
+		::close(c.fds[0]);
+		::close(c.fds[1]);
+	}
+	return ok ? ns : -1;
+}
+
+int main() {
+	PlatformUtil::DeferredQueue queue;
+	PlatformUtil::DeferredFulfillment::list = &queue;
+
+	// Two descriptors per connection
+	rlimit lim;
+	if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+		lim.rlim_cur = lim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &lim);
+	}
+
+	int failures = 0;
+	printf("%d of N connections active per iteration, ns per iteration\n", ACTIVE);
+	printf("%8s %12s %12s\n", "N", "poll", "epoll");
+	for (int count : { 8, 64, 256, 1024 }) {
+		if (2 * count + 16 > (int)lim.rlim_cur)
+			break;
+		double p = run<ConsoleFdPoller>(count);
+		double e = run<EpollFdPoller>(count);
+		printf("%8d %12.0f %12.0f\n", count, p, e);
+		failures += (p < 0) + (e < 0);
+	}
+	PlatformUtil::DeferredFulfillment::list = nullptr;
+	return failures != 0;
+}
@@ -0,0 +1,122 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// Cost of promise dispatch through the deferred fulfilment queue, and the
+// heap allocations it makes once warmed up. Any allocation fails the run.
+
+#include "platform_util.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+	allocations++;
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+static constexpr int WARMUP = 1000;
+static constexpr int ROUNDS = 1000000;
+
+static int failures = 0;
+
+// Runs round() ROUNDS times after warming up, and prints the time and
+// allocations per round
+template <typename F>
+static void measure(const char *name, F round) {
+	for (int i = 0; i < WARMUP; i++)
+		round();
+	size_t before = allocations;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ROUNDS; i++)
+		round();
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+	double allocs = (double)(allocations - before) / ROUNDS;
+	printf("%-28s %8.1f ns %8.3f allocations\n", name, ns, allocs);
+	if (allocs > 0)
+		failures++;
+}
+
+static void drain() {
+	while (PlatformUtil::DeferredFulfillment::execute());
+}
+
+int main() {
+	using namespace PlatformUtil;
+	DeferredQueue queue;
+	DeferredFulfillment::list = &queue;
+	printf("time and heap allocations per round, after %d warm-up rounds\n", WARMUP);
+
+	// A receive loop, which registers again from its own callback
+	{
+		FulfillerBufferedQueue<int> rx;
+		long sum = 0;
+		struct Loop {
+			FulfillerBufferedQueue<int> *rx;
+			long *sum;
+			void arm() {
+				rx->create_and_add().then([this](int &&v) { *sum += v; arm(); }).detach();
+			}
+		} loop { &rx, &sum };
+		loop.arm();
+		measure("buffered queue, re-armed", [&]() {
+			rx.push_data(1);
+			drain();
+		});
+		if (sum != WARMUP + ROUNDS)
+			failures++;
+	}
+
+	// Several listeners woken at once, like the present request
+	{
+		FulfillerList<void> list;
+		int woken = 0;
+		struct Listener {
+			FulfillerList<void> *list;
+			int *woken;
+			void arm() {
+				list->create_and_add().then([this]() { (*woken)++; arm(); }).detach();
+			}
+		} listeners[4];
+		for (auto &l : listeners) {
+			l = { &list, &woken };
+			l.arm();
+		}
+		measure("list of 4, fulfilled at once", [&]() {
+			list.fulfill_all();
+			drain();
+		});
+		if (woken != 4 * (WARMUP + ROUNDS))
+			failures++;
+	}
+
+	// A one-shot promise, created, chained and fulfilled each time, as
+	// for delay()
+	{
+		int fired = 0;
+		measure("one-shot promise", [&]() {
+			auto pair = PromiseFactory::create<void>();
+			pair.first.then([&fired]() { fired++; }).detach();
+			pair.second.fulfill();
+			drain();
+		});
+		if (fired != WARMUP + ROUNDS)
+			failures++;
+	}
+
+	DeferredFulfillment::list = nullptr;
+	return failures != 0;
+}
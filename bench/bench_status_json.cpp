@@ -0,0 +1,217 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Time the DMI takes to read the json(...) messages of a bus recording,
+// through read_status_json() and through the document based reading it
+// replaced, which is kept below. Both must give the same status.
+//   bench_status_json <recording>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "../DMI/tcp/status_reader.h"
+static const int ROUNDS = 20;
+static const int LEVEL_NTC = 1;
+static const int TRACTION_SYSTEM_CHANGE = 13;
+void from_json(const json &j, dmi_status::speed_target &e)
+{
+    e.distance = j["DistanceToTrainM"].get<double>();
+    e.speed = j["TargetSpeedMpS"].get<double>();
+}
+void from_json(const json &j, dmi_status::gradient &e)
+{
+    e.distance = j["DistanceToTrainM"].get<double>();
+    e.value = j["GradientPerMille"].get<double>();
+}
+void from_json(const json &j, dmi_status::track_condition &e)
+{
+    e.distance = j["DistanceToTrainM"].get<double>();
+    e.type = j["Type"].get<int>();
+    e.yellow = j["YellowColour"].get<bool>();
+    e.traction = e.type == TRACTION_SYSTEM_CHANGE ? j["TractionSystem"].get<int>() : 0;
+}
+static void status_from_json(json &j, dmi_status &s)
+{
+    s.update_id = j.value("UpdateId", 0u);
+    s.allowed_speed = j["AllowedSpeedMpS"].get<double>();
+    s.target_speed = j["TargetSpeedMpS"].get<double>();
+    s.intervention_speed = j["InterventionSpeedMpS"].get<double>();
+    s.target_distance = j["TargetDistanceM"].get<double>();
+    s.release_speed = j["ReleaseSpeedMpS"].get<double>();
+    s.speed = j["SpeedMpS"].get<double>();
+    s.time_to_permitted = j["TimeToPermittedS"].get<double>();
+    s.time_to_indication = j["TimeToIndicationS"].get<double>();
+    s.monitoring = j["CurrentMonitoringStatus"].get<int>();
+    s.supervision = j["CurrentSupervisionStatus"].get<int>();
+    s.mode = j["CurrentMode"].get<int>();
+    s.level = j["CurrentLevel"].get<int>();
+    s.slippery_rail = j["SlipperyRail"].get<bool>();
+    s.bot_driver = j["BotDriver"].get<bool>();
+    if (s.level == LEVEL_NTC) s.ntc = j["CurrentNTC"].get<int>();
+    if (!j["GeographicalPositionKM"].is_null()) s.geographical_position = j["GeographicalPositionKM"].get<double>();
+    json &clock = j["WallClockTime"];
+    s.hour = clock["Hour"];
+    s.minute = clock["Minute"];
+    s.second = clock["Second"];
+    if (!j["ModeAcknowledgement"].is_null()) s.mode_acknowledgement = j["ModeAcknowledgement"].get<int>();
+    if (!j["LevelTransition"].is_null())
+    {
+        json &transition = j["LevelTransition"];
+        int level = transition["Level"].get<int>();
+        int ntc = level == LEVEL_NTC ? transition["NTC"].get<int>() : 0;
+        s.level_transition = dmi_status::level_change{level, ntc, transition["Acknowledge"].get<bool>()};
+    }
+    s.override_active = j["OverrideActive"].get<bool>();
+    s.radio_status = j["RadioStatus"].get<int>();
+    s.brake_commanded = j["BrakeCommanded"].get<bool>();
+    s.display_taf = j["DisplayTAF"].get<bool>();
+    if (j.contains("LSSMA")) s.lssma = j["LSSMA"].get<double>();
+    s.allowed_ack = j.contains("AllowedAck") && j["AllowedAck"];
+    s.brake_acknowledge = j["BrakeAcknowledge"].get<bool>();
+    s.speed_targets = j["SpeedTargets"].get<std::vector<dmi_status::speed_target>>();
+    if (!j["IndicationMarkerDistanceM"].is_null()) s.indication_marker_distance = j["IndicationMarkerDistanceM"].get<double>();
+    if (!j["IndicationMarkerTarget"].is_null()) s.indication_marker_target = j["IndicationMarkerTarget"].get<dmi_status::speed_target>();
+    s.gradients = j["GradientProfile"].get<std::vector<dmi_status::gradient>>();
+    s.track_conditions = j["PlanningTrackConditions"].get<std::vector<dmi_status::track_condition>>();
+    s.active_track_conditions = j["ActiveTrackConditions"].get<std::vector<int>>();
+}
+// Arguments of the json(...) messages in a recording
+static std::vector<std::string> read_messages(const char *path)
+{
+    std::vector<std::string> messages;
+    std::ifstream file(path, std::ios::binary);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream header(line);
+        long long time;
+        char type;
+        unsigned tid, uid;
+        size_t len;
+        if (!(header >> time >> type) || type != 'M' || !(header >> tid >> uid >> len))
+            continue;
+        std::string data(len, '\0');
+        file.read(&data[0], len);
+        file.ignore(1);
+        if (data.size() > 6 && data.compare(0, 5, "json(") == 0 && data.back() == ')')
+            messages.push_back(data.substr(5, data.size() - 6));
+    }
+    return messages;
+}
+template <typename T>
+static bool same_optional(const std::optional<T> &a, const std::optional<T> &b, bool (*equal)(const T &, const T &))
+{
+    return a.has_value() == b.has_value() && (!a || equal(*a, *b));
+}
+static bool same_value(const double &a, const double &b)
+{
+    return a == b;
+}
+static bool same_int(const int &a, const int &b)
+{
+    return a == b;
+}
+static bool same_target(const dmi_status::speed_target &a, const dmi_status::speed_target &b)
+{
+    return a.distance == b.distance && a.speed == b.speed;
+}
+static bool same_transition(const dmi_status::level_change &a, const dmi_status::level_change &b)
+{
+    return a.level == b.level && a.ntc == b.ntc && a.acknowledge == b.acknowledge;
+}
+// Every member that the JSON carries
+static bool same(const dmi_status &a, const dmi_status &b)
+{
+    if (a.update_id != b.update_id || a.bot_driver != b.bot_driver || a.slippery_rail != b.slippery_rail ||
+        a.override_active != b.override_active || a.brake_commanded != b.brake_commanded || a.brake_acknowledge != b.brake_acknowledge ||
+        a.display_taf != b.display_taf || a.allowed_ack != b.allowed_ack || a.reversing_permitted != b.reversing_permitted ||
+        a.allowed_speed != b.allowed_speed || a.intervention_speed != b.intervention_speed || a.target_speed != b.target_speed ||
+        a.target_distance != b.target_distance || a.speed != b.speed || a.release_speed != b.release_speed ||
+        a.time_to_permitted != b.time_to_permitted || a.time_to_indication != b.time_to_indication ||
+        a.monitoring != b.monitoring || a.supervision != b.supervision || a.mode != b.mode || a.level != b.level || a.ntc != b.ntc ||
+        a.radio_status != b.radio_status || a.hour != b.hour || a.minute != b.minute || a.second != b.second)
+        return false;
+    if (!same_optional(a.mode_acknowledgement, b.mode_acknowledgement, same_int) ||
+        !same_optional(a.level_transition, b.level_transition, same_transition) ||
+        !same_optional(a.geographical_position, b.geographical_position, same_value) ||
+        !same_optional(a.lssma, b.lssma, same_value) ||
+        !same_optional(a.indication_marker_distance, b.indication_marker_distance, same_value) ||
+        !same_optional(a.indication_marker_target, b.indication_marker_target, same_target))
+        return false;
+    if (a.speed_targets.size() != b.speed_targets.size() || a.gradients.size() != b.gradients.size() ||
+        a.track_conditions.size() != b.track_conditions.size() || a.active_track_conditions != b.active_track_conditions)
+        return false;
+    for (size_t i = 0; i < a.speed_targets.size(); i++) {
+        if (!same_target(a.speed_targets[i], b.speed_targets[i]))
+            return false;
+    }
+    for (size_t i = 0; i < a.gradients.size(); i++) {
+        if (a.gradients[i].distance != b.gradients[i].distance || a.gradients[i].value != b.gradients[i].value)
+            return false;
+    }
+    for (size_t i = 0; i < a.track_conditions.size(); i++) {
+        auto &x = a.track_conditions[i], &y = b.track_conditions[i];
+        if (x.distance != y.distance || x.type != y.type || x.yellow != y.yellow || x.traction != y.traction)
+            return false;
+    }
+    return true;
+}
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <recording>\n", argv[0]);
+        return 1;
+    }
+    std::vector<std::string> messages = read_messages(argv[1]);
+    if (messages.empty()) {
+        fprintf(stderr, "no json messages in %s\n", argv[1]);
+        return 1;
+    }
+    size_t bytes = 0;
+    for (auto &m : messages)
+        bytes += m.size();
+
+    int failures = 0;
+    for (auto &m : messages) {
+        json j = json::parse(m);
+        dmi_status dom, sax;
+        status_from_json(j["Status"], dom);
+        bool has_status;
+        json rest;
+        if (!read_status_json(m, sax, has_status, rest) || !has_status || !same(dom, sax) || rest["ActiveWindow"] != j["ActiveWindow"])
+            failures++;
+    }
+
+    double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (auto &m : messages) {
+            json j = json::parse(m);
+            dmi_status s;
+            status_from_json(j["Status"], s);
+            sink += s.speed + j["ActiveWindow"].size();
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (auto &m : messages) {
+            dmi_status s;
+            bool has_status;
+            json rest;
+            read_status_json(m, s, has_status, rest);
+            sink += s.speed + rest["ActiveWindow"].size();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double count = (double)ROUNDS * messages.size();
+    printf("%zu messages, %zu bytes on average (checksum %g)\n", messages.size(), bytes / messages.size(), sink);
+    printf("document     %8.2f us per message\n", std::chrono::duration<double, std::micro>(middle - start).count() / count);
+    printf("sax          %8.2f us per message\n", std::chrono::duration<double, std::micro>(end - middle).count() / count);
+    if (failures)
+        printf("%d messages read differently\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,148 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+// Round trip latency of the shared memory and TCP stream transports
+// between two processes on the same host. A child process echoes every
+// message back, and the parent sends the next message once the previous
+// one has returned, as the EVC and DMI exchange a status and its reply.
+
+#include "shm_socket.h"
+#include "tcp_listener.h"
+#include "epoll_fd_poller.h"
+#include "platform_runtime.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static constexpr int PORT = 47321;
+static constexpr int WARMUP = 1000;
+static constexpr int ROUNDS = 20000;
+static constexpr size_t MESSAGE_SIZE = 200;
+
+static void spin(EpollFdPoller &poller, int timeout) {
+	while (PlatformUtil::DeferredFulfillment::execute());
+	poller.poll(timeout);
+	while (PlatformUtil::DeferredFulfillment::execute());
+}
+
+template <typename Listener>
+static void echo(Listener &listener, EpollFdPoller &poller, int ready_fd) {
+	std::vector<std::unique_ptr<StreamSocket>> sockets;
+	std::vector<PlatformUtil::Promise<std::string>> receives;
+	bool done = false;
+	std::function<void(StreamSocket*)> receive = [&](StreamSocket *s) {
+		receives.push_back(s->receive().then([&, s](std::string &&data) {
+			if (data.empty()) {
+				done = true;
+				return;
+			}
+			s->send(data);
+			receive(s);
+		}));
+	};
+	auto accepted = listener.accept().then([&](auto &&s) {
+		sockets.push_back(std::move(s));
+		receive(sockets.back().get());
+	});
+	::write(ready_fd, "r", 1);
+	while (!done)
+		spin(poller, 100);
+}
+
+// Returns the sorted round trip times in microseconds, empty on failure
+static std::vector<double> measure(StreamSocket &socket, EpollFdPoller &poller) {
+	std::string received;
+	bool closed = false;
+	PlatformUtil::Promise<std::string> receiving;
+	std::function<void()> receive = [&]() {
+		receiving = socket.receive().then([&](std::string &&data) {
+			if (data.empty()) {
+				closed = true;
+				return;
+			}
+			received += data;
+			receive();
+		});
+	};
+	receive();
+
+	std::string message(MESSAGE_SIZE, 'm');
+	std::vector<double> times;
+	times.reserve(ROUNDS);
+	for (int i = 0; i < WARMUP + ROUNDS && !closed; i++) {
+		received.clear();
+		auto start = std::chrono::steady_clock::now();
+		socket.send(message);
+		while (received.size() < message.size() && !closed)
+			spin(poller, 100);
+		if (i >= WARMUP)
+			times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+	if (closed || received != message)
+		return {};
+	std::sort(times.begin(), times.end());
+	return times;
+}
+
+static bool run(bool shm) {
+	std::string name = "bench-transport-" + std::to_string(getpid());
+	int ready[2];
+	if (::pipe(ready) != 0)
+		return false;
+	pid_t pid = fork();
+	if (pid == 0) {
+		EpollFdPoller poller;
+		if (shm) {
+			ShmListener listener(name, poller);
+			echo(listener, poller, ready[1]);
+		} else {
+			TcpListener listener("127.0.0.1", PORT, poller);
+			echo(listener, poller, ready[1]);
+		}
+		_exit(0);
+	}
+	char c;
+	bool started = ::read(ready[0], &c, 1) == 1;
+	::close(ready[0]);
+	::close(ready[1]);
+
+	std::vector<double> times;
+	if (started) {
+		EpollFdPoller poller;
+		std::unique_ptr<StreamSocket> socket;
+		if (shm)
+			socket = std::make_unique<ShmSocket>(name, poller);
+		else
+			socket = std::make_unique<TcpSocket>("127.0.0.1", PORT, poller);
+		times = measure(*socket, poller);
+		socket = nullptr;
+		spin(poller, 1);
+	}
+	int status;
+	waitpid(pid, &status, 0);
+
+	if (times.empty()) {
+		printf("%-5s failed\n", shm ? "shm" : "tcp");
+		return false;
+	}
+	auto percentile = [&times](int p) { return times[std::min(times.size() - 1, times.size() * p / 100)]; };
+	printf("%-5s %8.2f %8.2f %8.2f %8.2f\n", shm ? "shm" : "tcp", percentile(50), percentile(90), percentile(99), times.back());
+	return true;
+}
+
+int main() {
+	PlatformUtil::DeferredQueue queue;
+	PlatformUtil::DeferredFulfillment::list = &queue;
+	printf("round trip of %zu byte messages in us, %d rounds\n", MESSAGE_SIZE, ROUNDS);
+	printf("%-5s %8s %8s %8s %8s\n", "", "p50", "p90", "p99", "max");
+	bool ok = run(true);
+	ok &= run(false);
+	PlatformUtil::DeferredFulfillment::list = nullptr;
+	return !ok;
+}
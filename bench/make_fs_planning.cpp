@@ -0,0 +1,140 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+// Writes data/fs_planning.rec, the bus recording replayed by the DMI
+// benchmarks: 20 seconds of EVC to DMI traffic for a train in FS mode,
+// level 2, running through a line with frequent speed, gradient and
+// track condition changes, so that the planning area is full. Along the
+// way it announces a level transition, asks for a mode acknowledgement
+// and sets the optional indications, so that every member is sent. Messages
+// are built as send_dmi_status() builds them for a DMI that has not
+// asked for the binary status. A marker halfway through takes a snapshot
+// of the screen for comparison between versions.
+//   make_fs_planning <output>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+struct line_element
+{
+    double position;
+    double value;
+};
+static const double PERIOD = 0.1;
+static const int STEPS = 200;
+static const double PLANNING_RANGE = 8000;
+static uint32_t fourcc(const char *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | (uint32_t)p[3];
+}
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <output>\n", argv[0]);
+        return 1;
+    }
+    // Static speed profile, gradients and track conditions along the line
+    std::vector<line_element> mrsp, gradients, conditions;
+    for (int i = 0; i < 40; i++)
+        mrsp.push_back({i * 800.0, (i % 4 == 3 ? 22.2 : 44.4) - (i % 3) * 2.8});
+    for (int i = 0; i < 40; i++)
+        gradients.push_back({i * 700.0, (double)((i * 7) % 21 - 10)});
+    static const int condition_types[] = {1, 2, 3, 4, 12, 13};
+    for (int i = 0; i < 24; i++)
+        conditions.push_back({350 + i * 1100.0, (double)condition_types[i % 6]});
+
+    std::ofstream out(argv[1], std::ios::binary);
+    out << "0 J " << fourcc("EVC_") << " 1\n";
+    double front = 0;
+    double speed = 38;
+    uint32_t update_id = 0;
+    for (int step = 0; step < STEPS; step++) {
+        double time = step * PERIOD;
+        // Accelerates and brakes in turns, as when following the MRSP
+        speed += (std::fmod(time, 12) < 6 ? 0.4 : -0.5) * PERIOD;
+        front += speed * PERIOD;
+
+        json s;
+        s["UpdateId"] = ++update_id;
+        s["BotDriver"] = false;
+        s["SlipperyRail"] = step >= 150;
+        s["AllowedSpeedMpS"] = 44.4;
+        s["InterventionSpeedMpS"] = 47.2;
+        s["TargetSpeedMpS"] = 22.2;
+        s["TargetDistanceM"] = 1800 - std::fmod(front, 1800);
+        s["SpeedMpS"] = speed;
+        s["ReleaseSpeedMpS"] = 0;
+        s["CurrentMonitoringStatus"] = std::fmod(time, 12) < 6 ? 0 : 1;
+        s["CurrentSupervisionStatus"] = std::fmod(time, 12) < 10 ? 0 : 1;
+        s["CurrentMode"] = 0;
+        s["CurrentLevel"] = 3;
+        s["TimeToPermittedS"] = 12.5;
+        s["TimeToIndicationS"] = 4.0;
+        s["OverrideActive"] = false;
+        s["RadioStatus"] = 2;
+        s["BrakeCommanded"] = step >= 170 && step < 180;
+        s["BrakeAcknowledge"] = false;
+        s["GeographicalPositionKM"] = 120.0 + front / 1000;
+        s["DisplayTAF"] = false;
+        s["AllowedAck"] = step % 7 == 0;
+        s["ReversingPermitted"] = false;
+        int seconds = 12 * 3600 + (int)time;
+        s["WallClockTime"] = {{"Hour", seconds / 3600}, {"Minute", seconds / 60 % 60}, {"Second", seconds % 60}};
+        s["IndicationMarkerTarget"] = {{"DistanceToTrainM", 1800 - std::fmod(front, 1800)}, {"TargetSpeedMpS", 22.2}};
+        s["IndicationMarkerDistanceM"] = 1400 - std::fmod(front, 1800);
+        if (step % 50 < 10)
+            s["LSSMA"] = speed - 2;
+        if (step >= 60 && step < 90)
+            s["LevelTransition"] = {{"Acknowledge", step >= 75}, {"Level", 1}, {"NTC", 20}};
+        if (step >= 120 && step < 140)
+            s["ModeAcknowledgement"] = 2;
+
+        json speeds = json::array();
+        speeds.push_back({{"DistanceToTrainM", 0}, {"TargetSpeedMpS", 44.4}});
+        for (auto &e : mrsp) {
+            if (e.position > front && e.position < front + PLANNING_RANGE)
+                speeds.push_back({{"DistanceToTrainM", e.position - front}, {"TargetSpeedMpS", e.value}});
+        }
+        s["SpeedTargets"] = speeds;
+        json gradient = json::array();
+        for (size_t i = 0; i < gradients.size(); i++) {
+            bool current = i + 1 < gradients.size() && gradients[i + 1].position > front;
+            if ((gradients[i].position > front || current) && gradients[i].position < front + PLANNING_RANGE)
+                gradient.push_back({{"DistanceToTrainM", std::max(gradients[i].position - front, 0.0)}, {"GradientPerMille", (int)gradients[i].value}});
+        }
+        s["GradientProfile"] = gradient;
+        json track = json::array();
+        json active = json::array();
+        for (size_t i = 0; i < conditions.size(); i++) {
+            double d = conditions[i].position - front;
+            int type = (int)conditions[i].value;
+            if (d > -200 && d <= 0)
+                active.push_back((int)i);
+            if (d > 0 && d < PLANNING_RANGE)
+                track.push_back({{"DistanceToTrainM", d}, {"YellowColour", d < 1000}, {"Type", type}, {"TractionSystem", type == 13 ? 2 : 0}});
+        }
+        s["PlanningTrackConditions"] = track;
+        s["ActiveTrackConditions"] = active;
+
+        json j;
+        j["Status"] = s;
+        j["Status"]["TextMessages"] = json::array({{{"Text", "Track ahead free"}, {"FirstGroup", true}, {"Acknowledge", false}}});
+        j["ActiveWindow"] = {{"active", "default"}};
+        std::string msg = "json(" + j.dump() + ")";
+        int64_t ms = std::llround(time * 1000) + 100;
+        out << ms << " M " << fourcc("EVC_") << " 1 " << msg.size() << '\n' << msg << '\n';
+        std::string vset = "setVset(" + std::to_string(0.0) + ")";
+        out << ms << " M " << fourcc("EVC_") << " 1 " << vset.size() << '\n' << vset << '\n';
+        if (step == STEPS / 2)
+            out << ms << " S fs_planning\n";
+    }
+    return out ? 0 : 1;
+}
@@ -274,10 +274,10 @@ struct moFileInfo
 class moBinaryReader
 {
 private:
-    std::string buffer;
+    std::string_view buffer;
     size_t pos;
 public:
-    moBinaryReader(const std::string &s) : buffer(s) {
+    moBinaryReader(std::string_view s) : buffer(s) {
         pos = 0;
     }
 
@@ -371,7 +371,7 @@ class moFileReader
      * all translation-pairs in a map. You can access this map via the method
      * moFileReader::Lookup().
      */
-    moFileReader::eErrorCode ParseData(const std::string &data)
+    moFileReader::eErrorCode ParseData(std::string_view data)
     {
         // Opening the file.
         moBinaryReader stream(data);
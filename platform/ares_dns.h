@@ -69,6 +69,7 @@ class AresQuery : public DNSQuery
         AresQuery *q = (AresQuery*)arg;
         if (!readable && !writable) {
             q->promises.erase(fd);
+            q->poller.forget_fd(fd);
             return;
         }
         q->promises[fd] = q->poller.on_fd_ready(fd, POLLIN|POLLOUT).then([q, fd](int rev) {
@@ -0,0 +1,179 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "async_file_writer.h"
+
+AsyncFileWriter::AsyncFileWriter(FstreamFileImpl &impl, LibcTimeImpl &time) :
+	impl(impl),
+	time(time),
+	next_id(0)
+#ifdef ASYNC_FILE_WRITER_THREAD
+	,
+	busy(false),
+	stopping(false),
+	worker(&AsyncFileWriter::worker_func, this)
+#endif
+{
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+#ifdef ASYNC_FILE_WRITER_THREAD
+	{
+		Lock lock(mtx);
+		stopping = true;
+	}
+	cv.notify_all();
+	worker.join();
+#else
+	while (write_next());
+#endif
+}
+
+PlatformUtil::Promise<bool> AsyncFileWriter::write(const std::string &path, std::string &&contents) {
+	auto pair = PlatformUtil::PromiseFactory::create<bool>();
+	uint64_t id;
+	{
+		Lock lock(mtx);
+		counters.queued_bytes += contents.size();
+		counters.peak_queued_bytes = std::max(counters.peak_queued_bytes, counters.queued_bytes);
+		auto it = std::find_if(queue.begin(), queue.end(), [&path](const Job &job) { return job.path == path; });
+		if (it != queue.end()) {
+			counters.queued_bytes -= it->contents.size();
+			counters.coalesced++;
+			it->contents = std::move(contents);
+			id = it->id;
+		} else {
+			id = next_id++;
+			queue.push_back(Job { id, path, std::move(contents), time.get_timer() });
+		}
+	}
+#ifdef ASYNC_FILE_WRITER_THREAD
+	cv.notify_all();
+#endif
+	waiting[id].push_back(std::move(pair.second));
+	return std::move(pair.first);
+}
+
+bool AsyncFileWriter::write_now(const std::string &path, const std::string_view contents) {
+	std::optional<uint64_t> replaced;
+	{
+#ifdef ASYNC_FILE_WRITER_THREAD
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock, [this, &path] { return !busy || writing != path; });
+#else
+		Lock lock(mtx);
+#endif
+		auto it = std::find_if(queue.begin(), queue.end(), [&path](const Job &job) { return job.path == path; });
+		if (it != queue.end()) {
+			counters.queued_bytes -= it->contents.size();
+			counters.coalesced++;
+			replaced = it->id;
+			queue.erase(it);
+		}
+	}
+
+	bool ok = impl.write_file(path, contents);
+	// Callers of the replaced write are told about this one instead
+	if (replaced) {
+		Lock lock(mtx);
+		completed.push_back(std::make_pair(*replaced, ok));
+	}
+	return ok;
+}
+
+bool AsyncFileWriter::write_next() {
+	Job job;
+	{
+		Lock lock(mtx);
+		if (queue.empty())
+			return false;
+		job = std::move(queue.front());
+		queue.pop_front();
+#ifdef ASYNC_FILE_WRITER_THREAD
+		busy = true;
+		writing = job.path;
+#endif
+	}
+
+	bool ok = impl.write_file_durable(job.path, job.contents);
+	int64_t latency = time.get_timer() - job.queued_at;
+
+	{
+		Lock lock(mtx);
+		counters.queued_bytes -= job.contents.size();
+		counters.writes++;
+		if (!ok)
+			counters.failed++;
+		counters.last_latency = latency;
+		counters.max_latency = std::max(counters.max_latency, latency);
+		completed.push_back(std::make_pair(job.id, ok));
+#ifdef ASYNC_FILE_WRITER_THREAD
+		busy = false;
+#endif
+	}
+#ifdef ASYNC_FILE_WRITER_THREAD
+	cv.notify_all();
+#endif
+	return true;
+}
+
+bool AsyncFileWriter::notify_completed() {
+	std::vector<std::pair<uint64_t, bool>> done;
+	{
+		Lock lock(mtx);
+		done = std::move(completed);
+		completed.clear();
+	}
+	for (auto &entry : done) {
+		auto it = waiting.find(entry.first);
+		if (it == waiting.end())
+			continue;
+		for (auto &f : it->second)
+			f.fulfill(entry.second);
+		waiting.erase(it);
+	}
+	return !done.empty();
+}
+
+bool AsyncFileWriter::poll() {
+#ifndef ASYNC_FILE_WRITER_THREAD
+	bool wrote = write_next();
+#else
+	bool wrote = false;
+#endif
+	return notify_completed() || wrote;
+}
+
+void AsyncFileWriter::flush() {
+#ifndef ASYNC_FILE_WRITER_THREAD
+	while (write_next());
+#else
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cv.wait(lock, [this] { return queue.empty() && !busy; });
+	}
+#endif
+	notify_completed();
+}
+
+AsyncFileWriter::Stats AsyncFileWriter::stats() {
+	Lock lock(mtx);
+	return counters;
+}
+
+#ifdef ASYNC_FILE_WRITER_THREAD
+void AsyncFileWriter::worker_func() {
+	std::unique_lock<std::mutex> lock(mtx);
+	while (true) {
+		cv.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty())
+			return;
+		lock.unlock();
+		write_next();
+		lock.lock();
+	}
+}
+#endif
@@ -0,0 +1,93 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+
+// The worker never touches promises, which are not thread safe, so it is
+// used even where the platform is built with NO_THREADS. Only targets
+// without any threads write from poll().
+#ifndef __wasm__
+#define ASYNC_FILE_WRITER_THREAD
+#endif
+
+#ifdef ASYNC_FILE_WRITER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+#include "platform.h"
+#include "fstream_file_impl.h"
+#include "libc_time_impl.h"
+
+// Queues file writes so that they do not stall the caller. Writes to a
+// path that is still queued replace the queued contents, and all callers
+// are notified once the latest contents reach the file. Paths are written
+// in the order they were first queued, each one to a temporary file that
+// is synced and then renamed over the target, so that a file is never
+// left half written. A worker thread does the writing; poll() hands its
+// results back to the event loop. Without threads, one file is written
+// per call to poll(), which the event loop makes when idle.
+class AsyncFileWriter : private PlatformUtil::NoCopy {
+public:
+	typedef BasePlatform::FileWriteStats Stats;
+
+private:
+	struct Job {
+		uint64_t id;
+		std::string path;
+		std::string contents;
+		int64_t queued_at;
+	};
+
+#ifdef ASYNC_FILE_WRITER_THREAD
+	typedef std::lock_guard<std::mutex> Lock;
+	std::mutex mtx;
+	std::condition_variable cv;
+#else
+	struct Lock { Lock(int) {} };
+	int mtx;
+#endif
+
+	FstreamFileImpl &impl;
+	LibcTimeImpl &time;
+	uint64_t next_id;
+	std::deque<Job> queue;
+	std::vector<std::pair<uint64_t, bool>> completed;
+	// Only touched from the event loop thread, since promises are not thread safe
+	std::map<uint64_t, std::vector<PlatformUtil::Fulfiller<bool>>> waiting;
+	Stats counters;
+
+	bool write_next();
+	bool notify_completed();
+
+#ifdef ASYNC_FILE_WRITER_THREAD
+	bool busy;
+	// Path the worker is writing while busy
+	std::string writing;
+	bool stopping;
+	std::thread worker;
+
+	void worker_func();
+#endif
+
+public:
+	AsyncFileWriter(FstreamFileImpl &impl, LibcTimeImpl &time);
+	~AsyncFileWriter();
+
+	PlatformUtil::Promise<bool> write(const std::string &path, std::string &&contents);
+	// Writes right away, in place of anything still queued for the path.
+	// Only waits for a write to the same path that is already under way.
+	bool write_now(const std::string &path, const std::string_view contents);
+	bool poll();
+	// Waits until everything queued is on disk
+	void flush();
+	Stats stats();
+};
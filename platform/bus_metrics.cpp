@@ -0,0 +1,90 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bus_metrics.h"
+#include <chrono>
+
+static inline int bucket_of(uint64_t value) {
+	int b = 0;
+	while (value != 0 && b < Log2Histogram::BUCKETS - 1) {
+		value >>= 1;
+		b++;
+	}
+	return b;
+}
+
+void Log2Histogram::add(uint64_t value) {
+	buckets[bucket_of(value)]++;
+	total++;
+	if (value > maximum)
+		maximum = value;
+}
+
+uint64_t Log2Histogram::quantile(double q) const {
+	if (total == 0)
+		return 0;
+	uint64_t rank = (uint64_t)(q * (total - 1)) + 1;
+	uint64_t seen = 0;
+	for (int b = 0; b < BUCKETS; b++) {
+		seen += buckets[b];
+		if (seen >= rank) {
+			uint64_t bound = b == 0 ? 0 : ((uint64_t)1 << b) - 1;
+			return bound < maximum ? bound : maximum;
+		}
+	}
+	return maximum;
+}
+
+std::string Log2Histogram::to_string(const char *unit) const {
+	if (total == 0)
+		return std::string("none");
+	return "p50<=" + std::to_string(quantile(0.5)) + " p99<=" + std::to_string(quantile(0.99)) +
+		" max=" + std::to_string(maximum) + " " + unit;
+}
+
+static int64_t now_us() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SendLatency::queued(size_t bytes) {
+	if (bytes == 0)
+		return;
+	queued_total += bytes;
+	pending.emplace_back(queued_total, now_us());
+}
+
+void SendLatency::written(size_t bytes) {
+	if (bytes == 0)
+		return;
+	written_total += bytes;
+	int64_t now = -1;
+	while (!pending.empty() && pending.front().first <= written_total) {
+		if (now < 0)
+			now = now_us();
+		latency.add(now - pending.front().second);
+		pending.pop_front();
+	}
+}
+
+void SendLatency::discard() {
+	pending.clear();
+	written_total = queued_total;
+}
+
+static std::string rate(uint64_t count, int64_t elapsed_ms) {
+	if (elapsed_ms <= 0)
+		return "-";
+	return std::to_string(count * 1000 / (uint64_t)elapsed_ms);
+}
+
+std::string BusTrafficStats::to_string(int64_t elapsed_ms) const {
+	return "rx " + std::to_string(rx_messages) + " msgs " + std::to_string(rx_bytes) + " bytes (" +
+		rate(rx_messages, elapsed_ms) + "/s, " + rate(rx_bytes, elapsed_ms) + " B/s), tx " +
+		std::to_string(tx_messages) + " msgs " + std::to_string(tx_bytes) + " bytes (" +
+		rate(tx_messages, elapsed_ms) + "/s, " + rate(tx_bytes, elapsed_ms) + " B/s), " +
+		std::to_string(tx_dropped) + " dropped, queue " +
+		queue_depth.to_string("bytes");
+}
@@ -0,0 +1,79 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Histogram with power-of-two buckets: bucket 0 counts zeros, and bucket
+// i counts values in [2^(i-1), 2^i). Cheap enough to sample every message.
+class Log2Histogram {
+public:
+	static constexpr int BUCKETS = 48;
+
+private:
+	uint64_t buckets[BUCKETS] = {};
+	uint64_t total = 0;
+	uint64_t maximum = 0;
+
+public:
+	void add(uint64_t value);
+	uint64_t count() const { return total; }
+	uint64_t max() const { return maximum; }
+	// Upper bound of the bucket that holds the given quantile
+	uint64_t quantile(double q) const;
+	// For example "p50<=64 p99<=1024 max=1500 us"
+	std::string to_string(const char *unit) const;
+};
+
+// Time that sent data waits in a transmit queue before it is handed to
+// the peer. Each send is stamped when it is queued, and measured once its
+// last byte has left the queue.
+class SendLatency {
+	// Queue offset just past each pending send, and when it was queued
+	std::deque<std::pair<uint64_t, int64_t>> pending;
+	uint64_t queued_total = 0;
+	uint64_t written_total = 0;
+	Log2Histogram latency;
+
+public:
+	void queued(size_t bytes);
+	void written(size_t bytes);
+	// Data dropped unsent, e.g. because the connection closed
+	void discard();
+	// In microseconds
+	const Log2Histogram &histogram() const { return latency; }
+};
+
+// Traffic seen by one end of a bus connection, or summed over a channel.
+// Byte counts include the bus framing.
+struct BusTrafficStats {
+	uint64_t rx_messages = 0;
+	uint64_t rx_bytes = 0;
+	uint64_t tx_messages = 0;
+	uint64_t tx_bytes = 0;
+	// Messages not sent because the peer was not keeping up
+	uint64_t tx_dropped = 0;
+	// Bytes waiting to be sent, sampled after each message is queued
+	Log2Histogram queue_depth;
+
+	void received(size_t bytes) {
+		rx_messages++;
+		rx_bytes += bytes;
+	}
+	void sent(size_t bytes, size_t queued) {
+		tx_messages++;
+		tx_bytes += bytes;
+		queue_depth.add(queued);
+	}
+	void dropped() {
+		tx_dropped++;
+	}
+	// Counts and rates over the given time span
+	std::string to_string(int64_t elapsed_ms) const;
+};
@@ -0,0 +1,119 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "bus_recording.h"
+#include "platform_runtime.h"
+#include <sstream>
+
+RecordingBusSocket::RecordingBusSocket(std::unique_ptr<BusSocket> &&s, const std::string &path) : socket(std::move(s)), file(path, std::ios::binary) {
+	if (!file)
+		platform->debug_print("cannot record bus to " + path);
+	start = platform->get_timer();
+	rx_promise = socket->receive().then(std::bind(&RecordingBusSocket::data_received, this, std::placeholders::_1));
+}
+
+void RecordingBusSocket::data_received(ReceiveResult &&result) {
+	int64_t time = platform->get_timer() - start;
+	if (auto *join = std::get_if<JoinNotification>(&result)) {
+		file << time << " J " << join->peer.tid << ' ' << join->peer.uid << '\n';
+	} else if (auto *leave = std::get_if<LeaveNotification>(&result)) {
+		file << time << " L " << leave->peer.tid << ' ' << leave->peer.uid << '\n';
+	} else if (auto *msg = std::get_if<Message>(&result)) {
+		file << time << " M " << msg->peer.tid << ' ' << msg->peer.uid << ' ' << msg->data.size() << '\n';
+		file.write(msg->data.data(), msg->data.size());
+		file << '\n';
+	}
+	// Flushed as it goes, so that the recording survives a crash
+	file.flush();
+	rx_list.push_data(std::move(result));
+	rx_promise = socket->receive().then(std::bind(&RecordingBusSocket::data_received, this, std::placeholders::_1));
+}
+
+void RecordingBusSocket::broadcast(const std::string_view data) {
+	socket->broadcast(data);
+}
+
+void RecordingBusSocket::broadcast(uint32_t tid, const std::string_view data) {
+	socket->broadcast(tid, data);
+}
+
+void RecordingBusSocket::send_to(uint32_t uid, const std::string_view data) {
+	socket->send_to(uid, data);
+}
+
+PlatformUtil::Promise<BasePlatform::BusSocket::ReceiveResult> RecordingBusSocket::receive() {
+	return rx_list.create_and_add();
+}
+
+void RecordingBusSocket::subscribe(const std::vector<std::string> &prefixes) {
+	socket->subscribe(prefixes);
+}
+
+ReplayBusSocket::ReplayBusSocket(const std::string &path, std::function<void(const std::string &)> marker, std::function<void()> finished)
+	: next(0), on_marker(std::move(marker)), on_finished(std::move(finished)) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		platform->debug_print("cannot replay bus from " + path);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty())
+			continue;
+		std::istringstream header(line);
+		Record rec;
+		rec.peer = { 0, 0 };
+		if (!(header >> rec.time >> rec.type))
+			break;
+		if (rec.type == 'S') {
+			header >> std::ws;
+			std::getline(header, rec.data);
+		} else if (rec.type == 'J' || rec.type == 'L' || rec.type == 'M') {
+			header >> rec.peer.tid >> rec.peer.uid;
+			if (rec.type == 'M') {
+				size_t len = 0;
+				header >> len;
+				rec.data.resize(len);
+				file.read(rec.data.data(), len);
+				file.ignore(1);
+			}
+		} else {
+			continue;
+		}
+		if (!header && !header.eof())
+			break;
+		records.push_back(std::move(rec));
+	}
+	start = platform->get_timer();
+	advance();
+}
+
+void ReplayBusSocket::advance() {
+	while (next < records.size()) {
+		Record &rec = records[next];
+		int64_t wait = start + rec.time - platform->get_timer();
+		if (wait > 0) {
+			timer_promise = platform->delay(wait).then([this]() { advance(); });
+			return;
+		}
+		next++;
+		if (rec.type == 'J')
+			rx_list.push_data(JoinNotification{ rec.peer });
+		else if (rec.type == 'L')
+			rx_list.push_data(LeaveNotification{ rec.peer });
+		else if (rec.type == 'M')
+			rx_list.push_data(Message{ rec.peer, std::move(rec.data) });
+		else if (on_marker)
+			on_marker(rec.data);
+	}
+	if (on_finished) {
+		auto finished = std::move(on_finished);
+		on_finished = nullptr;
+		finished();
+	}
+}
+
+PlatformUtil::Promise<BasePlatform::BusSocket::ReceiveResult> ReplayBusSocket::receive() {
+	return rx_list.create_and_add();
+}
@@ -0,0 +1,68 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "platform.h"
+#include <fstream>
+#include <functional>
+
+// Everything received on a bus socket, written to a file with the time
+// it arrived, so that a session can be played back later without the
+// other end. Each record is one line,
+//   <ms> J <tid> <uid>         join
+//   <ms> L <tid> <uid>         leave
+//   <ms> M <tid> <uid> <len>   message, followed by len bytes and a newline
+// and replay files may also hold
+//   <ms> S <name>              marker, reported to the player
+class RecordingBusSocket final : public BasePlatform::BusSocket {
+	std::unique_ptr<BusSocket> socket;
+	std::ofstream file;
+	int64_t start;
+	PlatformUtil::Promise<ReceiveResult> rx_promise;
+	PlatformUtil::FulfillerBufferedQueue<ReceiveResult> rx_list;
+
+	void data_received(ReceiveResult &&result);
+
+public:
+	RecordingBusSocket(std::unique_ptr<BusSocket> &&socket, const std::string &path);
+
+	void broadcast(const std::string_view data) override;
+	void broadcast(uint32_t tid, const std::string_view data) override;
+	void send_to(uint32_t uid, const std::string_view data) override;
+	PlatformUtil::Promise<ReceiveResult> receive() override;
+	void subscribe(const std::vector<std::string> &prefixes) override;
+};
+
+// Plays a recording back as if its peers were connected, keeping the
+// recorded timing. Anything sent is dropped.
+class ReplayBusSocket final : public BasePlatform::BusSocket {
+	struct Record {
+		int64_t time;
+		char type;
+		PeerId peer;
+		std::string data;
+	};
+	std::vector<Record> records;
+	size_t next;
+	int64_t start;
+	std::function<void(const std::string &)> on_marker;
+	std::function<void()> on_finished;
+	PlatformUtil::Promise<void> timer_promise;
+	PlatformUtil::FulfillerBufferedQueue<ReceiveResult> rx_list;
+
+	void advance();
+
+public:
+	// on_marker is called for markers, and on_finished once the last
+	// record has been played
+	ReplayBusSocket(const std::string &path, std::function<void(const std::string &)> on_marker, std::function<void()> on_finished);
+
+	void broadcast(const std::string_view data) override {}
+	void broadcast(uint32_t tid, const std::string_view data) override {}
+	void send_to(uint32_t uid, const std::string_view data) override {}
+	PlatformUtil::Promise<ReceiveResult> receive() override;
+};
@@ -7,9 +7,18 @@
 #include "bus_socket_impl.h"
 #include "platform_runtime.h"
 #include <map>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 
+// Batches at least this large are written out without waiting
+#define BUS_BATCH_LIMIT 65536
+
+static int64_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 BusSocketImpl::BusSocketImpl(const std::string_view load_path, FdPoller &p, const std::vector<std::string> &args) : poller(p) {
 	std::map<std::string, std::string> ini_items;
 	if (args.empty()) {
@@ -38,12 +47,29 @@ BusSocketImpl::BusSocketImpl(const std::string_view load_path, FdPoller &p, cons
 
 	for (const auto &entry : ini_items) {
 		std::istringstream key(entry.second);
-		std::string delim3, delim4, delim5;
+		std::string delim3, delim4, delim5, delim6;
 		std::getline(key, delim3, ':');
 		std::getline(key, delim4, ':');
+		// Optional coalescing bound in milliseconds, frames are written as they come without it
+		std::getline(key, delim5, ':');
+		// Nagle's algorithm is disabled unless this is 0
+		std::getline(key, delim6, ':');
+		bool nodelay = delim6 != "0";
+		int max_latency = 0;
+		try {
+			if (!delim5.empty())
+				max_latency = std::stoi(delim5);
+		}
+		catch(...){
+
+		}
 
+		if (delim3 == "shm") {
+			socket_config.push_back(SocketConfig{ entry.first, delim4, 0, true, max_latency, nodelay });
+			continue;
+		}
 		try {
-			socket_config.push_back(SocketConfig{ entry.first, delim3, std::stoi(delim4) });
+			socket_config.push_back(SocketConfig{ entry.first, delim3, std::stoi(delim4), false, max_latency, nodelay });
 		}
 		catch(...){
 
@@ -52,14 +78,38 @@ BusSocketImpl::BusSocketImpl(const std::string_view load_path, FdPoller &p, cons
 }
 
 std::unique_ptr<BasePlatform::BusSocket> BusSocketImpl::open_bus_socket(const std::string_view channel, uint32_t tid) {
-	for (const SocketConfig &conf : socket_config)
-		if (conf.name == channel)
-			return std::make_unique<TcpBusSocket>(tid, conf.hostname, conf.port, poller);
+	for (const SocketConfig &conf : socket_config) {
+		if (conf.name != channel)
+			continue;
+#ifndef PLATFORM_HAS_SHM_SOCKET
+		if (conf.shm) {
+			platform->debug_print("shared memory bus transport not supported for channel \"" + std::string(channel) + "\"!");
+			return nullptr;
+		}
+#endif
+		auto socket = std::make_unique<StreamBusSocket>(tid, conf.hostname, conf.port, conf.shm, conf.max_latency, conf.nodelay, poller);
+		opened.push_back(OpenedSocket{ conf.name, tid, now_ms(), socket->shared_stats() });
+		return socket;
+	}
 	platform->debug_print("unconfigured bus socket channel \"" + std::string(channel) + "\"!");
 	return nullptr;
 }
 
-void BusSocketImpl::TcpBusSocket::pack_uint32(char* ptr, uint32_t v) {
+std::string BusSocketImpl::dump_stats() const {
+	int64_t now = now_ms();
+	std::string out;
+	for (const OpenedSocket &sock : opened) {
+		const StreamBusSocket::Stats &st = *sock.stats;
+		char ratio[32] = "-";
+		if (st.writes > 0)
+			snprintf(ratio, sizeof(ratio), "%.1f", (double)st.traffic.tx_messages / st.writes);
+		out += "bus client " + sock.channel + " tid " + std::to_string(sock.tid) + ": " + st.traffic.to_string(now - sock.opened_at) +
+			", " + std::to_string(st.writes) + " writes, " + ratio + " frames per write\n";
+	}
+	return out;
+}
+
+void BusSocketImpl::StreamBusSocket::pack_uint32(char* ptr, uint32_t v) {
 	unsigned char* p = (unsigned char*)ptr;
 	p[0] = (unsigned char)(v);
 	p[1] = (unsigned char)(v >> 8);
@@ -67,26 +117,29 @@ void BusSocketImpl::TcpBusSocket::pack_uint32(char* ptr, uint32_t v) {
 	p[3] = (unsigned char)(v >> 24);
 }
 
-uint32_t BusSocketImpl::TcpBusSocket::unpack_uint32(const char* ptr) {
+uint32_t BusSocketImpl::StreamBusSocket::unpack_uint32(const char* ptr) {
 	unsigned char* p = (unsigned char*)ptr;
 	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
 }
 
-void BusSocketImpl::TcpBusSocket::data_received(std::string &&data) {
+void BusSocketImpl::StreamBusSocket::data_received(std::string &&data) {
 	if (data.empty()) {
 		rx_buffer.clear();
 		for (auto &p : peers)
 			rx_list.push_data(LeaveNotification{ p });
 		peers.clear();
+		tx_batch.clear();
+		flush_promise = {};
+		flush_pending = false;
+		drain_promise = {};
+		drain_pending = false;
 		retry_promise = platform->delay(100).then([this](){
-			socket = std::make_unique<TcpSocket>(hostname, port, poller);
-			rx_promise = socket->receive().then(std::bind(&TcpBusSocket::data_received, this, std::placeholders::_1));
-			client_hello();
+			connect();
 		});
 		return;
 	}
 
-	rx_promise = socket->receive().then(std::bind(&TcpBusSocket::data_received, this, std::placeholders::_1));
+	rx_promise = socket->receive().then(std::bind(&StreamBusSocket::data_received, this, std::placeholders::_1));
 
 	if (rx_buffer.empty())
 		rx_buffer = std::move(data);
@@ -118,6 +171,7 @@ void BusSocketImpl::TcpBusSocket::data_received(std::string &&data) {
 
 			if (rx_buffer.size() < 4 * 4 + len)
 				return;
+			counters->traffic.received(4 * 4 + len);
 			if (rx_buffer.size() - 4 * 4 == len) {
 				rx_buffer.erase(0, 4 * 4);
 				rx_list.push_data(Message{ id, std::move(rx_buffer) });
@@ -132,31 +186,112 @@ void BusSocketImpl::TcpBusSocket::data_received(std::string &&data) {
 	}
 }
 
-BusSocketImpl::TcpBusSocket::TcpBusSocket(uint32_t tid, const std::string_view hostname, int port, FdPoller &poller) :
-	hostname(hostname), port(port), tid(tid), poller(poller), socket(std::make_unique<TcpSocket>(hostname, port, poller)) {
-	rx_promise = socket->receive().then(std::bind(&TcpBusSocket::data_received, this, std::placeholders::_1));
+BusSocketImpl::StreamBusSocket::StreamBusSocket(uint32_t tid, const std::string_view hostname, int port, bool shm, int max_latency, bool nodelay, FdPoller &poller) :
+	flush_pending(false), drain_pending(false), counters(std::make_shared<Stats>()), hostname(hostname), port(port), shm(shm), max_latency(max_latency), nodelay(nodelay), tid(tid), poller(poller) {
+	connect();
+}
+
+void BusSocketImpl::StreamBusSocket::queue(const std::string &frame) {
+	if (max_latency <= 0 && tx_batch.empty() && socket->writable()) {
+		counters->writes++;
+		socket->send(frame);
+		counters->traffic.sent(frame.size(), socket->queued_bytes());
+		return;
+	}
+	// Frames queued before the timer fires share one write
+	tx_batch += frame;
+	counters->traffic.sent(frame.size(), socket->queued_bytes() + tx_batch.size());
+	if (tx_batch.size() >= BUS_BATCH_LIMIT || max_latency <= 0) {
+		flush();
+	} else if (!flush_pending) {
+		flush_pending = true;
+		flush_promise = platform->delay(max_latency).then([this]() {
+			flush_pending = false;
+			flush();
+		});
+	}
+}
+
+void BusSocketImpl::StreamBusSocket::flush() {
+	flush_promise = {};
+	flush_pending = false;
+	if (tx_batch.empty())
+		return;
+	// While the stream is congested, frames pile up in the batch and
+	// go out together once it has drained
+	if (!socket->writable()) {
+		if (!drain_pending) {
+			drain_pending = true;
+			drain_promise = socket->on_drain().then([this]() {
+				drain_pending = false;
+				flush();
+			});
+		}
+		return;
+	}
+	counters->writes++;
+	socket->send(tx_batch);
+	tx_batch.clear();
+}
+
+void BusSocketImpl::StreamBusSocket::connect() {
+#ifdef PLATFORM_HAS_SHM_SOCKET
+	if (shm)
+		socket = std::make_unique<ShmSocket>(hostname, poller);
+	else
+#endif
+	{
+		auto tcp = std::make_unique<TcpSocket>(hostname, port, poller);
+		tcp->set_nodelay(nodelay);
+		socket = std::move(tcp);
+	}
+	rx_promise = socket->receive().then(std::bind(&StreamBusSocket::data_received, this, std::placeholders::_1));
 	client_hello();
 }
 
-void BusSocketImpl::TcpBusSocket::client_hello() {
+void BusSocketImpl::StreamBusSocket::client_hello() {
 	std::string buf;
 	buf.resize(2 * 4);
 	pack_uint32(buf.data() + 0 * 4, 11); // hello
 	pack_uint32(buf.data() + 1 * 4, tid);
-	socket->send(std::move(buf));
+	queue(buf);
+	if (!subscriptions.empty())
+		send_subscriptions();
+}
+
+void BusSocketImpl::StreamBusSocket::send_subscriptions() {
+	size_t size = 2 * 4;
+	for (const std::string &prefix : subscriptions)
+		size += 4 + prefix.size();
+	std::string buf;
+	buf.reserve(size);
+	buf.resize(2 * 4);
+	pack_uint32(buf.data() + 0 * 4, 15); // subscribe
+	pack_uint32(buf.data() + 1 * 4, subscriptions.size());
+	for (const std::string &prefix : subscriptions) {
+		buf.resize(buf.size() + 4);
+		pack_uint32(buf.data() + buf.size() - 4, prefix.size());
+		buf += prefix;
+	}
+	queue(buf);
+}
+
+void BusSocketImpl::StreamBusSocket::subscribe(const std::vector<std::string> &prefixes) {
+	subscriptions = prefixes;
+	send_subscriptions();
 }
 
-void BusSocketImpl::TcpBusSocket::broadcast(const std::string_view data) {
+void BusSocketImpl::StreamBusSocket::broadcast(const std::string_view data) {
 	std::string buf;
 	buf.reserve(2 * 4 + data.size());
 	buf.resize(2 * 4);
 	pack_uint32(buf.data() + 0 * 4, 12); // broadcast all
 	pack_uint32(buf.data() + 1 * 4, data.size());
 	buf.insert(buf.end(), data.begin(), data.end());
-	socket->send(std::move(buf));
+	queue(buf);
 }
 
-void BusSocketImpl::TcpBusSocket::broadcast(uint32_t tid, const std::string_view data) {
+void BusSocketImpl::StreamBusSocket::broadcast(uint32_t tid, const std::string_view data) {
 	std::string buf;
 	buf.reserve(3 * 4 + data.size());
 	buf.resize(3 * 4);
@@ -164,10 +299,10 @@ void BusSocketImpl::TcpBusSocket::broadcast(uint32_t tid, const std::string_view
 	pack_uint32(buf.data() + 1 * 4, tid);
 	pack_uint32(buf.data() + 2 * 4, data.size());
 	buf.insert(buf.end(), data.begin(), data.end());
-	socket->send(std::move(buf));
+	queue(buf);
 }
 
-void BusSocketImpl::TcpBusSocket::send_to(uint32_t uid, const std::string_view data) {
+void BusSocketImpl::StreamBusSocket::send_to(uint32_t uid, const std::string_view data) {
 	std::string buf;
 	buf.reserve(3 * 4 + data.size());
 	buf.resize(3 * 4);
@@ -175,9 +310,9 @@ void BusSocketImpl::TcpBusSocket::send_to(uint32_t uid, const std::string_view d
 	pack_uint32(buf.data() + 1 * 4, uid);
 	pack_uint32(buf.data() + 2 * 4, data.size());
 	buf.insert(buf.end(), data.begin(), data.end());
-	socket->send(std::move(buf));
+	queue(buf);
 }
 
-PlatformUtil::Promise<BasePlatform::BusSocket::ReceiveResult> BusSocketImpl::TcpBusSocket::receive() {
+PlatformUtil::Promise<BasePlatform::BusSocket::ReceiveResult> BusSocketImpl::StreamBusSocket::receive() {
 	return rx_list.create_and_add();
 }
@@ -8,6 +8,8 @@
 
 #include "platform.h"
 #include "tcp_socket.h"
+#include "shm_socket.h"
+#include "bus_metrics.h"
 
 class BusSocketImpl : private PlatformUtil::NoCopy {
 private:
@@ -16,6 +18,12 @@ private:
 		std::string name;
 		std::string hostname;
 		int port;
+		// Connect through shared memory, hostname is then the channel name
+		bool shm;
+		// Longest time outgoing frames may be held back to be sent together
+		int max_latency;
+		// Disable Nagle's algorithm on the TCP connection
+		bool nodelay;
 	};
 	std::vector<SocketConfig> socket_config;
 
@@ -24,31 +32,69 @@ public:
 
 	std::unique_ptr<BasePlatform::BusSocket> open_bus_socket(const std::string_view channel, uint32_t tid);
 
-	class TcpBusSocket final : public BasePlatform::BusSocket {
+	class StreamBusSocket final : public BasePlatform::BusSocket {
+	public:
+		struct Stats {
+			BusTrafficStats traffic;
+			// Batches handed to the stream, traffic.tx_messages / writes is the coalescing ratio
+			uint64_t writes = 0;
+		};
+
 	private:
-		std::unique_ptr<TcpSocket> socket;
+		std::unique_ptr<StreamSocket> socket;
 		std::string rx_buffer;
 		PlatformUtil::Promise<std::string> rx_promise;
 		PlatformUtil::Promise<void> retry_promise;
 		PlatformUtil::FulfillerBufferedQueue<ReceiveResult> rx_list;
 		std::vector<PeerId> peers;
+		std::vector<std::string> subscriptions;
+		std::string tx_batch;
+		PlatformUtil::Promise<void> flush_promise;
+		PlatformUtil::Promise<void> drain_promise;
+		bool flush_pending, drain_pending;
+		// Shared with the BusSocketImpl, so that they outlive the socket
+		std::shared_ptr<Stats> counters;
 
 		void pack_uint32(char* ptr, uint32_t v);
 		uint32_t unpack_uint32(const char *ptr);
 
+		void queue(const std::string &frame);
+		void flush();
+		void connect();
 		void client_hello();
+		void send_subscriptions();
 		void data_received(std::string &&data);
 
 		std::string hostname;
 		int port;
+		bool shm;
+		int max_latency;
+		bool nodelay;
 		uint32_t tid;
 		FdPoller& poller;
 	public:
-		TcpBusSocket(uint32_t tid, const std::string_view hostname, int port, FdPoller &poller);
+		StreamBusSocket(uint32_t tid, const std::string_view hostname, int port, bool shm, int max_latency, bool nodelay, FdPoller &poller);
 
 		void broadcast(const std::string_view data) override;
 		void broadcast(uint32_t tid, const std::string_view data) override;
 		void send_to(uint32_t uid, const std::string_view data) override;
 		PlatformUtil::Promise<ReceiveResult> receive() override;
+		void subscribe(const std::vector<std::string> &prefixes) override;
+		const Stats& stats() const { return *counters; }
+		std::shared_ptr<const Stats> shared_stats() const { return counters; }
+	};
+
+private:
+	struct OpenedSocket {
+		std::string channel;
+		uint32_t tid;
+		int64_t opened_at;
+		std::shared_ptr<const StreamBusSocket::Stats> stats;
 	};
+	// Every socket opened so far, including closed ones
+	std::vector<OpenedSocket> opened;
+
+public:
+	// One line per opened socket with its traffic and write coalescing
+	std::string dump_stats() const;
 };
@@ -5,11 +5,19 @@
  */
 
 #include <map>
+#include <chrono>
+#include <cstdio>
 #include <functional>
 #include <fstream>
 #include <sstream>
 #include "bus_socket_server.h"
 
+// Servers are created along with the platform, before its timer can be used
+static int64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void BusSocketServer::pack_uint32(char* ptr, uint32_t v) {
     unsigned char* p = (unsigned char*)ptr;
     p[0] = (unsigned char)(v);
@@ -23,110 +31,189 @@ uint32_t BusSocketServer::unpack_uint32(const char* ptr) {
     return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
 }
 
-void BusSocketServer::handle_client(ClientData &client)
+StreamSocket::Frame BusSocketServer::make_frame(uint32_t type, uint32_t tid, uint32_t uid, std::optional<std::string_view> payload)
+{
+    auto buf = std::make_shared<std::string>();
+    buf->resize(payload ? 4 * 4 + payload->size() : 3 * 4);
+    pack_uint32(buf->data() + 0 * 4, type);
+    pack_uint32(buf->data() + 1 * 4, tid);
+    pack_uint32(buf->data() + 2 * 4, uid);
+    if (payload) {
+        pack_uint32(buf->data() + 3 * 4, payload->size());
+        std::copy(payload->begin(), payload->end(), buf->begin() + 4 * 4);
+    }
+    return buf;
+}
+
+bool BusSocketServer::subscribed(const ClientData &client, std::string_view payload)
+{
+    if (client.topics.empty())
+        return true;
+    for (const std::string &prefix : client.topics)
+        if (payload.substr(0, prefix.size()) == prefix)
+            return true;
+    return false;
+}
+
+void BusSocketServer::send_frame(ClientData &client, const StreamSocket::Frame &frame)
+{
+    client.socket->send(frame);
+    size_t queued = client.socket->queued_bytes();
+    client.stats.sent(frame->size(), queued);
+    totals.sent(frame->size(), queued);
+}
+
+void BusSocketServer::forward(ClientData &client, const StreamSocket::Frame &frame)
+{
+    // Subscribers that cannot keep up miss data until their queue has
+    // drained, rather than have the server buffer it without bound
+    if (!client.socket->writable()) {
+        client.stats.dropped();
+        totals.dropped();
+        return;
+    }
+    send_frame(client, frame);
+}
+
+void BusSocketServer::introspect(ClientData &client, std::string_view request)
 {
+    if (request == "stats")
+        send_frame(client, make_frame(3, BUS_SERVER_TID, 0, dump_stats()));
+}
+
+std::string BusSocketServer::dump_stats() const
+{
+    int64_t now = now_ms();
+    std::string out = "bus " + name + ": " + std::to_string(clients.size()) + " clients, " +
+        totals.to_string(now - started_at) + ", routing " + handling_time.to_string("us") + "\n";
+    for (const ClientData &cl : clients) {
+        out += "  uid " + std::to_string(cl.uid) + " tid " + (cl.tid ? std::to_string(*cl.tid) : std::string("-")) + ": " +
+            cl.stats.to_string(now - cl.connected_at) + ", queued now " + std::to_string(cl.socket->queued_bytes()) +
+            ", send latency " + cl.socket->send_latency().to_string("us") + "\n";
+    }
+    return out;
+}
+
+bool BusSocketServer::handle_client(ClientData &client)
+{
+    // Frames are parsed in place, and consumed bytes are only dropped
+    // from the buffer once everything complete has been handled
     while (true) {
-        if (client.rx_buffer.size() < 1 * 4)
-            return;
-        uint32_t msgtype = unpack_uint32(client.rx_buffer.data() + 0 * 4);
+        const char *rx = client.rx_buffer.data() + client.rx_offset;
+        size_t avail = client.rx_buffer.size() - client.rx_offset;
+        if (avail < 1 * 4)
+            break;
+        uint32_t msgtype = unpack_uint32(rx + 0 * 4);
         if (msgtype == 11) { // hello
-            if (client.rx_buffer.size() < 2 * 4)
-                return;
+            if (avail < 2 * 4)
+                break;
             if (!client.tid.has_value()) {
-                client.tid = unpack_uint32(client.rx_buffer.data() + 1 * 4);
-
-                {
-                    std::string buf;
-                    buf.resize(3 * 4);
-                    pack_uint32(buf.data() + 0 * 4, 1); // join
-                    pack_uint32(buf.data() + 1 * 4, *client.tid);
-                    pack_uint32(buf.data() + 2 * 4, client.uid);
-                    for (ClientData &cl : clients)
-                        if (&cl != &client && cl.tid.has_value())
-                            cl.socket->send(buf);
-                }
+                client.tid = unpack_uint32(rx + 1 * 4);
+
+                StreamSocket::Frame join = make_frame(1, *client.tid, client.uid, std::nullopt);
+                for (ClientData &cl : clients)
+                    if (&cl != &client && cl.tid.has_value())
+                        send_frame(cl, join);
 
                 for (ClientData &cl : clients) {
                     if (&cl == &client || !cl.tid.has_value())
                         continue;
-                    std::string buf;
-                    buf.resize(3 * 4);
-                    pack_uint32(buf.data() + 0 * 4, 1); // join
-                    pack_uint32(buf.data() + 1 * 4, *cl.tid);
-                    pack_uint32(buf.data() + 2 * 4, cl.uid);
-                    client.socket->send(buf);
+                    send_frame(client, make_frame(1, *cl.tid, cl.uid, std::nullopt));
                 }
             }
-            client.rx_buffer.erase(0, 2 * 4);
-        } else if (msgtype == 12) { // broadcast all
-            if (client.rx_buffer.size() < 2 * 4)
-                return;
-            uint32_t len = unpack_uint32(client.rx_buffer.data() + 1 * 4);
-            if (client.rx_buffer.size() < 2 * 4 + len)
-                return;
-            if (client.tid.has_value()) {
-                std::string buf;
-                buf.reserve(4 * 4 + len);
-                buf.resize(4 * 4);
-                pack_uint32(buf.data() + 0 * 4, 3); // data
-                pack_uint32(buf.data() + 1 * 4, *client.tid);
-                pack_uint32(buf.data() + 2 * 4, client.uid);
-                pack_uint32(buf.data() + 3 * 4, len);
-                buf.insert(buf.end(), client.rx_buffer.begin() + 2 * 4, client.rx_buffer.begin() + 2 * 4 + len);
-
-                for (ClientData &cl : clients)
-                    if (&cl != &client && cl.tid.has_value())
-                        cl.socket->send(buf);
+            client.rx_offset += 2 * 4;
+        } else if (msgtype == 15) { // subscribe
+            if (avail < 2 * 4)
+                break;
+            uint32_t count = unpack_uint32(rx + 1 * 4);
+            if (count > MAX_TOPICS)
+                return false;
+            std::vector<std::string> topics;
+            size_t pos = 2 * 4;
+            for (uint32_t i = 0; i < count && pos + 4 <= avail; i++) {
+                uint32_t len = unpack_uint32(rx + pos);
+                if (len > MAX_TOPIC_LENGTH)
+                    return false;
+                if (avail < pos + 4 + len)
+                    break;
+                topics.emplace_back(rx + pos + 4, len);
+                pos += 4 + len;
             }
-            client.rx_buffer.erase(0, 2 * 4 + len);
-        } else if (msgtype == 13) { // broadcast tid
-            if (client.rx_buffer.size() < 3 * 4)
-                return;
-            uint32_t tid = unpack_uint32(client.rx_buffer.data() + 1 * 4);
-            uint32_t len = unpack_uint32(client.rx_buffer.data() + 2 * 4);
-            if (client.rx_buffer.size() < 3 * 4 + len)
-                return;
+            if (topics.size() < count)
+                break;
+            client.topics = std::move(topics);
+            client.rx_offset += pos;
+        } else if (msgtype == 12) { // broadcast all
+            if (avail < 2 * 4)
+                break;
+            uint32_t len = unpack_uint32(rx + 1 * 4);
+            if (avail < 2 * 4 + (size_t)len)
+                break;
+            client.stats.received(2 * 4 + len);
+            totals.received(2 * 4 + len);
             if (client.tid.has_value()) {
-                std::string buf;
-                buf.reserve(4 * 4 + len);
-                buf.resize(4 * 4);
-                pack_uint32(buf.data() + 0 * 4, 3); // data
-                pack_uint32(buf.data() + 1 * 4, *client.tid);
-                pack_uint32(buf.data() + 2 * 4, client.uid);
-                pack_uint32(buf.data() + 3 * 4, len);
-                buf.insert(buf.end(), client.rx_buffer.begin() + 3 * 4, client.rx_buffer.begin() + 3 * 4 + len);
-
-                for (ClientData &cl : clients)
-                    if (&cl != &client && cl.tid == tid && cl.tid.has_value())
-                        cl.socket->send(buf);
+                std::string_view payload(rx + 2 * 4, len);
+                StreamSocket::Frame frame;
+                for (ClientData &cl : clients) {
+                    if (&cl != &client && cl.tid.has_value() && subscribed(cl, payload)) {
+                        if (!frame)
+                            frame = make_frame(3, *client.tid, client.uid, payload);
+                        forward(cl, frame);
+                    }
+                }
             }
-            client.rx_buffer.erase(0, 3 * 4 + len);
-        } else if (msgtype == 14) { // send to
-            if (client.rx_buffer.size() < 3 * 4)
-                return;
-            uint32_t uid = unpack_uint32(client.rx_buffer.data() + 1 * 4);
-            uint32_t len = unpack_uint32(client.rx_buffer.data() + 2 * 4);
-            if (client.rx_buffer.size() < 3 * 4 + len)
-                return;
-            if (client.tid.has_value()) {
-                std::string buf;
-                buf.reserve(4 * 4 + len);
-                buf.resize(4 * 4);
-                pack_uint32(buf.data() + 0 * 4, 3); // data
-                pack_uint32(buf.data() + 1 * 4, *client.tid);
-                pack_uint32(buf.data() + 2 * 4, client.uid);
-                pack_uint32(buf.data() + 3 * 4, len);
-                buf.insert(buf.end(), client.rx_buffer.begin() + 3 * 4, client.rx_buffer.begin() + 3 * 4 + len);
-
-                for (ClientData &cl : clients)
-                    if (&cl != &client && cl.uid == uid && cl.tid.has_value())
-                        cl.socket->send(buf);
+            client.rx_offset += 2 * 4 + len;
+        } else if (msgtype == 13 || msgtype == 14) { // broadcast tid, send to
+            if (avail < 3 * 4)
+                break;
+            uint32_t dest = unpack_uint32(rx + 1 * 4);
+            uint32_t len = unpack_uint32(rx + 2 * 4);
+            if (avail < 3 * 4 + (size_t)len)
+                break;
+            client.stats.received(3 * 4 + len);
+            totals.received(3 * 4 + len);
+            if (client.tid.has_value() && msgtype == 13 && dest == BUS_SERVER_TID) {
+                introspect(client, std::string_view(rx + 3 * 4, len));
+            } else if (client.tid.has_value()) {
+                std::string_view payload(rx + 3 * 4, len);
+                StreamSocket::Frame frame;
+                for (ClientData &cl : clients) {
+                    if (&cl == &client || !cl.tid.has_value())
+                        continue;
+                    // Messages addressed to a single client bypass its subscriptions
+                    if (msgtype == 13 ? cl.tid != dest || !subscribed(cl, payload) : cl.uid != dest)
+                        continue;
+                    if (!frame)
+                        frame = make_frame(3, *client.tid, client.uid, payload);
+                    forward(cl, frame);
+                }
             }
-            client.rx_buffer.erase(0, 3 * 4 + len);
+            client.rx_offset += 3 * 4 + len;
         } else {
-            client.rx_buffer.clear();
+            client.rx_offset = client.rx_buffer.size();
         }
     }
+
+    if (client.rx_offset == client.rx_buffer.size()) {
+        client.rx_buffer.clear();
+        client.rx_offset = 0;
+    } else if (client.rx_offset > client.rx_buffer.size() / 2) {
+        client.rx_buffer.erase(0, client.rx_offset);
+        client.rx_offset = 0;
+    }
+    return true;
+}
+
+void BusSocketServer::drop_client(size_t index)
+{
+    if (clients[index].tid.has_value()) {
+        StreamSocket::Frame leave = make_frame(2, *clients[index].tid, clients[index].uid, std::nullopt);
+        for (ClientData &cl : clients)
+            if (&cl != &clients[index] && cl.tid.has_value())
+                send_frame(cl, leave);
+    }
+
+    clients.erase(clients.begin() + index);
 }
 
 void BusSocketServer::on_client_data(std::string &&data, uint32_t uid)
@@ -136,43 +223,64 @@ void BusSocketServer::on_client_data(std::string &&data, uint32_t uid)
             continue;
 
         if (data.empty()) {
-            if (clients[i].tid.has_value()) {
-                std::string buf;
-                buf.resize(3 * 4);
-                pack_uint32(buf.data() + 0 * 4, 2); // leave
-                pack_uint32(buf.data() + 1 * 4, *clients[i].tid);
-                pack_uint32(buf.data() + 2 * 4, clients[i].uid);
-
-                for (ClientData &cl : clients)
-                    if (&cl != &clients[i] && cl.tid.has_value())
-                        cl.socket->send(buf);
-            }
-
-            clients.erase(clients.begin() + i);
+            drop_client(i);
         } else {
             clients[i].rx_promise = clients[i].socket->receive().then(std::bind(&BusSocketServer::on_client_data, this, std::placeholders::_1, uid));
             clients[i].rx_buffer += std::move(data);
-            handle_client(clients[i]);
+            auto start = std::chrono::steady_clock::now();
+            bool valid = handle_client(clients[i]);
+            handling_time.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+            if (!valid)
+                drop_client(i);
         }
         return;
     }
 }
 
-void BusSocketServer::on_new_client(std::unique_ptr<TcpSocket> &&sock)
+void BusSocketServer::accept_next()
+{
+    if (listener) {
+        accept_promise = listener->accept().then([this](std::unique_ptr<TcpSocket> &&sock) {
+            sock->set_nodelay(nodelay);
+            on_new_client(std::move(sock));
+        });
+    }
+#ifdef PLATFORM_HAS_SHM_SOCKET
+    if (shm_listener)
+        shm_accept_promise = shm_listener->accept().then(std::bind(&BusSocketServer::on_new_client, this, std::placeholders::_1));
+#endif
+}
+
+void BusSocketServer::on_new_client(std::unique_ptr<StreamSocket> &&sock)
 {
-    accept_promise = listener.accept().then(std::bind(&BusSocketServer::on_new_client, this, std::placeholders::_1));
+    accept_next();
     uint32_t id = ++uid;
-    clients.push_back(ClientData{ std::nullopt, id, std::move(sock), {} });
+    clients.push_back(ClientData{ std::nullopt, id, std::move(sock), {}, {}, 0, {}, {}, now_ms() });
     clients.back().rx_promise = clients.back().socket->receive().then(std::bind(&BusSocketServer::on_client_data, this, std::placeholders::_1, id));
 }
 
-BusSocketServer::BusSocketServer(const std::string_view hostname, int port, FdPoller &p) :
-    listener(hostname, port, p),
-    uid(0)
+BusSocketServer::BusSocketServer(const std::string_view name, const std::string_view hostname, int port, bool nodelay, FdPoller &p) :
+    listener(std::make_unique<TcpListener>(hostname, port, p)),
+    uid(0),
+    nodelay(nodelay),
+    name(name),
+    started_at(now_ms())
 {
-    accept_promise = listener.accept().then(std::bind(&BusSocketServer::on_new_client, this, std::placeholders::_1));
+    accept_next();
 }
 
+#ifdef PLATFORM_HAS_SHM_SOCKET
+BusSocketServer::BusSocketServer(const std::string_view name, const std::string_view shm_name, FdPoller &p) :
+    shm_listener(std::make_unique<ShmListener>(shm_name, p)),
+    uid(0),
+    nodelay(false),
+    name(name),
+    started_at(now_ms())
+{
+    accept_next();
+}
+#endif
+
 BusSocketServerManager::BusSocketServerManager(const std::string_view load_path, FdPoller &fd)
 {
     std::ifstream file(std::string(load_path) + "tcp_bus_server.conf", std::ios::binary);
@@ -190,9 +298,28 @@ BusSocketServerManager::BusSocketServerManager(const std::string_view load_path,
 
     for (const auto &entry : ini_items) {
         std::istringstream key2(entry.second);
-        std::string tcphost, tcpport;
+        std::string tcphost, tcpport, tcpnodelay;
         std::getline(key2, tcphost, ':');
         std::getline(key2, tcpport, ':');
-        servers.push_back(std::make_unique<BusSocketServer>(tcphost, std::stoi(tcpport), fd));
+        // Nagle's algorithm is disabled unless the channel ends in :0
+        std::getline(key2, tcpnodelay, ':');
+        // shm:<name> serves the channel through shared memory instead of TCP
+        if (tcphost == "shm") {
+#ifdef PLATFORM_HAS_SHM_SOCKET
+            servers.push_back(std::make_unique<BusSocketServer>(entry.first, tcpport, fd));
+#else
+            printf("shared memory bus transport not supported, channel \"%s\" not served\n", entry.first.c_str());
+#endif
+            continue;
+        }
+        servers.push_back(std::make_unique<BusSocketServer>(entry.first, tcphost, std::stoi(tcpport), tcpnodelay != "0", fd));
     }
 }
+
+std::string BusSocketServerManager::dump_stats() const
+{
+    std::string out;
+    for (const auto &server : servers)
+        out += server->dump_stats();
+    return out;
+}
@@ -7,30 +7,69 @@
 #pragma once
 
 #include "tcp_listener.h"
+#include "shm_socket.h"
+#include "bus_metrics.h"
+
+// Messages sent to this tid are answered by the server itself. Sending
+// it "stats" returns the text dump of the channel's traffic counters.
+#define BUS_SERVER_TID 0xFFFFFFFF
 
 class BusSocketServer : private PlatformUtil::NoCopy {
 private:
-	TcpListener listener;
+	// Limits on a subscribe request, clients going over them are dropped
+	static constexpr uint32_t MAX_TOPICS = 64;
+	static constexpr uint32_t MAX_TOPIC_LENGTH = 256;
+	std::unique_ptr<TcpListener> listener;
+#ifdef PLATFORM_HAS_SHM_SOCKET
+	std::unique_ptr<ShmListener> shm_listener;
+	PlatformUtil::Promise<std::unique_ptr<StreamSocket>> shm_accept_promise;
+#endif
 	struct ClientData {
 		std::optional<uint32_t> tid;
 		uint32_t uid;
-		std::unique_ptr<TcpSocket> socket;
+		std::unique_ptr<StreamSocket> socket;
 		PlatformUtil::Promise<std::string> rx_promise;
 		std::string rx_buffer;
+		size_t rx_offset;
+		// Broadcast prefixes the client asked for, everything if empty
+		std::vector<std::string> topics;
+		BusTrafficStats stats;
+		int64_t connected_at;
 	};
 	std::vector<ClientData> clients;
 	PlatformUtil::Promise<std::unique_ptr<TcpSocket>> accept_promise;
 	uint32_t uid;
+	// Whether Nagle's algorithm is disabled on accepted TCP connections
+	bool nodelay;
+	std::string name;
+	int64_t started_at;
+	BusTrafficStats totals;
+	// Time taken to route each chunk of received data
+	Log2Histogram handling_time;
 
 	void pack_uint32(char* ptr, uint32_t v);
 	uint32_t unpack_uint32(const char *ptr);
 
-	void handle_client(ClientData &client);
+	StreamSocket::Frame make_frame(uint32_t type, uint32_t tid, uint32_t uid, std::optional<std::string_view> payload);
+	static bool subscribed(const ClientData &client, std::string_view payload);
+	void send_frame(ClientData &client, const StreamSocket::Frame &frame);
+	// Sends broadcast data, which is dropped for congested clients
+	void forward(ClientData &client, const StreamSocket::Frame &frame);
+	void introspect(ClientData &client, std::string_view request);
+	// Returns false if the client sent a request it must be dropped for
+	bool handle_client(ClientData &client);
+	void drop_client(size_t index);
 	void on_client_data(std::string &&data, uint32_t uid);
-	void on_new_client(std::unique_ptr<TcpSocket> &&sock);
+	void accept_next();
+	void on_new_client(std::unique_ptr<StreamSocket> &&sock);
 
 public:
-	BusSocketServer(const std::string_view hostname, int port, FdPoller &p);
+	BusSocketServer(const std::string_view name, const std::string_view hostname, int port, bool nodelay, FdPoller &p);
+#ifdef PLATFORM_HAS_SHM_SOCKET
+	// Serves same-host clients through shared memory
+	BusSocketServer(const std::string_view name, const std::string_view shm_name, FdPoller &p);
+#endif
+	std::string dump_stats() const;
 };
 
 class BusSocketServerManager : private PlatformUtil::NoCopy {
@@ -38,4 +77,5 @@ private:
     std::vector<std::unique_ptr<BusSocketServer>> servers;
 public:
     BusSocketServerManager(const std::string_view load_path, FdPoller &fd);
+    std::string dump_stats() const;
 };
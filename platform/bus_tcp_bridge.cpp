@@ -83,13 +83,15 @@ void BusTcpBridge::on_new_client(std::unique_ptr<TcpSocket> &&sock)
     std::unique_ptr<BasePlatform::BusSocket> bus_socket = bus_impl.open_bus_socket(bus, rx_tid);
     if (!bus_socket)
         return;
+    if (!topics.empty())
+        bus_socket->subscribe(topics);
 
     clients.erase(std::remove_if(clients.begin(), clients.end(), [](const auto &c){ return !c->is_alive(); }), clients.end());
     clients.push_back(std::make_unique<BridgedTcpSocket>(std::move(bus_socket), std::move(sock), tx_tid, newline_framing));
 }
 
-BusTcpBridge::BusTcpBridge(const std::string_view bus, uint32_t rx_tid, std::optional<uint32_t> tx_tid, bool nl, const std::string hostname, int port, FdPoller &fd, BusSocketImpl& b) :
-    bus(bus), listener(hostname, port, fd), rx_tid(rx_tid), tx_tid(tx_tid), newline_framing(nl), bus_impl(b)
+BusTcpBridge::BusTcpBridge(const std::string_view bus, uint32_t rx_tid, std::optional<uint32_t> tx_tid, bool nl, const std::vector<std::string> &topics, const std::string hostname, int port, FdPoller &fd, BusSocketImpl& b) :
+    bus(bus), listener(hostname, port, fd), rx_tid(rx_tid), tx_tid(tx_tid), newline_framing(nl), topics(topics), bus_impl(b)
 {
     accept_promise = listener.accept().then(std::bind(&BusTcpBridge::on_new_client, this, std::placeholders::_1));
 }
@@ -120,11 +122,17 @@ BusTcpBridgeManager::BusTcpBridgeManager(const std::string_view load_path, FdPol
         std::getline(key2, rx_tid, ':');
         std::getline(key2, tx_tid, ':');
         std::getline(key2, nl, ':');
+        // Optional list of message prefixes to subscribe to, separated by '|'
+        std::string prefix;
+        std::vector<std::string> topics;
+        while (std::getline(key2, prefix, '|'))
+            if (!prefix.empty())
+                topics.push_back(prefix);
         uint32_t rxt = BasePlatform::BusSocket::PeerId::fourcc(rx_tid);
         std::optional<uint32_t> txt;
         if (tx_tid != "*")
             txt = BasePlatform::BusSocket::PeerId::fourcc(tx_tid);
         bool newline_framing = (!nl.empty() && nl[0] == 'n');
-        bridges.push_back(std::make_unique<BusTcpBridge>(busname, rxt, txt, newline_framing, tcphost, std::stoi(tcpport), fd, impl));
+        bridges.push_back(std::make_unique<BusTcpBridge>(busname, rxt, txt, newline_framing, topics, tcphost, std::stoi(tcpport), fd, impl));
     }
 }
@@ -36,17 +36,18 @@ private:
     void on_new_client(std::unique_ptr<TcpSocket> &&sock);
 
     std::string bus;
-    BusSocketImpl& bus_impl;
+	TcpListener listener;
     uint32_t rx_tid;
     std::optional<uint32_t> tx_tid;
     bool newline_framing;
+    std::vector<std::string> topics;
+    BusSocketImpl& bus_impl;
 
-	TcpListener listener;
     PlatformUtil::Promise<std::unique_ptr<TcpSocket>> accept_promise;
     std::vector<std::unique_ptr<BridgedTcpSocket>> clients;
 
 public:
-    BusTcpBridge(const std::string_view bus, uint32_t rx_tid, std::optional<uint32_t> tx_tid, bool nl, const std::string hostname, int port, FdPoller &fd, BusSocketImpl& b);
+    BusTcpBridge(const std::string_view bus, uint32_t rx_tid, std::optional<uint32_t> tx_tid, bool nl, const std::vector<std::string> &topics, const std::string hostname, int port, FdPoller &fd, BusSocketImpl& b);
 };
 
 class BusTcpBridgeManager : private PlatformUtil::NoCopy {
@@ -0,0 +1,57 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "config_store.h"
+#include "platform_runtime.h"
+
+ConfigStore config_store;
+
+ConfigStore::ConfigStore() {
+	auto snap = std::make_shared<Snapshot>();
+	snap->generation = 0;
+	current = std::move(snap);
+}
+
+ConfigStore::Document ConfigStore::parse(const std::string &path, FileType type) {
+	auto contents = platform->map_file(path, type);
+	if (!contents)
+		return nullptr;
+	auto j = std::make_shared<nlohmann::json>(nlohmann::json::parse(contents->data(), contents->data() + contents->size(), nullptr, false));
+	if (j->is_discarded()) {
+		platform->debug_print("failed to parse " + path);
+		return nullptr;
+	}
+	return j;
+}
+
+ConfigStore::Document ConfigStore::get(const std::string_view path, FileType type) {
+	std::shared_ptr<const Snapshot> snap = std::atomic_load(&current);
+	std::pair<FileType, std::string> key(type, path);
+	auto it = snap->documents.find(key);
+	if (it != snap->documents.end())
+		return it->second;
+
+	// Missing files are remembered as well, so that probing for an
+	// optional file does not hit the disk again until the next reload.
+	Document doc = parse(key.second, type);
+	auto next = std::make_shared<Snapshot>(*snap);
+	next->documents.insert_or_assign(std::move(key), doc);
+	std::atomic_store(&current, std::shared_ptr<const Snapshot>(std::move(next)));
+	return doc;
+}
+
+std::shared_ptr<const ConfigStore::Snapshot> ConfigStore::snapshot() const {
+	return std::atomic_load(&current);
+}
+
+void ConfigStore::reload() {
+	std::shared_ptr<const Snapshot> snap = std::atomic_load(&current);
+	auto next = std::make_shared<Snapshot>();
+	next->generation = snap->generation + 1;
+	for (const auto &entry : snap->documents)
+		next->documents.insert_or_assign(entry.first, parse(entry.first.second, entry.first.first));
+	std::atomic_store(&current, std::shared_ptr<const Snapshot>(std::move(next)));
+}
@@ -0,0 +1,39 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include "platform.h"
+
+// Parses every JSON configuration file at most once per snapshot.
+// Documents are handed out as shared pointers to immutable trees, so a
+// caller can keep using what it got even after reload() swaps the snapshot.
+class ConfigStore : private PlatformUtil::NoCopy {
+public:
+	typedef std::shared_ptr<const nlohmann::json> Document;
+
+	struct Snapshot {
+		std::map<std::pair<FileType, std::string>, Document> documents;
+		uint32_t generation;
+	};
+
+private:
+	std::shared_ptr<const Snapshot> current;
+
+	Document parse(const std::string &path, FileType type);
+
+public:
+	ConfigStore();
+
+	Document get(const std::string_view path, FileType type = ETCS_ASSET_FILE);
+	std::shared_ptr<const Snapshot> snapshot() const;
+	void reload();
+};
+
+extern ConfigStore config_store;
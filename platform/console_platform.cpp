@@ -117,7 +117,9 @@ ConsolePlatform::ConsolePlatform(const std::vector<std::string> &args) :
 	config_dir(get_files_dir(ETCS_CONFIG_FILE)),
 	storage_dir(get_files_dir(ETCS_STORAGE_FILE)),
 	bus_socket_impl(config_dir, poller, args),
-	fstream_file_impl()
+	fstream_file_impl(),
+	mmap_file_impl(fstream_file_impl),
+	file_writer(fstream_file_impl, libc_time_impl)
 #ifdef EVC
 	,
 	bus_server_manager(config_dir, poller),
@@ -136,9 +138,10 @@ ConsolePlatform::ConsolePlatform(const std::vector<std::string> &args) :
 }
 
 ConsolePlatform::~ConsolePlatform() {
+	file_writer.flush();
 	on_quit_request_list.clear();
 	on_quit_list.clear();
-	timer_queue.clear();
+	timers.clear();
 	while (PlatformUtil::DeferredFulfillment::execute());
 	PlatformUtil::DeferredFulfillment::list = nullptr;
 
@@ -160,8 +163,29 @@ std::optional<std::string> ConsolePlatform::read_file(const std::string_view pat
 	return fstream_file_impl.read_file((type == ETCS_ASSET_FILE ? assets_dir : (type == ETCS_CONFIG_FILE ? config_dir : storage_dir)) + std::string(path));
 }
 
+std::optional<ConsolePlatform::FileView> ConsolePlatform::map_file(const std::string_view path, FileType type) {
+	// Storage files are rewritten in place by write_file, which would
+	// invalidate a live mapping, so those are always read into memory.
+	if (type == ETCS_STORAGE_FILE)
+		return BasePlatform::map_file(path, type);
+	return mmap_file_impl.map_file((type == ETCS_ASSET_FILE ? assets_dir : config_dir) + std::string(path));
+}
+
 bool ConsolePlatform::write_file(const std::string_view path, const std::string_view contents) {
-	return fstream_file_impl.write_file(storage_dir + std::string(path), contents);
+	// Queued writes to the same file must not land after this one
+	return file_writer.write_now(storage_dir + std::string(path), contents);
+}
+
+PlatformUtil::Promise<bool> ConsolePlatform::write_file_async(const std::string_view path, std::string &&contents) {
+	return file_writer.write(storage_dir + std::string(path), std::move(contents));
+}
+
+std::optional<ConsolePlatform::FileWriteStats> ConsolePlatform::file_write_stats() {
+	return file_writer.stats();
+}
+
+std::optional<ConsolePlatform::TimerStats> ConsolePlatform::timer_stats() {
+	return timers.stats();
 }
 
 void ConsolePlatform::debug_print(const std::string_view msg) {
@@ -174,9 +198,7 @@ void ConsolePlatform::debug_print(const std::string_view msg) {
 }
 
 PlatformUtil::Promise<void> ConsolePlatform::delay(int ms) {
-	auto pair = PlatformUtil::PromiseFactory::create<void>();
-	timer_queue.insert(std::make_pair(get_timer() + ms, std::move(pair.second)));
-	return std::move(pair.first);
+	return timers.delay(get_timer(), ms);
 }
 
 PlatformUtil::Promise<void> ConsolePlatform::on_quit_request() {
@@ -192,7 +214,7 @@ std::unique_ptr<ConsolePlatform::BusSocket> ConsolePlatform::open_socket(const s
 	return bus_socket_impl.open_bus_socket(channel, tid);
 }
 
-ConsoleFdPoller& ConsolePlatform::get_poller() {
+DefaultFdPoller& ConsolePlatform::get_poller() {
 	return poller;
 }
 
@@ -205,12 +227,8 @@ void ConsolePlatform::event_loop() {
 			on_quit_request_list.fulfill_all(false);
 		}
 
-		int64_t now = get_timer();
-		if (!timer_queue.empty() && timer_queue.begin()->first <= now) {
+		if (timers.advance(get_timer()))
 			idle = false;
-			timer_queue.begin()->second.fulfill(false);
-			timer_queue.erase(timer_queue.begin());
-		}
 
 		for (int i = 0; i < 10; i++)
 			if (PlatformUtil::DeferredFulfillment::execute())
@@ -218,13 +236,31 @@ void ConsolePlatform::event_loop() {
 			else
 				break;
 
-		int64_t diff = -1;
-		if (!timer_queue.empty())
-			diff = std::max((int64_t)0, timer_queue.begin()->first - get_timer());
+		if (idle && file_writer.poll())
+			idle = false;
+
+		int64_t diff = timers.next_expiry();
+		if (diff >= 0)
+			diff = std::max((int64_t)0, diff - get_timer());
 
 		poller.poll(idle ? diff : 0);
 	};
 
+	file_writer.flush();
+	AsyncFileWriter::Stats stats = file_writer.stats();
+	if (stats.writes > 0)
+		debug_print("file writes: " + std::to_string(stats.writes) + ", coalesced " + std::to_string(stats.coalesced) + ", failed " + std::to_string(stats.failed) +
+			", peak queued " + std::to_string(stats.peak_queued_bytes) + " bytes, max latency " + std::to_string(stats.max_latency) + " ms");
+	const TimerWheel::Stats &timer_stats = timers.stats();
+	if (timer_stats.fired > 0)
+		debug_print("timers fired: " + std::to_string(timer_stats.fired) + ", cancelled " + std::to_string(timer_stats.cancelled) +
+			", mean lateness " + std::to_string(timer_stats.total_lateness / (int64_t)timer_stats.fired) + " ms, max lateness " + std::to_string(timer_stats.max_lateness) + " ms");
+	std::string bus_stats = bus_server_manager.dump_stats() + bus_socket_impl.dump_stats();
+	if (!bus_stats.empty()) {
+		bus_stats.pop_back();
+		debug_print(bus_stats);
+	}
+
 	on_quit_list.fulfill_all(false);
 }
 
@@ -14,10 +14,13 @@
 #include "bus_socket_impl.h"
 #include "libc_time_impl.h"
 #include "fstream_file_impl.h"
+#include "mmap_file_impl.h"
+#include "async_file_writer.h"
+#include "timer_wheel.h"
 #include "bus_socket_impl.h"
 #include "bus_socket_server.h"
 #include "bus_tcp_bridge.h"
-#include "console_fd_poller.h"
+#include "epoll_fd_poller.h"
 #include "orts_bridge.h"
 
 class ConsolePlatform final : public BasePlatform {
@@ -30,24 +33,26 @@ private:
 
 	PlatformUtil::FulfillerList<void> on_quit_request_list;
 	PlatformUtil::FulfillerList<void> on_quit_list;
-	std::multimap<int, PlatformUtil::Fulfiller<void>> timer_queue;
+	TimerWheel timers;
 
-	ConsoleFdPoller poller;
+	DefaultFdPoller poller;
 
 	BusSocketImpl bus_socket_impl;
 	LibcTimeImpl libc_time_impl;
 	FstreamFileImpl fstream_file_impl;
+	MmapFileImpl mmap_file_impl;
+	AsyncFileWriter file_writer;
 #ifdef EVC
 	BusSocketServerManager bus_server_manager;
 	BusTcpBridgeManager bus_bridge_manager;
 	OrtsBridge orts_bridge;
 #endif
-	std::vector<std::unique_ptr<PlatformUtil::TypeErasedFulfiller>> event_list;
+	PlatformUtil::DeferredQueue event_list;
 
 public:
 	ConsolePlatform(const std::vector<std::string> &args);
 	void event_loop();
-	ConsoleFdPoller& get_poller();
+	DefaultFdPoller& get_poller();
 
 	~ConsolePlatform() override;
 
@@ -56,7 +61,11 @@ public:
 
 	std::unique_ptr<BusSocket> open_socket(const std::string_view channel, uint32_t tid) override;
 	std::optional<std::string> read_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE) override;
+	std::optional<FileView> map_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE) override;
 	bool write_file(const std::string_view path, const std::string_view contents) override;
+	PlatformUtil::Promise<bool> write_file_async(const std::string_view path, std::string &&contents) override;
+	std::optional<FileWriteStats> file_write_stats() override;
+	std::optional<TimerStats> timer_stats() override;
 	void debug_print(const std::string_view msg) override;
 
 	PlatformUtil::Promise<void> delay(int ms) override;
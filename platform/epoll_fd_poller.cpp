@@ -0,0 +1,119 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "epoll_fd_poller.h"
+
+#ifdef __linux__
+#include "platform_runtime.h"
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+
+EpollFdPoller::EpollFdPoller() : live_fd(-1), events(64) {
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+EpollFdPoller::~EpollFdPoller() {
+	fds.clear();
+	if (epfd != -1)
+		close(epfd);
+}
+
+void EpollFdPoller::set_interest(int fd, Registration &reg, uint32_t interest, bool rearm) {
+	if (interest == reg.interest && !rearm)
+		return;
+	epoll_event ev = {};
+	ev.events = interest;
+	ev.data.fd = fd;
+	int ret;
+	if (interest == 0)
+		ret = epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+	else if (reg.interest == 0)
+		ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	else
+		ret = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	// The kernel drops closed descriptors from the set by itself, so the
+	// number may now belong to a file that was never added, or one that
+	// was added while this entry was forgotten
+	if (ret == -1 && interest != 0 && errno == ENOENT)
+		ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+	else if (ret == -1 && interest != 0 && errno == EEXIST)
+		ret = epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+	if (ret == -1 && interest != 0)
+		platform->debug_print("epoll_ctl failed for fd " + std::to_string(fd) + ": errno " + std::to_string(errno));
+	reg.interest = interest;
+}
+
+void EpollFdPoller::poll(int timeout) {
+	int n = epoll_wait(epfd, events.data(), events.size(), timeout);
+	for (int i = 0; i < n; i++) {
+		int fd = events[i].data.fd;
+		short revents = events[i].events;
+		auto it = fds.find(fd);
+		if (it == fds.end())
+			continue;
+
+		// Split off the waiters that are satisfied before running any
+		// callback, since callbacks usually register again for this fd
+		auto waiters = std::move(it->second.waiters);
+		it->second.waiters.clear();
+		for (auto &w : waiters) {
+			if (!w.second.is_pending())
+				continue;
+			short mask = w.first | POLLERR | POLLHUP;
+			if (revents & mask)
+				dispatch.push_back(std::make_pair(revents & mask, std::move(w.second)));
+			else
+				it->second.waiters.push_back(std::move(w));
+		}
+		live_fd = fd;
+		for (auto &d : dispatch)
+			d.second.fulfill(d.first, false);
+		dispatch.clear();
+		live_fd = -1;
+
+		it = fds.find(fd);
+		if (it == fds.end())
+			continue;
+		uint32_t wanted = 0;
+		for (auto &w : it->second.waiters)
+			wanted |= w.first;
+		if ((revents & ~(wanted | POLLERR | POLLHUP)) != 0 || wanted == 0)
+			set_interest(fd, it->second, wanted);
+		if (it->second.interest == 0)
+			fds.erase(it);
+	}
+	if (n == (int)events.size())
+		events.resize(events.size() * 2);
+}
+
+PlatformUtil::Promise<short> EpollFdPoller::on_fd_ready(int fd, short ev) {
+	auto pair = PlatformUtil::PromiseFactory::create<short>();
+	Registration &reg = fds[fd];
+	reg.waiters.erase(std::remove_if(reg.waiters.begin(), reg.waiters.end(), [](const auto &w) { return !w.second.is_pending(); }), reg.waiters.end());
+	// With nobody waiting, the descriptor may have been closed and its
+	// number reused without forget_fd(). The registration is then gone
+	// from the kernel, so it is renewed instead of trusted, unless the
+	// kernel has just reported an event for it.
+	bool rearm = reg.waiters.empty() && reg.interest != 0 && fd != live_fd;
+	reg.waiters.push_back(std::make_pair(ev, std::move(pair.second)));
+	if ((reg.interest & ev) != (uint32_t)ev || rearm)
+		set_interest(fd, reg, reg.interest | ev, rearm);
+	return std::move(pair.first);
+}
+
+void EpollFdPoller::forget_fd(int fd) {
+	auto it = fds.find(fd);
+	if (it == fds.end())
+		return;
+	set_interest(fd, it->second, 0);
+	fds.erase(it);
+}
+
+bool EpollFdPoller::is_empty() {
+	return fds.empty();
+}
+#endif
@@ -0,0 +1,47 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "console_fd_poller.h"
+
+#ifdef __linux__
+#include <unordered_map>
+#include <sys/epoll.h>
+
+// Keeps every descriptor in the epoll set across waits. Interest is
+// widened as soon as a caller asks for an event, and narrowed lazily, when
+// a wakeup arrives that nobody is waiting for. Registrations are renewed
+// when a descriptor goes from no waiters to one outside of its own
+// wakeup, which keeps a number closed without forget_fd() and then reused
+// from never firing.
+class EpollFdPoller final : public FdPoller {
+	struct Registration {
+		uint32_t interest = 0;
+		std::vector<std::pair<short, PlatformUtil::Fulfiller<short>>> waiters;
+	};
+
+	int epfd;
+	// Descriptor whose waiters are being run
+	int live_fd;
+	std::unordered_map<int, Registration> fds;
+	std::vector<epoll_event> events;
+	std::vector<std::pair<short, PlatformUtil::Fulfiller<short>>> dispatch;
+
+	void set_interest(int fd, Registration &reg, uint32_t interest, bool rearm = false);
+public:
+	EpollFdPoller();
+	~EpollFdPoller();
+	PlatformUtil::Promise<short> on_fd_ready(int fd, short ev) override;
+	void forget_fd(int fd) override;
+	void poll(int timeout);
+	bool is_empty();
+};
+
+typedef EpollFdPoller DefaultFdPoller;
+#else
+typedef ConsoleFdPoller DefaultFdPoller;
+#endif
@@ -7,6 +7,15 @@
 #include "fstream_file_impl.h"
 #include <string>
 #include <fstream>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 FstreamFileImpl::FstreamFileImpl() {
 }
@@ -28,3 +37,51 @@ bool FstreamFileImpl::write_file(const std::string &path, const std::string_view
     file.write(contents.data(), contents.size());
     return file.good();
 }
+
+bool FstreamFileImpl::write_file_durable(const std::string &path, const std::string_view contents) {
+    std::string tmp = path + ".tmp";
+#ifdef _WIN32
+    int fd = _open(tmp.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    if (fd < 0)
+        return false;
+    bool ok = true;
+    size_t written = 0;
+    while (ok && written < contents.size()) {
+#ifdef _WIN32
+        int ret = _write(fd, contents.data() + written, (unsigned)(contents.size() - written));
+#else
+        ssize_t ret = write(fd, contents.data() + written, contents.size() - written);
+        if (ret < 0 && errno == EINTR)
+            continue;
+#endif
+        if (ret <= 0)
+            ok = false;
+        else
+            written += ret;
+    }
+#ifdef _WIN32
+    ok = ok && _commit(fd) == 0;
+    ok = _close(fd) == 0 && ok;
+    ok = ok && MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+    if (ok) {
+        // The rename itself is only durable once the directory is synced
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? std::string(".") : path.substr(0, slash + 1);
+        int dirfd = open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+        if (dirfd >= 0) {
+            fsync(dirfd);
+            close(dirfd);
+        }
+    }
+#endif
+    if (!ok)
+        std::remove(tmp.c_str());
+    return ok;
+}
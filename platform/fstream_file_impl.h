@@ -13,4 +13,8 @@ public:
     FstreamFileImpl();
 	std::optional<std::string> read_file(const std::string &path);
     bool write_file(const std::string &path, const std::string_view contents);
+    // Writes a temporary file next to path, syncs it and renames it over
+    // path, so that the file holds either the old or the new contents
+    // even if power is lost
+    bool write_file_durable(const std::string &path, const std::string_view contents);
 };
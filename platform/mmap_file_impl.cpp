@@ -0,0 +1,57 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "mmap_file_impl.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MmapFileImpl::MmapFileImpl(FstreamFileImpl &fallback) : fallback(fallback) {
+}
+
+#ifndef _WIN32
+namespace {
+	struct Mapping : private PlatformUtil::NoCopy {
+		void *addr;
+		size_t len;
+		Mapping(void *a, size_t l) : addr(a), len(l) {}
+		~Mapping() {
+			munmap(addr, len);
+		}
+	};
+}
+#endif
+
+std::optional<BasePlatform::FileView> MmapFileImpl::map_file(const std::string &path) {
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return std::nullopt;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if (st.st_size == 0) {
+			close(fd);
+			return BasePlatform::FileView();
+		}
+		void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (addr != MAP_FAILED) {
+			auto mapping = std::make_shared<const Mapping>(addr, st.st_size);
+			return BasePlatform::FileView(mapping, std::string_view((const char*)addr, st.st_size));
+		}
+	} else {
+		close(fd);
+	}
+#endif
+	std::optional<std::string> contents = fallback.read_file(path);
+	if (!contents)
+		return std::nullopt;
+	auto buffer = std::make_shared<const std::string>(std::move(*contents));
+	return BasePlatform::FileView(buffer, *buffer);
+}
@@ -0,0 +1,19 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "platform.h"
+#include "fstream_file_impl.h"
+
+class MmapFileImpl {
+private:
+	FstreamFileImpl &fallback;
+
+public:
+	MmapFileImpl(FstreamFileImpl &fallback);
+	std::optional<BasePlatform::FileView> map_file(const std::string &path);
+};
@@ -6,4 +6,4 @@
 
 #include "platform.h"
 
-THREAD_LOCAL_DEF std::vector<std::unique_ptr<PlatformUtil::TypeErasedFulfiller>>* PlatformUtil::DeferredFulfillment::list;
+THREAD_LOCAL_DEF PlatformUtil::DeferredQueue* PlatformUtil::DeferredFulfillment::list;
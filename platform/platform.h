@@ -47,6 +47,10 @@ public:
 		virtual void broadcast(uint32_t tid, const std::string_view data) = 0;
 		virtual void send_to(uint32_t uid, const std::string_view data) = 0;
 		virtual PlatformUtil::Promise<ReceiveResult> receive() = 0;
+		// Asks the bus to only deliver broadcasts starting with one of the
+		// given prefixes. This is a hint: transports that cannot filter
+		// ignore it, so receivers must still check what they get.
+		virtual void subscribe(const std::vector<std::string> &prefixes) {}
 	};
 
 	struct DateTime
@@ -60,6 +64,21 @@ public:
 		int second;
 	};
 
+	// Read-only contents of a file. The bytes stay valid for as long as
+	// any copy of the view is alive, whether they come from a mapping or
+	// from a buffer filled by read_file.
+	class FileView
+	{
+		std::shared_ptr<const void> owner;
+		std::string_view contents;
+	public:
+		FileView() = default;
+		FileView(std::shared_ptr<const void> o, std::string_view c) : owner(std::move(o)), contents(c) {}
+		const char *data() const { return contents.data(); }
+		size_t size() const { return contents.size(); }
+		operator std::string_view() const { return contents; }
+	};
+
 	virtual int64_t get_timer() = 0;
 	virtual DateTime get_local_time()
 	{
@@ -68,10 +87,52 @@ public:
 
 	virtual std::unique_ptr<BusSocket> open_socket(const std::string_view bus, uint32_t tid) = 0;
 	virtual std::optional<std::string> read_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE) = 0;
+	virtual std::optional<FileView> map_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE)
+	{
+		std::optional<std::string> contents = read_file(path, file_type);
+		if (!contents)
+			return std::nullopt;
+		auto buffer = std::make_shared<const std::string>(std::move(*contents));
+		return FileView(buffer, *buffer);
+	}
 	virtual bool write_file(const std::string_view path, const std::string_view contents) = 0;
+	virtual PlatformUtil::Promise<bool> write_file_async(const std::string_view path, std::string &&contents)
+	{
+		auto pair = PlatformUtil::PromiseFactory::create<bool>();
+		pair.second.fulfill(write_file(path, contents));
+		return std::move(pair.first);
+	}
+	// Counters of write_file_async, on platforms that queue writes
+	struct FileWriteStats {
+		size_t queued_bytes = 0;
+		size_t peak_queued_bytes = 0;
+		uint64_t writes = 0;
+		uint64_t coalesced = 0;
+		uint64_t failed = 0;
+		// Milliseconds from queueing to the contents being on disk
+		int64_t last_latency = 0;
+		int64_t max_latency = 0;
+	};
+	virtual std::optional<FileWriteStats> file_write_stats()
+	{
+		return std::nullopt;
+	}
 	virtual void debug_print(const std::string_view msg) = 0;
 
 	virtual PlatformUtil::Promise<void> delay(int ms) = 0;
+	// Counters of delay(), on platforms that keep them
+	struct TimerStats {
+		uint64_t fired = 0;
+		uint64_t cancelled = 0;
+		// Milliseconds from a timer's expiry to its being fired
+		int64_t last_lateness = 0;
+		int64_t max_lateness = 0;
+		int64_t total_lateness = 0;
+	};
+	virtual std::optional<TimerStats> timer_stats()
+	{
+		return std::nullopt;
+	}
 	virtual PlatformUtil::Promise<void> on_quit_request() = 0;
 	virtual PlatformUtil::Promise<void> on_quit() = 0;
 
@@ -134,6 +195,8 @@ public:
 	virtual void draw_convex_polygon_filled(const std::vector<std::pair<float, float>> &poly) = 0;
 	virtual PlatformUtil::Promise<void> on_present_request() = 0;
 	virtual void present() = 0;
+	// Fulfilled once the frames presented so far are on screen
+	virtual PlatformUtil::Promise<void> on_present_completed() = 0;
 	virtual std::unique_ptr<Image> load_image(const std::string_view path) = 0;
 	virtual std::unique_ptr<Font> load_font(float ascent, bool bold, const std::string_view lang) = 0;
 	virtual std::unique_ptr<Image> make_text_image(const std::string_view text, const Font &font, Color c) = 0;
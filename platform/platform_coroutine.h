@@ -0,0 +1,196 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "platform_util.h"
+
+// Coroutine support for promises. Only available when building as C++20,
+// the rest of the tree does not depend on it.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define PLATFORM_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+
+namespace PlatformUtil
+{
+	// Coroutine frames are recycled through per-size free lists, like the
+	// deferred fulfilments, so that restarting a receive loop does not
+	// allocate. Frames above MAX_SIZE go to the heap, and so do frames
+	// freed while their list already holds MAX_CACHED of them, so that a
+	// burst of coroutines does not pin its memory for good.
+	class FramePool
+	{
+		static constexpr size_t GRANULE = 64;
+		static constexpr size_t CLASSES = 32;
+
+		struct FreeNode { FreeNode *next; };
+
+		static inline THREAD_LOCAL_DEF FreeNode *free_lists[CLASSES] = {};
+		static inline THREAD_LOCAL_DEF size_t free_counts[CLASSES] = {};
+
+	public:
+		FramePool() = delete;
+
+		static constexpr size_t MAX_SIZE = GRANULE * CLASSES;
+		static constexpr size_t MAX_CACHED = 16;
+
+		static void* allocate(size_t size) {
+			if (size == 0 || size > MAX_SIZE)
+				return ::operator new(size);
+			size_t c = (size - 1) / GRANULE;
+			FreeNode *n = free_lists[c];
+			if (n == nullptr)
+				return ::operator new((c + 1) * GRANULE);
+			free_lists[c] = n->next;
+			free_counts[c]--;
+			return n;
+		}
+
+		static void deallocate(void *p, size_t size) {
+			if (size == 0 || size > MAX_SIZE) {
+				::operator delete(p);
+				return;
+			}
+			size_t c = (size - 1) / GRANULE;
+			if (free_counts[c] >= MAX_CACHED) {
+				::operator delete(p);
+				return;
+			}
+			FreeNode *n = static_cast<FreeNode*>(p);
+			n->next = free_lists[c];
+			free_lists[c] = n;
+			free_counts[c]++;
+		}
+	};
+
+	// Return type of coroutines that co_await promises. The coroutine starts
+	// running immediately and is resumed from the deferred fulfilment queue
+	// whenever an awaited promise is fulfilled. If an awaited promise is
+	// cancelled instead, the coroutine is destroyed, as if its remaining
+	// code had been a then() callback that never runs.
+	// Like a promise, destroying the task cancels the coroutine, unless it
+	// was detached first.
+	class Task : private NoCopy
+	{
+	public:
+		struct promise_type
+		{
+			Task *owner = nullptr;
+
+			~promise_type() {
+				if (owner)
+					owner->handle = nullptr;
+			}
+
+			Task get_return_object() {
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+
+			static void* operator new(size_t size) { return FramePool::allocate(size); }
+			static void operator delete(void *p, size_t size) { FramePool::deallocate(p, size); }
+		};
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+
+		explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {
+			handle.promise().owner = this;
+		}
+
+	public:
+		Task() : handle(nullptr) {}
+		Task(Task &&other) : handle(nullptr) {
+			*this = std::move(other);
+		}
+		Task& operator=(Task &&other) {
+			cancel();
+			handle = other.handle;
+			other.handle = nullptr;
+			if (handle)
+				handle.promise().owner = this;
+			return *this;
+		}
+		~Task() {
+			cancel();
+		}
+
+		bool done() const {
+			return !handle;
+		}
+
+		void cancel() {
+			if (handle) {
+				auto h = handle;
+				handle = nullptr;
+				h.promise().owner = nullptr;
+				h.destroy();
+			}
+		}
+
+		void detach() {
+			if (handle)
+				handle.promise().owner = nullptr;
+			handle = nullptr;
+		}
+	};
+
+	template <typename T>
+	class PromiseAwaiter : private NoCopy
+	{
+		Promise<T> promise;
+		std::optional<T> result;
+
+	public:
+		PromiseAwaiter(Promise<T> &&p) : promise(std::move(p)) {}
+
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			promise.then([this, h](T &&value) {
+				result = std::move(value);
+				h.resume();
+			}).otherwise([h]() {
+				h.destroy();
+			});
+		}
+		T await_resume() { return std::move(*result); }
+	};
+
+	template <>
+	class PromiseAwaiter<void> : private NoCopy
+	{
+		Promise<void> promise;
+
+	public:
+		PromiseAwaiter(Promise<void> &&p) : promise(std::move(p)) {}
+
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			promise.then([h]() {
+				h.resume();
+			}).otherwise([h]() {
+				h.destroy();
+			});
+		}
+		void await_resume() {}
+	};
+
+	template <typename T>
+	PromiseAwaiter<T> operator co_await(Promise<T> &&p) {
+		return PromiseAwaiter<T>(std::move(p));
+	}
+
+	template <typename T>
+	PromiseAwaiter<T> operator co_await(Promise<T> &p) {
+		return PromiseAwaiter<T>(std::move(p));
+	}
+}
+#endif
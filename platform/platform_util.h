@@ -6,9 +6,14 @@
 
 #pragma once
 
+#include <new>
 #include <functional>
+#include <memory>
+#include <vector>
+#include <cstddef>
 #include <optional>
 #include <algorithm>
+#include <type_traits>
 
 #ifndef NO_THREADS
 #define THREAD_LOCAL_DEF thread_local
@@ -18,20 +23,193 @@
 
 namespace PlatformUtil
 {
+	// Copyable type-erased callable in the spirit of std::function, except
+	// that callables of up to INLINE_SIZE bytes are stored inline instead
+	// of on the heap.
+	template <typename Signature>
+	class Callback;
+
+	template <typename R, typename... Args>
+	class Callback<R(Args...)>
+	{
+		static constexpr size_t INLINE_SIZE = 48;
+
+		struct Ops
+		{
+			R (*invoke)(void *f, Args&&... args);
+			void (*move)(void *dst, void *src);
+			void (*copy)(void *dst, const void *src);
+			void (*destroy)(void *f);
+		};
+
+		template <typename F>
+		struct InlineOps
+		{
+			static R invoke(void *f, Args&&... args) { return (*static_cast<F*>(f))(std::forward<Args>(args)...); }
+			static void move(void *dst, void *src) {
+				new (dst) F(std::move(*static_cast<F*>(src)));
+				static_cast<F*>(src)->~F();
+			}
+			static void copy(void *dst, const void *src) { new (dst) F(*static_cast<const F*>(src)); }
+			static void destroy(void *f) { static_cast<F*>(f)->~F(); }
+			static constexpr Ops ops = { &invoke, &move, &copy, &destroy };
+		};
+
+		template <typename F>
+		struct HeapOps
+		{
+			static R invoke(void *f, Args&&... args) { return (**static_cast<F**>(f))(std::forward<Args>(args)...); }
+			static void move(void *dst, void *src) { *static_cast<F**>(dst) = *static_cast<F**>(src); }
+			static void copy(void *dst, const void *src) { *static_cast<F**>(dst) = new F(**static_cast<F* const*>(src)); }
+			static void destroy(void *f) { delete *static_cast<F**>(f); }
+			static constexpr Ops ops = { &invoke, &move, &copy, &destroy };
+		};
+
+		template <typename F>
+		using EnableIfCallable = std::enable_if_t<!std::is_same<std::decay_t<F>, Callback>::value && std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>;
+
+		alignas(std::max_align_t) mutable unsigned char storage[INLINE_SIZE];
+		const Ops *ops;
+
+		template <typename F>
+		void assign(F &&func) {
+			typedef std::decay_t<F> D;
+			if constexpr (!std::is_function<std::remove_reference_t<F>>::value && std::is_constructible<bool, const D&>::value) {
+				if (!static_cast<bool>(func))
+					return;
+			}
+			if constexpr (sizeof(D) <= INLINE_SIZE && alignof(D) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<D>::value) {
+				new (storage) D(std::forward<F>(func));
+				ops = &InlineOps<D>::ops;
+			} else {
+				*reinterpret_cast<D**>(storage) = new D(std::forward<F>(func));
+				ops = &HeapOps<D>::ops;
+			}
+		}
+
+		void reset() {
+			if (ops) {
+				const Ops *o = ops;
+				ops = nullptr;
+				o->destroy(storage);
+			}
+		}
+
+	public:
+		Callback() : ops(nullptr) {}
+		Callback(std::nullptr_t) : ops(nullptr) {}
+		template <typename F, typename = EnableIfCallable<F>>
+		Callback(F &&func) : ops(nullptr) {
+			assign(std::forward<F>(func));
+		}
+		Callback(const Callback &other) : ops(other.ops) {
+			if (ops)
+				ops->copy(storage, other.storage);
+		}
+		Callback(Callback &&other) noexcept : ops(other.ops) {
+			if (ops)
+				ops->move(storage, other.storage);
+			other.ops = nullptr;
+		}
+		~Callback() {
+			reset();
+		}
+		Callback& operator=(const Callback &other) {
+			if (this != &other) {
+				Callback tmp(other);
+				*this = std::move(tmp);
+			}
+			return *this;
+		}
+		Callback& operator=(Callback &&other) noexcept {
+			if (this != &other) {
+				reset();
+				ops = other.ops;
+				if (ops)
+					ops->move(storage, other.storage);
+				other.ops = nullptr;
+			}
+			return *this;
+		}
+		Callback& operator=(std::nullptr_t) {
+			reset();
+			return *this;
+		}
+		template <typename F, typename = EnableIfCallable<F>>
+		Callback& operator=(F &&func) {
+			reset();
+			assign(std::forward<F>(func));
+			return *this;
+		}
+
+		explicit operator bool() const { return ops != nullptr; }
+		bool operator==(std::nullptr_t) const { return ops == nullptr; }
+		bool operator!=(std::nullptr_t) const { return ops != nullptr; }
+
+		R operator()(Args... args) const {
+			return ops->invoke(storage, std::forward<Args>(args)...);
+		}
+	};
+
 	template <typename T>
 	struct CallbackType
 	{
 		CallbackType() = delete;
-		typedef std::function<void(T&&)> type;
+		typedef Callback<void(T&&)> type;
 	};
 
 	template <>
 	struct CallbackType<void>
 	{
 		CallbackType() = delete;
-		typedef std::function<void()> type;
+		typedef Callback<void()> type;
+	};
+
+	// Free lists for the small blocks that deferred fulfilments live in, so
+	// that deferring does not allocate once the event loop has warmed up.
+	// Blocks are kept per thread and per 16 byte size class.
+	template <size_t Size>
+	class NodePool
+	{
+		static constexpr size_t MAX_FREE = 256;
+
+		struct FreeNode { FreeNode *next; };
+
+		static THREAD_LOCAL_DEF FreeNode *free_list;
+		static THREAD_LOCAL_DEF size_t free_count;
+
+	public:
+		NodePool() = delete;
+
+		static void* allocate() {
+			if (free_list == nullptr)
+				return ::operator new(Size);
+			FreeNode *n = free_list;
+			free_list = n->next;
+			free_count--;
+			return n;
+		}
+
+		static void deallocate(void *p) {
+			if (free_count >= MAX_FREE) {
+				::operator delete(p);
+				return;
+			}
+			FreeNode *n = static_cast<FreeNode*>(p);
+			n->next = free_list;
+			free_list = n;
+			free_count++;
+		}
 	};
 
+	template <size_t Size>
+	THREAD_LOCAL_DEF typename NodePool<Size>::FreeNode *NodePool<Size>::free_list = nullptr;
+	template <size_t Size>
+	THREAD_LOCAL_DEF size_t NodePool<Size>::free_count = 0;
+
+	template <typename T>
+	using NodePoolFor = NodePool<(sizeof(T) + 15) / 16 * 16>;
+
 	class NoCopy
 	{
 	public:
@@ -60,6 +238,9 @@ namespace PlatformUtil
 	class TypeErasedFulfiller
 	{
 		friend class DeferredFulfillment;
+		friend class DeferredQueue;
+
+		TypeErasedFulfiller *next_deferred = nullptr;
 
 		virtual void execute_callback(bool defer) = 0;
 	public:
@@ -75,6 +256,52 @@ namespace PlatformUtil
 		void execute_callback(bool defer) override { fulfiller.execute_callback(defer); }
 	public:
 		FulfillerTypeEraser(Fulfiller<T> &&f) : fulfiller(std::move(f)) {}
+
+		static void* operator new(size_t size) { return NodePoolFor<FulfillerTypeEraser>::allocate(); }
+		static void operator delete(void *p) { NodePoolFor<FulfillerTypeEraser>::deallocate(p); }
+	};
+
+	// FIFO of deferred fulfilments, linked through the entries themselves
+	class DeferredQueue : private NoCopy
+	{
+		TypeErasedFulfiller *head;
+		TypeErasedFulfiller *tail;
+
+	public:
+		DeferredQueue() : head(nullptr), tail(nullptr) {}
+		~DeferredQueue() {
+			clear();
+		}
+
+		bool empty() const {
+			return head == nullptr;
+		}
+
+		void push_back(std::unique_ptr<TypeErasedFulfiller> &&f) {
+			TypeErasedFulfiller *e = f.release();
+			e->next_deferred = nullptr;
+			if (tail)
+				tail->next_deferred = e;
+			else
+				head = e;
+			tail = e;
+		}
+
+		// Detaches all entries and returns the first one
+		TypeErasedFulfiller* take() {
+			TypeErasedFulfiller *e = head;
+			head = tail = nullptr;
+			return e;
+		}
+
+		void clear() {
+			TypeErasedFulfiller *e = take();
+			while (e) {
+				TypeErasedFulfiller *next = e->next_deferred;
+				delete e;
+				e = next;
+			}
+		}
 	};
 
 	class DeferredFulfillment
@@ -82,16 +309,19 @@ namespace PlatformUtil
 	public:
 		DeferredFulfillment() = delete;
 
-		static THREAD_LOCAL_DEF std::vector<std::unique_ptr<TypeErasedFulfiller>>* list;
+		static THREAD_LOCAL_DEF DeferredQueue* list;
 
 		static bool execute() {
 			if (list->empty())
 				return false;
 
-			auto tmp = std::move(*list);
-			list->clear();
-			for (auto &f : tmp)
-				f->execute_callback(false);
+			TypeErasedFulfiller *e = list->take();
+			while (e) {
+				TypeErasedFulfiller *next = e->next_deferred;
+				e->execute_callback(false);
+				delete e;
+				e = next;
+			}
 
 			return true;
 		}
@@ -100,7 +330,7 @@ namespace PlatformUtil
 	class FuncFulfiller final : public TypeErasedFulfiller
 	{
 		template <typename T> friend class Promise;
-		std::function<void()> callback;
+		Callback<void()> callback;
 
 		void execute_callback(bool defer) override {
 			if (!defer)
@@ -112,8 +342,11 @@ namespace PlatformUtil
 		struct CreateTicket { };
 
 	public:
-		FuncFulfiller(std::function<void()> &&func, CreateTicket t) : callback(std::move(func)) {}
-		FuncFulfiller(const std::function<void()> &func, CreateTicket t) : callback(func) {}
+		FuncFulfiller(Callback<void()> &&func, CreateTicket t) : callback(std::move(func)) {}
+		FuncFulfiller(const Callback<void()> &func, CreateTicket t) : callback(func) {}
+
+		static void* operator new(size_t size) { return NodePoolFor<FuncFulfiller>::allocate(); }
+		static void operator delete(void *p) { NodePoolFor<FuncFulfiller>::deallocate(p); }
 	};
 
 	template <typename T>
@@ -126,7 +359,7 @@ namespace PlatformUtil
 		PromisePart<T>* promise;
 		std::optional<T> value;
 		typename CallbackType<T>::type callback;
-		std::function<void()> cancel_callback;
+		Callback<void()> cancel_callback;
 		FulfillerTypeEraser<T>* unmanaged;
 
 		void execute_callback(bool defer) {
@@ -140,12 +373,18 @@ namespace PlatformUtil
 				return;
 			}
 
+			// The callbacks are moved out first, since they may drop or
+			// re-arm the promise they were attached to
 			if (value) {
-				if (callback)
-					callback(std::move(*value));
+				if (callback) {
+					auto func = std::move(callback);
+					func(std::move(*value));
+				}
 			} else {
-				if (cancel_callback)
-					cancel_callback();
+				if (cancel_callback) {
+					auto func = std::move(cancel_callback);
+					func();
+				}
 			}
 
 			if (promise)
@@ -227,7 +466,7 @@ namespace PlatformUtil
 		PromisePart<void>* promise;
 		bool value;
 		typename CallbackType<void>::type callback;
-		std::function<void()> cancel_callback;
+		Callback<void()> cancel_callback;
 		FulfillerTypeEraser<void>* unmanaged;
 
 		void execute_callback(bool defer) {
@@ -242,11 +481,15 @@ namespace PlatformUtil
 			}
 
 			if (value) {
-				if (callback)
-					callback();
+				if (callback) {
+					auto func = std::move(callback);
+					func();
+				}
 			} else {
-				if (cancel_callback)
-					cancel_callback();
+				if (cancel_callback) {
+					auto func = std::move(cancel_callback);
+					func();
+				}
 			}
 
 			if (promise)
@@ -380,7 +623,7 @@ namespace PlatformUtil
 			return std::move(*this);
 		}
 
-		Promise<T>&& otherwise(const std::function<void()> &func) {
+		Promise<T>&& otherwise(const Callback<void()> &func) {
 			if (p.fulfiller)
 				p.fulfiller->cancel_callback = func;
 			else
@@ -388,7 +631,7 @@ namespace PlatformUtil
 			return std::move(*this);
 		}
 
-		Promise<T>&& otherwise(std::function<void()> &&func) {
+		Promise<T>&& otherwise(Callback<void()> &&func) {
 			if (p.fulfiller)
 				p.fulfiller->cancel_callback = std::move(func);
 			else
@@ -501,6 +744,21 @@ namespace PlatformUtil
 	class FulfillerList
 	{
 		std::vector<Fulfiller<T>> list;
+		// Storage of the previous dispatch, reused by the next one
+		std::vector<Fulfiller<T>> spare;
+
+		std::vector<Fulfiller<T>> take() {
+			std::vector<Fulfiller<T>> tmp;
+			tmp.swap(list);
+			list.swap(spare);
+			return tmp;
+		}
+
+		void recycle(std::vector<Fulfiller<T>> &&tmp) {
+			tmp.clear();
+			if (tmp.capacity() > spare.capacity())
+				spare.swap(tmp);
+		}
 
 	public:
 		void clear() {
@@ -517,50 +775,42 @@ namespace PlatformUtil
 		}
 
 		void fulfill_one(const T& arg, bool defer = true) {
-			std::vector<Fulfiller<T>> tmp = std::move(list);
-			list.clear();
-
-			auto it = tmp.begin();
-			while (it != tmp.end() && !it->is_pending())
+			auto it = list.begin();
+			while (it != list.end() && !it->is_pending())
 				++it;
-			if (it != tmp.end()) {
-				tmp.begin()->fulfill(arg, defer);
-				auto tmp_next = std::next(it);
-				if (tmp_next != tmp.end())
-					list.insert(list.begin(), std::make_move_iterator(tmp_next), std::make_move_iterator(tmp.end()));
+			if (it != list.end()) {
+				Fulfiller<T> f = std::move(*it);
+				list.erase(list.begin(), std::next(it));
+				f.fulfill(arg, defer);
 			}
 		}
 
 		void fulfill_one(T&& arg, bool defer = true) {
-			std::vector<Fulfiller<T>> tmp = std::move(list);
-			list.clear();
-
-			auto it = tmp.begin();
-			while (it != tmp.end() && !it->is_pending())
+			auto it = list.begin();
+			while (it != list.end() && !it->is_pending())
 				++it;
-			if (it != tmp.end()) {
-				tmp.begin()->fulfill(std::move(arg), defer);
-				auto tmp_next = std::next(it);
-				if (tmp_next != tmp.end())
-					list.insert(list.begin(), std::make_move_iterator(tmp_next), std::make_move_iterator(tmp.end()));
+			if (it != list.end()) {
+				Fulfiller<T> f = std::move(*it);
+				list.erase(list.begin(), std::next(it));
+				f.fulfill(std::move(arg), defer);
 			}
 		}
 
 		void fulfill_all(const T& arg, bool defer = true) {
-			std::vector<Fulfiller<T>> tmp = std::move(list);
-			list.clear();
+			std::vector<Fulfiller<T>> tmp = take();
 			for (PlatformUtil::Fulfiller<T> &f : tmp)
 				f.fulfill(arg, defer);
+			recycle(std::move(tmp));
 		}
 
 		void fulfill_all(T&& arg, bool defer = true) {
-			std::vector<Fulfiller<T>> tmp = std::move(list);
-			list.clear();
+			std::vector<Fulfiller<T>> tmp = take();
 			if (tmp.size() == 1)
 				tmp.begin()->fulfill(std::move(arg), defer);
 			else if (tmp.size() > 1)
 				for (PlatformUtil::Fulfiller<T> &f : tmp)
 					f.fulfill(arg, defer);
+			recycle(std::move(tmp));
 		}
 
 		Promise<T> create_and_add() {
@@ -574,6 +824,21 @@ namespace PlatformUtil
 	class FulfillerList<void>
 	{
 		std::vector<Fulfiller<void>> list;
+		// Storage of the previous dispatch, reused by the next one
+		std::vector<Fulfiller<void>> spare;
+
+		std::vector<Fulfiller<void>> take() {
+			std::vector<Fulfiller<void>> tmp;
+			tmp.swap(list);
+			list.swap(spare);
+			return tmp;
+		}
+
+		void recycle(std::vector<Fulfiller<void>> &&tmp) {
+			tmp.clear();
+			if (tmp.capacity() > spare.capacity())
+				spare.swap(tmp);
+		}
 
 	public:
 		void clear() {
@@ -590,25 +855,21 @@ namespace PlatformUtil
 		}
 
 		void fulfill_one(bool defer = true) {
-			std::vector<Fulfiller<void>> tmp = std::move(list);
-			list.clear();
-
-			auto it = tmp.begin();
-			while (it != tmp.end() && !it->is_pending())
+			auto it = list.begin();
+			while (it != list.end() && !it->is_pending())
 				++it;
-			if (it != tmp.end()) {
-				tmp.begin()->fulfill(defer);
-				auto tmp_next = std::next(it);
-				if (tmp_next != tmp.end())
-					list.insert(list.begin(), std::make_move_iterator(tmp_next), std::make_move_iterator(tmp.end()));
+			if (it != list.end()) {
+				Fulfiller<void> f = std::move(*it);
+				list.erase(list.begin(), std::next(it));
+				f.fulfill(defer);
 			}
 		}
 
 		void fulfill_all(bool defer = true) {
-			std::vector<Fulfiller<void>> tmp = std::move(list);
-			list.clear();
+			std::vector<Fulfiller<void>> tmp = take();
 			for (PlatformUtil::Fulfiller<void> &f : tmp)
 				f.fulfill(defer);
+			recycle(std::move(tmp));
 		}
 
 		Promise<void> create_and_add() {
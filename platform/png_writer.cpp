@@ -0,0 +1,93 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "png_writer.h"
+#include <algorithm>
+
+// Largest block a stored deflate block can hold
+static constexpr size_t STORED_BLOCK = 65535;
+
+static uint32_t crc32(const char *data, size_t len, uint32_t crc = 0) {
+	static uint32_t table[256];
+	static bool init = false;
+	if (!init) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		init = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++)
+		crc = table[(crc ^ (uint8_t)data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void put_u32(std::string &out, uint32_t v) {
+	out.push_back((char)(v >> 24));
+	out.push_back((char)(v >> 16));
+	out.push_back((char)(v >> 8));
+	out.push_back((char)v);
+}
+
+static void put_chunk(std::string &out, const char *type, const std::string &data) {
+	put_u32(out, data.size());
+	size_t start = out.size();
+	out.append(type, 4);
+	out += data;
+	put_u32(out, crc32(out.data() + start, out.size() - start));
+}
+
+std::string encode_png(const uint8_t *rgb, int w, int h, int pitch) {
+	// Each row starts with filter type 0, none
+	std::string raw;
+	raw.reserve((size_t)(3 * w + 1) * h);
+	for (int y = 0; y < h; y++) {
+		raw.push_back(0);
+		raw.append((const char*)rgb + (size_t)y * pitch, 3 * w);
+	}
+
+	// zlib stream with stored deflate blocks
+	std::string idat;
+	idat.reserve(raw.size() + raw.size() / STORED_BLOCK * 5 + 16);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	size_t pos = 0;
+	do {
+		size_t len = std::min(STORED_BLOCK, raw.size() - pos);
+		bool last = pos + len == raw.size();
+		idat.push_back(last ? 1 : 0);
+		idat.push_back((char)(len & 0xff));
+		idat.push_back((char)(len >> 8));
+		idat.push_back((char)(~len & 0xff));
+		idat.push_back((char)((~len >> 8) & 0xff));
+		idat.append(raw, pos, len);
+		pos += len;
+	} while (pos < raw.size());
+	uint32_t a = 1, b = 0;
+	for (char c : raw) {
+		a = (a + (uint8_t)c) % 65521;
+		b = (b + a) % 65521;
+	}
+	put_u32(idat, (b << 16) | a);
+
+	std::string ihdr;
+	put_u32(ihdr, w);
+	put_u32(ihdr, h);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(2); // truecolour
+	ihdr.push_back(0); // deflate
+	ihdr.push_back(0); // adaptive filtering
+	ihdr.push_back(0); // no interlace
+
+	std::string out("\x89PNG\r\n\x1a\n", 8);
+	put_chunk(out, "IHDR", ihdr);
+	put_chunk(out, "IDAT", idat);
+	put_chunk(out, "IEND", std::string());
+	return out;
+}
@@ -0,0 +1,16 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Encodes 8-bit RGB pixels, rows pitch bytes apart, as a PNG file.
+// The image data is stored without compression, which keeps the output
+// byte for byte identical for identical pixels, as wanted when comparing
+// screenshots, and needs no zlib.
+std::string encode_png(const uint8_t *rgb, int w, int h, int pitch);
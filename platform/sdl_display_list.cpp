@@ -0,0 +1,166 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdl_display_list.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// How far ahead a command is looked for in the other list when the two
+// lists stop matching, e.g. because a window added a few lines
+static constexpr size_t LOOKAHEAD = 32;
+
+// Beyond this many changed commands, their union is repainted
+static constexpr size_t MAX_MERGED = 256;
+
+static void hash_combine(size_t &h, size_t v) {
+	h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+}
+
+static size_t hash_float(float f) {
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	return std::hash<uint32_t>()(bits);
+}
+
+SdlDisplayList::Box SdlDisplayList::Box::merge(const Box &o) const {
+	if (empty())
+		return o;
+	if (o.empty())
+		return *this;
+	return { std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1) };
+}
+
+void SdlDisplayList::add(Command &&cmd) {
+	size_t h = (size_t)cmd.type;
+	hash_combine(h, (cmd.r << 16) | (cmd.g << 8) | cmd.b);
+	hash_combine(h, hash_float(cmd.x));
+	hash_combine(h, hash_float(cmd.y));
+	hash_combine(h, hash_float(cmd.w));
+	hash_combine(h, hash_float(cmd.h));
+	hash_combine(h, hash_float(cmd.a0));
+	hash_combine(h, hash_float(cmd.a1));
+	for (uint32_t i = 0; i < cmd.count; i++) {
+		hash_combine(h, hash_float(points[cmd.first + i].first));
+		hash_combine(h, hash_float(points[cmd.first + i].second));
+	}
+	hash_combine(h, std::hash<const void*>()(cmd.image.tex));
+	hash_combine(h, (size_t)cmd.image.x << 16 | cmd.image.y);
+	hash_combine(h, std::hash<const void*>()(cmd.text.get()));
+	cmd.hash = h;
+	commands.push_back(std::move(cmd));
+}
+
+void SdlDisplayList::clear() {
+	commands.clear();
+	points.clear();
+}
+
+bool SdlDisplayList::same(const Command &a, const SdlDisplayList &other, const Command &b) const {
+	if (a.hash != b.hash || a.type != b.type || a.r != b.r || a.g != b.g || a.b != b.b ||
+		a.x != b.x || a.y != b.y || a.w != b.w || a.h != b.h || a.a0 != b.a0 || a.a1 != b.a1 || a.count != b.count)
+		return false;
+	if (a.image.tex != b.image.tex || a.image.x != b.image.x || a.image.y != b.image.y ||
+		a.image.w != b.image.w || a.image.h != b.image.h)
+		return false;
+	// Layouts are held by both lists, so equal pointers mean equal text
+	if (a.text != b.text || a.atlas != b.atlas)
+		return false;
+	return std::equal(points.begin() + a.first, points.begin() + a.first + a.count, other.points.begin() + b.first);
+}
+
+void SdlDisplayList::diff(const SdlDisplayList &prev, std::vector<Box> &dirty, size_t max_boxes) const {
+	// Commands left out of an order-preserving match between both lists.
+	// Any pixel outside of them is covered by the same commands in the
+	// same order in both frames, so it does not change.
+	std::vector<Box> changed;
+	const std::vector<Command> &a = prev.commands;
+	const std::vector<Command> &b = commands;
+	size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size()) {
+		if (same(b[j], prev, a[i])) {
+			i++;
+			j++;
+			continue;
+		}
+		size_t skip_a = 0, skip_b = 0;
+		for (size_t k = 1; k <= LOOKAHEAD && i + k < a.size(); k++) {
+			if (same(b[j], prev, a[i + k])) {
+				skip_a = k;
+				break;
+			}
+		}
+		for (size_t k = 1; k <= LOOKAHEAD && j + k < b.size(); k++) {
+			if (same(b[j + k], prev, a[i])) {
+				skip_b = k;
+				break;
+			}
+		}
+		if (skip_a > 0 && (skip_b == 0 || skip_a <= skip_b)) {
+			for (; skip_a > 0; skip_a--)
+				changed.push_back(a[i++].box);
+		} else if (skip_b > 0) {
+			for (; skip_b > 0; skip_b--)
+				changed.push_back(b[j++].box);
+		} else {
+			changed.push_back(a[i++].box);
+			changed.push_back(b[j++].box);
+		}
+	}
+	for (; i < a.size(); i++)
+		changed.push_back(a[i].box);
+	for (; j < b.size(); j++)
+		changed.push_back(b[j].box);
+
+	dirty.clear();
+	if (changed.empty())
+		return;
+	if (changed.size() > MAX_MERGED) {
+		Box all = changed.front();
+		for (const Box &box : changed)
+			all = all.merge(box);
+		dirty.push_back(all);
+		return;
+	}
+	for (const Box &box : changed) {
+		if (box.empty())
+			continue;
+		// Absorb every area this one overlaps, until none is left
+		Box merged = box;
+		bool grown = true;
+		while (grown) {
+			grown = false;
+			for (size_t k = 0; k < dirty.size(); k++) {
+				if (dirty[k].intersects(merged)) {
+					merged = merged.merge(dirty[k]);
+					dirty[k] = dirty.back();
+					dirty.pop_back();
+					grown = true;
+					break;
+				}
+			}
+		}
+		dirty.push_back(merged);
+	}
+	// Too many areas: join the pair that adds the least repainted area
+	while (dirty.size() > max_boxes) {
+		size_t best_k = 0, best_l = 1;
+		int64_t best_cost = INT64_MAX;
+		for (size_t k = 0; k < dirty.size(); k++) {
+			for (size_t l = k + 1; l < dirty.size(); l++) {
+				int64_t cost = dirty[k].merge(dirty[l]).area() - dirty[k].area() - dirty[l].area();
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_k = k;
+					best_l = l;
+				}
+			}
+		}
+		dirty[best_k] = dirty[best_k].merge(dirty[best_l]);
+		dirty[best_l] = dirty.back();
+		dirty.pop_back();
+	}
+}
@@ -0,0 +1,73 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "sdl_glyph_atlas.h"
+#include "sdl_image_atlas.h"
+#include "sdl_text_cache.h"
+
+// Draw calls of one frame. The next frame is compared against it, so
+// that only the parts of the screen where they differ are drawn again.
+class SdlDisplayList {
+public:
+	// Pixel area, with x1 and y1 excluded
+	struct Box {
+		int x0, y0, x1, y1;
+		bool empty() const { return x0 >= x1 || y0 >= y1; }
+		bool intersects(const Box &o) const { return x0 < o.x1 && o.x0 < x1 && y0 < o.y1 && o.y0 < y1; }
+		Box merge(const Box &o) const;
+		int64_t area() const { return empty() ? 0 : (int64_t)(x1 - x0) * (y1 - y0); }
+	};
+
+	enum class Type : uint8_t {
+		Line,
+		Rect,
+		RectFilled,
+		Circle,
+		Arc,
+		Polygon,
+		Image,
+		Text,
+	};
+
+	struct Command {
+		Type type;
+		uint8_t r, g, b;
+		// Virtual coordinates: the corners of lines, the position and
+		// size of rectangles and images, the centre and radius of
+		// circles, or the centre and both radii of arcs
+		float x, y, w, h;
+		// Start and end angle of arcs
+		float a0, a1;
+		// Vertices of polygons in points
+		uint32_t first, count;
+		SdlImageAtlas::Region image;
+		const SdlGlyphAtlas *atlas;
+		std::shared_ptr<const SdlTextLayout> text;
+		// Keeps the atlas alive while the command may be drawn
+		std::shared_ptr<const void> font;
+		Box box;
+		size_t hash;
+	};
+
+	std::vector<Command> commands;
+	std::vector<std::pair<float, float>> points;
+
+	void add(Command &&cmd);
+	void clear();
+	// Areas that have to be drawn again for the screen to show this list
+	// when it shows prev. At most max_boxes are returned, merging nearby
+	// areas as needed.
+	void diff(const SdlDisplayList &prev, std::vector<Box> &dirty, size_t max_boxes) const;
+
+private:
+	bool same(const Command &a, const SdlDisplayList &other, const Command &b) const;
+};
@@ -0,0 +1,201 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdl_geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <SDL.h>
+
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+#error "SDL_RenderGeometryRaw() needs SDL 2.0.18 or later"
+#endif
+
+static_assert(sizeof(SdlGeometryBatch::Rgba) == sizeof(SDL_Color), "vertex colours are passed to SDL as SDL_Color");
+
+static constexpr float PI = 3.14159265358979323846f;
+static constexpr float ANGLE_STEP = 2 * PI / SdlGeometryBatch::ANGLE_STEPS;
+
+struct angle_table {
+	std::pair<float, float> dir[SdlGeometryBatch::ANGLE_STEPS];
+	angle_table() {
+		for (int i = 0; i < SdlGeometryBatch::ANGLE_STEPS; i++)
+			dir[i] = { std::cos(i * ANGLE_STEP), std::sin(i * ANGLE_STEP) };
+	}
+};
+
+static const angle_table &angles() {
+	static const angle_table table;
+	return table;
+}
+
+SdlGeometryBatch::SdlGeometryBatch() : scale(1), ox(0), oy(0), fringe(0.5f) {
+}
+
+void SdlGeometryBatch::set_transform(float s, float x, float y) {
+	scale = s;
+	ox = x;
+	oy = y;
+	fringe = 0.5f / std::abs(s);
+}
+
+int SdlGeometryBatch::vertex(float x, float y, Rgba c) {
+	xy.push_back(x * scale + ox);
+	xy.push_back(y * scale + oy);
+	colors.push_back(c);
+	return colors.size() - 1;
+}
+
+void SdlGeometryBatch::quad(int a, int b, int c, int d) {
+	indices.insert(indices.end(), { a, b, c, a, c, d });
+}
+
+void SdlGeometryBatch::arc(float cx, float cy, float rmin, float rmax, float a0, float a1, Rgba c) {
+	if (a1 < a0)
+		std::swap(a0, a1);
+	if (rmax < rmin)
+		std::swap(rmin, rmax);
+
+	// Directions of the columns of the mesh: the exact ends and every
+	// table angle in between
+	static std::vector<std::pair<float, float>> dirs;
+	dirs.clear();
+	dirs.push_back({ std::cos(a0), std::sin(a0) });
+	long k0 = (long)std::floor(a0 / ANGLE_STEP) + 1;
+	long k1 = (long)std::ceil(a1 / ANGLE_STEP) - 1;
+	const angle_table &table = angles();
+	for (long k = k0; k <= k1; k++)
+		dirs.push_back(table.dir[((k % ANGLE_STEPS) + ANGLE_STEPS) % ANGLE_STEPS]);
+	dirs.push_back({ std::cos(a1), std::sin(a1) });
+
+	// Rows: fringe inside, solid inside, solid outside, fringe outside.
+	// Bands narrower than a pixel are drawn with partial coverage.
+	Rgba clear = { c.r, c.g, c.b, 0 };
+	Rgba solid = c;
+	float radius[4];
+	if (rmax - rmin >= 2 * fringe) {
+		radius[1] = rmin + fringe;
+		radius[2] = rmax - fringe;
+	} else {
+		radius[1] = radius[2] = (rmin + rmax) / 2;
+		solid.a = (uint8_t)(c.a * (rmax - rmin) / (2 * fringe));
+	}
+	radius[0] = std::max(rmin - fringe, 0.0f);
+	radius[3] = rmax + fringe;
+	const Rgba row_color[4] = { clear, solid, solid, clear };
+
+	// The end columns are moved half a pixel inwards, and a transparent
+	// column half a pixel outwards fades the straight ends
+	int base = colors.size();
+	auto column = [&](const std::pair<float, float> &d, const std::pair<float, float> &t, float shift, bool transparent) {
+		for (int i = 0; i < 4; i++) {
+			float r = radius[i];
+			float sh = shift < 0 ? -std::min(-shift, (a1 - a0) * r / 2) : std::min(shift, (a1 - a0) * r / 2);
+			vertex(cx + r * d.first + t.first * sh, cy + r * d.second + t.second * sh, transparent ? clear : row_color[i]);
+		}
+	};
+	std::pair<float, float> t0 = { -dirs.front().second, dirs.front().first };
+	std::pair<float, float> t1 = { -dirs.back().second, dirs.back().first };
+	column(dirs.front(), t0, -fringe, true);
+	column(dirs.front(), t0, fringe, false);
+	for (size_t j = 1; j + 1 < dirs.size(); j++)
+		column(dirs[j], t0, 0, false);
+	column(dirs.back(), t1, -fringe, false);
+	column(dirs.back(), t1, fringe, true);
+
+	int columns = dirs.size() + 2;
+	for (int j = 0; j + 1 < columns; j++) {
+		int v = base + 4 * j;
+		for (int i = 0; i < 3; i++)
+			quad(v + i, v + i + 1, v + 4 + i + 1, v + 4 + i);
+	}
+}
+
+void SdlGeometryBatch::circle(float cx, float cy, float r, Rgba c) {
+	Rgba clear = { c.r, c.g, c.b, 0 };
+	Rgba solid = c;
+	float rin = r - fringe;
+	if (rin < 0) {
+		solid.a = (uint8_t)(c.a * r / fringe / 2);
+		rin = 0;
+	}
+	const angle_table &table = angles();
+	int center = vertex(cx, cy, solid);
+	for (int i = 0; i < ANGLE_STEPS; i++) {
+		vertex(cx + rin * table.dir[i].first, cy + rin * table.dir[i].second, solid);
+		vertex(cx + (r + fringe) * table.dir[i].first, cy + (r + fringe) * table.dir[i].second, clear);
+	}
+	for (int i = 0; i < ANGLE_STEPS; i++) {
+		int in0 = center + 1 + 2 * i;
+		int in1 = center + 1 + 2 * ((i + 1) % ANGLE_STEPS);
+		indices.insert(indices.end(), { center, in0, in1 });
+		quad(in0, in0 + 1, in1 + 1, in1);
+	}
+}
+
+void SdlGeometryBatch::convex(const std::pair<float, float> *points, size_t count, Rgba c) {
+	if (count < 3)
+		return;
+	Rgba clear = { c.r, c.g, c.b, 0 };
+	float area = 0;
+	for (size_t i = 0; i < count; i++) {
+		const std::pair<float, float> &p = points[i];
+		const std::pair<float, float> &q = points[(i + 1) % count];
+		area += p.first * q.second - q.first * p.second;
+	}
+	float sign = area >= 0 ? 1.0f : -1.0f;
+
+	// Outward normal of each edge, then one for each vertex in between,
+	// so that the fringe keeps its width at the corners
+	static std::vector<std::pair<float, float>> normals;
+	normals.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		const std::pair<float, float> &p = points[i];
+		const std::pair<float, float> &q = points[(i + 1) % count];
+		float dx = q.first - p.first;
+		float dy = q.second - p.second;
+		float len = std::sqrt(dx * dx + dy * dy);
+		if (len > 0) {
+			dx /= len;
+			dy /= len;
+		}
+		normals[i] = { dy * sign, -dx * sign };
+	}
+	int base = colors.size();
+	for (size_t i = 0; i < count; i++) {
+		const std::pair<float, float> &n0 = normals[(i + count - 1) % count];
+		const std::pair<float, float> &n1 = normals[i];
+		float nx = (n0.first + n1.first) / 2;
+		float ny = (n0.second + n1.second) / 2;
+		float len2 = nx * nx + ny * ny;
+		if (len2 > 1e-6f) {
+			float inv = std::min(1.0f / len2, 100.0f);
+			nx *= inv;
+			ny *= inv;
+		}
+		vertex(points[i].first - nx * fringe, points[i].second - ny * fringe, c);
+		vertex(points[i].first + nx * fringe, points[i].second + ny * fringe, clear);
+	}
+	for (size_t i = 1; i + 1 < count; i++)
+		indices.insert(indices.end(), { base, base + 2 * (int)i, base + 2 * (int)(i + 1) });
+	for (size_t i = 0; i < count; i++) {
+		int in0 = base + 2 * i;
+		int in1 = base + 2 * ((i + 1) % count);
+		quad(in0, in0 + 1, in1 + 1, in1);
+	}
+}
+
+void SdlGeometryBatch::flush(SDL_Renderer *renderer) {
+	if (indices.empty())
+		return;
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_RenderGeometryRaw(renderer, nullptr, xy.data(), 2 * sizeof(float), (const SDL_Color*)colors.data(), sizeof(Rgba),
+		nullptr, 0, colors.size(), indices.data(), indices.size(), sizeof(int));
+	counters.batches++;
+	counters.triangles += indices.size() / 3;
+	xy.clear();
+	colors.clear();
+	indices.clear();
+}
@@ -0,0 +1,58 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct SDL_Renderer;
+
+// Filled shapes tessellated into coloured triangles, which are submitted
+// together with SDL_RenderGeometryRaw() when the batch is flushed. Edges
+// get a fringe one pixel wide that fades out, for antialiasing.
+class SdlGeometryBatch {
+public:
+	// Arcs and circles go through these evenly spaced angles, plus the
+	// exact ends of arcs, so no sine or cosine is computed per vertex
+	static constexpr int ANGLE_STEPS = 120;
+
+	struct Rgba {
+		uint8_t r, g, b, a;
+	};
+
+	struct Stats {
+		uint64_t batches = 0;
+		uint64_t triangles = 0;
+	};
+
+private:
+	std::vector<float> xy;
+	std::vector<Rgba> colors;
+	std::vector<int> indices;
+	// Virtual to pixel coordinates
+	float scale, ox, oy;
+	// Half of the fringe, in virtual units
+	float fringe;
+	Stats counters;
+
+	int vertex(float x, float y, Rgba c);
+	void quad(int a, int b, int c, int d);
+
+public:
+	SdlGeometryBatch();
+
+	void set_transform(float s, float x, float y);
+	// Ring section between radii rmin and rmax, from angle a0 to a1
+	void arc(float cx, float cy, float rmin, float rmax, float a0, float a1, Rgba c);
+	void circle(float cx, float cy, float r, Rgba c);
+	void convex(const std::pair<float, float> *points, size_t count, Rgba c);
+	bool empty() const { return indices.empty(); }
+	void flush(SDL_Renderer *renderer);
+	const Stats &stats() const { return counters; }
+};
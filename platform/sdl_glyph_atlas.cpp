@@ -0,0 +1,151 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdl_glyph_atlas.h"
+#include <cstdio>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#if !defined(SDL_TTF_VERSION_ATLEAST) || !SDL_TTF_VERSION_ATLEAST(2, 0, 18)
+#error "The 32-bit glyph functions need SDL_ttf 2.0.18 or later"
+#endif
+
+// Empty pixels kept around each glyph, so that filtering never samples
+// a neighbour when the atlas is drawn scaled
+static constexpr int GLYPH_PADDING = 1;
+
+static uint32_t next_code_point(const std::string_view str, size_t &pos) {
+	unsigned char c = str[pos];
+	int extra;
+	uint32_t cp;
+	if ((c & 0b11111000) == 0b11110000) {
+		extra = 3;
+		cp = c & 0b00000111;
+	} else if ((c & 0b11110000) == 0b11100000) {
+		extra = 2;
+		cp = c & 0b00001111;
+	} else if ((c & 0b11100000) == 0b11000000) {
+		extra = 1;
+		cp = c & 0b00011111;
+	} else {
+		extra = 0;
+		cp = c;
+	}
+	pos++;
+	for (int i = 0; i < extra && pos < str.size(); i++, pos++)
+		cp = (cp << 6) | (str[pos] & 0b00111111);
+	return cp;
+}
+
+SdlGlyphAtlas::SdlGlyphAtlas(SDL_Renderer *r, TTF_Font *f) : renderer(r), font(f), shelf_x(0), shelf_y(0), shelf_h(0) {
+}
+
+SdlGlyphAtlas::~SdlGlyphAtlas() {
+	for (SDL_Texture *tex : pages)
+		SDL_DestroyTexture(tex);
+}
+
+bool SdlGlyphAtlas::add(uint32_t cp, Glyph &glyph) {
+	int minx, maxx, miny, maxy, advance;
+	if (!TTF_GlyphIsProvided32(font, cp) || TTF_GlyphMetrics32(font, cp, &minx, &maxx, &miny, &maxy, &advance) != 0)
+		return false;
+	glyph.advance = advance;
+	glyph.w = glyph.h = 0;
+	glyph.x = glyph.y = 0;
+	glyph.page = 0;
+
+	SDL_Color white = { 255, 255, 255, 255 };
+	SDL_Surface *rendered = TTF_RenderGlyph32_Blended(font, cp, white);
+	if (rendered == nullptr)
+		return false;
+	SDL_Surface *surf = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(rendered);
+	if (surf == nullptr)
+		return false;
+
+	int w = surf->w + GLYPH_PADDING;
+	int h = surf->h + GLYPH_PADDING;
+	if (w > PAGE_SIZE || h > PAGE_SIZE) {
+		SDL_FreeSurface(surf);
+		return false;
+	}
+	if (shelf_x + w > PAGE_SIZE) {
+		shelf_x = 0;
+		shelf_y += shelf_h;
+		shelf_h = 0;
+	}
+	if (pages.empty() || shelf_y + h > PAGE_SIZE) {
+		SDL_Texture *tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+		if (tex == nullptr) {
+			printf("SDL_CreateTexture failed: %s\n", SDL_GetError());
+			SDL_FreeSurface(surf);
+			return false;
+		}
+		SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+		// Clear the page, so that the padding is transparent
+		std::vector<uint32_t> blank(PAGE_SIZE * PAGE_SIZE, 0);
+		SDL_UpdateTexture(tex, nullptr, blank.data(), PAGE_SIZE * 4);
+		pages.push_back(tex);
+		counters.pages++;
+		shelf_x = shelf_y = shelf_h = 0;
+	}
+
+	SDL_Rect rect { shelf_x, shelf_y, surf->w, surf->h };
+	if (surf->w > 0 && surf->h > 0)
+		SDL_UpdateTexture(pages.back(), &rect, surf->pixels, surf->pitch);
+	glyph.page = pages.size() - 1;
+	glyph.x = rect.x;
+	glyph.y = rect.y;
+	glyph.w = rect.w;
+	glyph.h = rect.h;
+	shelf_x += w;
+	if (h > shelf_h)
+		shelf_h = h;
+	SDL_FreeSurface(surf);
+	counters.glyphs++;
+	return true;
+}
+
+const SdlGlyphAtlas::Glyph *SdlGlyphAtlas::get(uint32_t cp) {
+	auto it = glyphs.find(cp);
+	if (it != glyphs.end())
+		return it->second.advance >= 0 ? &it->second : nullptr;
+	Glyph glyph;
+	if (!add(cp, glyph)) {
+		// Remembered, so that the font is not asked again
+		glyph.advance = -1;
+		counters.failed++;
+	}
+	it = glyphs.emplace(cp, glyph).first;
+	return glyph.advance >= 0 ? &it->second : nullptr;
+}
+
+float SdlGlyphAtlas::layout_line(const std::string_view text, float x, float y, std::vector<Quad> &quads) {
+	float start = x;
+	uint32_t prev = 0;
+	size_t pos = 0;
+	while (pos < text.size()) {
+		uint32_t cp = next_code_point(text, pos);
+		const Glyph *glyph = get(cp);
+		if (glyph == nullptr)
+			continue;
+		if (prev != 0)
+			x += TTF_GetFontKerningSizeGlyphs32(font, prev, cp);
+		if (glyph->w > 0)
+			quads.push_back({glyph, x, y});
+		x += glyph->advance;
+		prev = cp;
+	}
+	return x - start;
+}
+
+int SdlGlyphAtlas::line_height() const {
+	return TTF_FontHeight(font);
+}
+
+int SdlGlyphAtlas::line_skip() const {
+	return TTF_FontLineSkip(font);
+}
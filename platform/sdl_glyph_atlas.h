@@ -0,0 +1,72 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct SDL_Renderer;
+struct SDL_Texture;
+struct _TTF_Font;
+typedef struct _TTF_Font TTF_Font;
+
+// Glyphs of one font, rasterized in white the first time they are used
+// and packed into shared textures. Text is then drawn as a batch of
+// textured quads, tinted through the vertex colour.
+class SdlGlyphAtlas {
+public:
+	static constexpr int PAGE_SIZE = 1024;
+
+	struct Glyph {
+		int page;
+		// Position in the page; the glyph is drawn with its top-left
+		// corner at the pen position on the top of the line
+		int x, y, w, h;
+		int advance;
+	};
+
+	// One glyph placed in a line of text, in pixels
+	struct Quad {
+		const Glyph *glyph;
+		float x, y;
+	};
+
+	struct Stats {
+		uint64_t glyphs = 0;
+		uint64_t pages = 0;
+		uint64_t failed = 0;
+	};
+
+private:
+	SDL_Renderer *renderer;
+	TTF_Font *font;
+	std::vector<SDL_Texture*> pages;
+	// Shelf packer state for the last page
+	int shelf_x, shelf_y, shelf_h;
+	std::unordered_map<uint32_t, Glyph> glyphs;
+	Stats counters;
+
+	bool add(uint32_t cp, Glyph &glyph);
+
+public:
+	SdlGlyphAtlas(SDL_Renderer *r, TTF_Font *f);
+	~SdlGlyphAtlas();
+	SdlGlyphAtlas(const SdlGlyphAtlas &) = delete;
+	SdlGlyphAtlas &operator=(const SdlGlyphAtlas &) = delete;
+
+	// Null for code points the font cannot render
+	const Glyph *get(uint32_t cp);
+	SDL_Texture *page(int i) const { return pages[i]; }
+	// Places a single line of UTF-8 text starting at (x, y), appending
+	// to quads. Returns the advance width of the line.
+	float layout_line(const std::string_view text, float x, float y, std::vector<Quad> &quads);
+	int line_height() const;
+	int line_skip() const;
+	const Stats &stats() const { return counters; }
+};
@@ -0,0 +1,98 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdl_image_atlas.h"
+#include <algorithm>
+#include <cstdio>
+#include <SDL.h>
+
+// Border around each image, filled with copies of its edge pixels, so
+// that filtering at the edges samples the image itself when scaled
+static constexpr int IMAGE_PADDING = 1;
+
+SdlImageAtlas::SdlImageAtlas(SDL_Renderer *r) : renderer(r), shelf_x(0), shelf_y(0), shelf_h(0) {
+}
+
+SdlImageAtlas::~SdlImageAtlas() {
+	for (SDL_Texture *tex : pages)
+		SDL_DestroyTexture(tex);
+	for (SDL_Texture *tex : standalone)
+		SDL_DestroyTexture(tex);
+}
+
+const SdlImageAtlas::Region *SdlImageAtlas::find(const std::string_view path) {
+	auto it = images.find(path);
+	if (it == images.end())
+		return nullptr;
+	counters.hits++;
+	return &it->second;
+}
+
+const SdlImageAtlas::Region &SdlImageAtlas::add(const std::string_view path, SDL_Surface *surf) {
+	Region region { nullptr, 0, 0, 0, 0 };
+	if (surf != nullptr && !pack(surf, region))
+		region.tex = nullptr;
+	return images.insert_or_assign(std::string(path), region).first->second;
+}
+
+bool SdlImageAtlas::pack(SDL_Surface *source, Region &region) {
+	if (source->w > MAX_PACKED_SIZE || source->h > MAX_PACKED_SIZE) {
+		SDL_Texture *tex = SDL_CreateTextureFromSurface(renderer, source);
+		if (tex == nullptr) {
+			printf("SDL_CreateTextureFromSurface failed: %s\n", SDL_GetError());
+			return false;
+		}
+		standalone.push_back(tex);
+		counters.standalone++;
+		counters.images++;
+		region = { tex, 0, 0, source->w, source->h };
+		return true;
+	}
+
+	SDL_Surface *surf = SDL_ConvertSurfaceFormat(source, SDL_PIXELFORMAT_ARGB8888, 0);
+	if (surf == nullptr)
+		return false;
+
+	// Padded copy, with the edges extended into the border
+	int w = surf->w + 2 * IMAGE_PADDING;
+	int h = surf->h + 2 * IMAGE_PADDING;
+	std::vector<uint32_t> pixels(w * h);
+	for (int y = 0; y < h; y++) {
+		int sy = std::min(std::max(y - IMAGE_PADDING, 0), surf->h - 1);
+		const uint32_t *row = (const uint32_t*)((const uint8_t*)surf->pixels + sy * surf->pitch);
+		for (int x = 0; x < w; x++)
+			pixels[y * w + x] = row[std::min(std::max(x - IMAGE_PADDING, 0), surf->w - 1)];
+	}
+	int sw = surf->w;
+	int sh = surf->h;
+	SDL_FreeSurface(surf);
+
+	if (shelf_x + w > PAGE_SIZE) {
+		shelf_x = 0;
+		shelf_y += shelf_h;
+		shelf_h = 0;
+	}
+	if (pages.empty() || shelf_y + h > PAGE_SIZE) {
+		SDL_Texture *tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+		if (tex == nullptr) {
+			printf("SDL_CreateTexture failed: %s\n", SDL_GetError());
+			return false;
+		}
+		SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+		pages.push_back(tex);
+		counters.pages++;
+		shelf_x = shelf_y = shelf_h = 0;
+	}
+
+	SDL_Rect rect { shelf_x, shelf_y, w, h };
+	SDL_UpdateTexture(pages.back(), &rect, pixels.data(), w * 4);
+	region = { pages.back(), shelf_x + IMAGE_PADDING, shelf_y + IMAGE_PADDING, sw, sh };
+	shelf_x += w;
+	if (h > shelf_h)
+		shelf_h = h;
+	counters.images++;
+	return true;
+}
@@ -0,0 +1,64 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SDL_Renderer;
+struct SDL_Texture;
+struct SDL_Surface;
+
+// Bitmaps loaded by path, each loaded once and packed into shared
+// textures, so that windows rebuilt with the same symbols read nothing
+// from disk and most images are drawn from the same texture.
+class SdlImageAtlas {
+public:
+	static constexpr int PAGE_SIZE = 1024;
+	// Larger images get a texture of their own
+	static constexpr int MAX_PACKED_SIZE = 256;
+
+	struct Region {
+		SDL_Texture *tex;
+		int x, y, w, h;
+	};
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t images = 0;
+		uint64_t pages = 0;
+		uint64_t standalone = 0;
+	};
+
+private:
+	SDL_Renderer *renderer;
+	std::vector<SDL_Texture*> pages;
+	std::vector<SDL_Texture*> standalone;
+	// Shelf packer state for the last page
+	int shelf_x, shelf_y, shelf_h;
+	// Images that failed to load are kept as null regions
+	std::map<std::string, Region, std::less<>> images;
+	Stats counters;
+
+	bool pack(SDL_Surface *surf, Region &region);
+
+public:
+	explicit SdlImageAtlas(SDL_Renderer *r);
+	~SdlImageAtlas();
+	SdlImageAtlas(const SdlImageAtlas &) = delete;
+	SdlImageAtlas &operator=(const SdlImageAtlas &) = delete;
+
+	// Null if the path was never added
+	const Region *find(const std::string_view path);
+	// Copies the surface into the atlas, or records a failed load if
+	// surf is null. The surface is not freed.
+	const Region &add(const std::string_view path, SDL_Surface *surf);
+	const Stats &stats() const { return counters; }
+};
@@ -5,11 +5,14 @@
  */
 
 #include "sdl_platform.h"
-#include "sdl_gfx/gfx_primitives.h"
 #include "platform_runtime.h"
+#include "bus_recording.h"
+#include "png_writer.h"
 #include <algorithm>
+#include <filesystem>
 #include <fstream>
 #include <cmath>
+#include <ctime>
 #include <SDL.h>
 #include <SDL_ttf.h>
 
@@ -20,8 +23,20 @@ int main(int argc, char *argv[])
 		args.push_back(std::string(argv[i]));
 	platform = std::make_unique<SdlPlatform>(platform_size_w, platform_size_h, args);
 	on_platform_ready();
-	static_cast<SdlPlatform*>(platform.get())->event_loop();
-	return 0;
+	return static_cast<SdlPlatform*>(platform.get())->event_loop();
+}
+
+// CPU time of the calling thread, which unlike the wall clock leaves out
+// waiting for vsync and time the process was not scheduled
+static int64_t thread_cpu_time_us()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	return (int64_t)std::clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
 }
 
 void SdlPlatform::SdlPlatform::load_config(const std::vector<std::string>& args)
@@ -130,15 +145,23 @@ SdlPlatform::SdlPlatform(float virtual_w, float virtual_h, const std::vector<std
 	config_dir(get_files_dir(ETCS_CONFIG_FILE)),
 	storage_dir(get_files_dir(ETCS_STORAGE_FILE)),
 	bus_socket_impl(config_dir, poller, args),
-	fstream_file_impl()
+	fstream_file_impl(),
+	mmap_file_impl(fstream_file_impl),
+	file_writer(fstream_file_impl, libc_time_impl),
+	text_cache(0)
 {
+	load_config(args);
+	headless = get_config("headless") == "true";
+	if (headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	}
 	SDL_Init(SDL_INIT_EVERYTHING);
 
-	load_config(args);
 	bool fullscreen = get_config("fullScreen") == "true";
 	int display = std::stoi(get_config("display", "0"));
-	int width = std::stoi(get_config("width", "800"));
-	int height = std::stoi(get_config("height", "600"));
+	int width = std::stoi(get_config("width", headless ? "640" : "800"));
+	int height = std::stoi(get_config("height", headless ? "480" : "600"));
 	int xpos = std::stoi(get_config("xpos", "0"));
 	int ypos = std::stoi(get_config("ypos", "0"));
 	bool borderless = get_config("borderless") == "true";
@@ -146,6 +169,7 @@ SdlPlatform::SdlPlatform(float virtual_w, float virtual_h, const std::vector<std
 	bool ontop = get_config("alwaysOnTop") == "true";
 	bool hidecursor = get_config("hideCursor") == "true";
 	std::string title = get_config("title") == "" ? "SdlPlatform" : get_config("title");
+	text_cache.set_budget(std::stoul(get_config("textCacheKB", "1024")) * 1024);
 
 	int flags = 0;
 	if (borderless)
@@ -164,7 +188,11 @@ SdlPlatform::SdlPlatform(float virtual_w, float virtual_h, const std::vector<std
 	if (hidecursor)
 		SDL_ShowCursor(SDL_DISABLE);
 
-	sdlrend = SDL_CreateRenderer(sdlwindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
+	// The dummy driver has no surface to accelerate, and nothing to wait for
+	if (headless)
+		sdlrend = SDL_CreateRenderer(sdlwindow, -1, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE);
+	else
+		sdlrend = SDL_CreateRenderer(sdlwindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
 
 	int wx, wy;
 	SDL_GetWindowSize(sdlwindow, &wx, &wy);
@@ -188,6 +216,10 @@ SdlPlatform::SdlPlatform(float virtual_w, float virtual_h, const std::vector<std
 
 	TTF_Init();
 
+	image_atlas = std::make_unique<SdlImageAtlas>(sdlrend);
+	if (get_config("preloadSymbols", "true") == "true")
+		preload_images("symbols");
+
 	SDL_AudioSpec desired = {};
 	SDL_AudioSpec obtained;
 	desired.freq = 44100;
@@ -204,19 +236,46 @@ SdlPlatform::SdlPlatform(float virtual_w, float virtual_h, const std::vector<std
 	running = true;
 	present_count = 0;
 
+	current_list = 0;
+	SDL_GetRendererOutputSize(sdlrend, &frame_w, &frame_h);
+	frame = SDL_CreateTexture(sdlrend, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, frame_w, frame_h);
+	if (frame == nullptr)
+		printf("SDL_CreateTexture failed: %s\n", SDL_GetError());
+	else
+		SDL_SetTextureBlendMode(frame, SDL_BLENDMODE_NONE);
+	geometry.set_transform(s, ox, oy);
+	retained = get_config("dirtyRegions", "true") == "true";
+	full_redraw = true;
+	idle_frame_interval = std::stoi(get_config("idleFrameInterval", "20"));
+	next_present_time = 0;
+
+	pending_quit = false;
+	snapshot_dir = get_config("snapshotDir");
+	frame_times = get_config("frameTimes", headless ? "true" : "false") == "true";
+	frame_time_percentile = std::stoi(get_config("frameTimePercentile", "99"));
+	frame_time_limit = std::stoll(get_config("frameTimeLimit", "0"));
+
 	PlatformUtil::DeferredFulfillment::list = &event_list;
 }
 
 SdlPlatform::~SdlPlatform() {
-	timer_queue.clear();
+	file_writer.flush();
+	timers.clear();
 	on_close_list.clear();
 	on_quit_list.clear();
 	on_present_list.clear();
+	on_present_completed_list.clear();
 	on_input_list.clear();
 	while (PlatformUtil::DeferredFulfillment::execute());
 	PlatformUtil::DeferredFulfillment::list = nullptr;
 
+	display_lists[0].clear();
+	display_lists[1].clear();
+	if (frame != nullptr)
+		SDL_DestroyTexture(frame);
+	text_cache.clear();
 	loaded_fonts.clear();
+	image_atlas = nullptr;
 	SDL_CloseAudioDevice(audio_device);
 	TTF_Quit();
 	//SDL_DestroyRenderer(sdlrend);
@@ -225,6 +284,17 @@ SdlPlatform::~SdlPlatform() {
 }
 
 std::unique_ptr<SdlPlatform::BusSocket> SdlPlatform::open_socket(const std::string_view channel, uint32_t tid) {
+	if (channel == "evc_dmi") {
+		std::string replay = get_config("replay");
+		if (!replay.empty()) {
+			return std::make_unique<ReplayBusSocket>(replay,
+				[this](const std::string &name) { pending_snapshots.push_back(name); },
+				[this]() { pending_quit = true; });
+		}
+		std::string record = get_config("record");
+		if (!record.empty())
+			return std::make_unique<RecordingBusSocket>(bus_socket_impl.open_bus_socket(channel, tid), record);
+	}
 	return bus_socket_impl.open_bus_socket(channel, tid);
 }
 
@@ -236,8 +306,29 @@ std::optional<std::string> SdlPlatform::read_file(const std::string_view path, F
 	return fstream_file_impl.read_file((type == ETCS_ASSET_FILE ? assets_dir : (type == ETCS_CONFIG_FILE ? config_dir : storage_dir)) + std::string(path));
 }
 
+std::optional<SdlPlatform::FileView> SdlPlatform::map_file(const std::string_view path, FileType type) {
+	// Storage files are rewritten in place by write_file, which would
+	// invalidate a live mapping, so those are always read into memory.
+	if (type == ETCS_STORAGE_FILE)
+		return BasePlatform::map_file(path, type);
+	return mmap_file_impl.map_file((type == ETCS_ASSET_FILE ? assets_dir : config_dir) + std::string(path));
+}
+
 bool SdlPlatform::write_file(const std::string_view path, const std::string_view contents) {
-	return fstream_file_impl.write_file(storage_dir + std::string(path), contents);
+	// Queued writes to the same file must not land after this one
+	return file_writer.write_now(storage_dir + std::string(path), contents);
+}
+
+PlatformUtil::Promise<bool> SdlPlatform::write_file_async(const std::string_view path, std::string &&contents) {
+	return file_writer.write(storage_dir + std::string(path), std::move(contents));
+}
+
+std::optional<SdlPlatform::FileWriteStats> SdlPlatform::file_write_stats() {
+	return file_writer.stats();
+}
+
+std::optional<SdlPlatform::TimerStats> SdlPlatform::timer_stats() {
+	return timers.stats();
 }
 
 void SdlPlatform::debug_print(const std::string_view msg) {
@@ -245,9 +336,7 @@ void SdlPlatform::debug_print(const std::string_view msg) {
 }
 
 PlatformUtil::Promise<void> SdlPlatform::delay(int ms) {
-	auto pair = PlatformUtil::PromiseFactory::create<void>();
-	timer_queue.insert(std::make_pair(get_timer() + ms, std::move(pair.second)));
-	return std::move(pair.first);
+	return timers.delay(get_timer(), ms);
 }
 
 PlatformUtil::Promise<void> SdlPlatform::on_quit_request() {
@@ -268,6 +357,10 @@ bool SdlPlatform::poll_sdl() {
 		if (ev.type == SDL_QUIT || ev.type == SDL_WINDOWEVENT_CLOSE) {
 			on_close_list.fulfill_all(false);
 		}
+		else if (ev.type == SDL_RENDER_TARGETS_RESET || ev.type == SDL_WINDOWEVENT) {
+			// The frame texture or the window may have lost their contents
+			full_redraw = true;
+		}
 		else if (ev.type == SDL_MOUSEBUTTONDOWN || ev.type == SDL_MOUSEBUTTONUP) {
 			SDL_MouseButtonEvent sdlev = ev.button;
 			if (sdlev.button == SDL_BUTTON_LEFT) {
@@ -295,19 +388,15 @@ bool SdlPlatform::poll_sdl() {
 	return false;
 }
 
-void SdlPlatform::event_loop() {
+int SdlPlatform::event_loop() {
 	while (running) {
 		bool idle = true;
 
 		while (poll_sdl())
 			idle = false;
 
-		int64_t now = get_timer();
-		if (!timer_queue.empty() && timer_queue.begin()->first <= now) {
+		if (timers.advance(get_timer()))
 			idle = false;
-			timer_queue.begin()->second.fulfill(false);
-			timer_queue.erase(timer_queue.begin());
-		}
 
 		for (int i = 0; i < 10; i++)
 			if (PlatformUtil::DeferredFulfillment::execute())
@@ -315,27 +404,116 @@ void SdlPlatform::event_loop() {
 			else
 				break;
 
-		on_present_list.fulfill_all(false);
+		if (idle && file_writer.poll())
+			idle = false;
+
+		// After a frame that changed nothing, the next one is requested
+		// a little later instead of at the display rate
+		int64_t frame_start = 0;
+		bool requested = get_timer() >= next_present_time;
+		if (requested) {
+			frame_start = thread_cpu_time_us();
+			on_present_list.fulfill_all(false);
+		}
 
 		if (present_count > 0) {
 			present_count--;
-			idle = false;
-			SDL_RenderPresent(sdlrend);
-			SDL_SetRenderDrawColor(sdlrend, 0, 0, 0, 255);
-			SDL_RenderClear(sdlrend);
+			if (render_frame()) {
+				idle = false;
+				next_present_time = 0;
+			} else {
+				next_present_time = get_timer() + idle_frame_interval;
+			}
+			// Either SDL_RenderPresent() has returned, or the screen
+			// already shows what was drawn
+			on_present_completed_list.fulfill_all();
+			if (frame_times && requested)
+				frame_time_samples.push_back(thread_cpu_time_us() - frame_start);
+			// The messages before a marker were handled before this frame
+			// was drawn, so it shows their effect
+			while (!pending_snapshots.empty()) {
+				write_snapshot(pending_snapshots.front());
+				pending_snapshots.pop_front();
+			}
+			if (pending_quit)
+				quit();
 		}
 
-		int64_t diff = -1;
-		if (!timer_queue.empty())
-			diff = std::max((int64_t)0, timer_queue.begin()->first - get_timer());
+		int64_t diff = timers.next_expiry();
+		if (diff >= 0)
+			diff = std::max((int64_t)0, diff - get_timer());
 
 		if (diff == -1 || diff > 10)
 			diff = 10;
+		if (next_present_time > 0)
+			diff = std::min(diff, std::max((int64_t)0, next_present_time - get_timer()));
 
 		poller.poll(idle ? diff : 0);
 	};
 
+	file_writer.flush();
+	AsyncFileWriter::Stats stats = file_writer.stats();
+	if (stats.writes > 0)
+		debug_print("file writes: " + std::to_string(stats.writes) + ", coalesced " + std::to_string(stats.coalesced) + ", failed " + std::to_string(stats.failed) +
+			", peak queued " + std::to_string(stats.peak_queued_bytes) + " bytes, max latency " + std::to_string(stats.max_latency) + " ms");
+	const TimerWheel::Stats &timer_stats = timers.stats();
+	if (timer_stats.fired > 0)
+		debug_print("timers fired: " + std::to_string(timer_stats.fired) + ", cancelled " + std::to_string(timer_stats.cancelled) +
+			", mean lateness " + std::to_string(timer_stats.total_lateness / (int64_t)timer_stats.fired) + " ms, max lateness " + std::to_string(timer_stats.max_lateness) + " ms");
+	std::string bus_stats = bus_socket_impl.dump_stats();
+	if (!bus_stats.empty()) {
+		bus_stats.pop_back();
+		debug_print(bus_stats);
+	}
+
+	SdlGlyphAtlas::Stats glyph_stats;
+	for (auto &font : loaded_fonts) {
+		const SdlGlyphAtlas::Stats &st = font.second->atlas->stats();
+		glyph_stats.glyphs += st.glyphs;
+		glyph_stats.pages += st.pages;
+		glyph_stats.failed += st.failed;
+	}
+	if (glyph_stats.glyphs > 0)
+		debug_print("glyph atlas: " + std::to_string(loaded_fonts.size()) + " fonts, " + std::to_string(glyph_stats.glyphs) + " glyphs on " +
+			std::to_string(glyph_stats.pages) + " pages, " + std::to_string(glyph_stats.failed) + " missing");
+
+	const SdlImageAtlas::Stats &image_stats = image_atlas->stats();
+	if (image_stats.images > 0)
+		debug_print("image atlas: " + std::to_string(image_stats.images) + " images on " + std::to_string(image_stats.pages) + " pages, " +
+			std::to_string(image_stats.standalone) + " standalone, " + std::to_string(image_stats.hits) + " cache hits");
+
+	if (frame_stats.presented > 0)
+		debug_print("frames: " + std::to_string(frame_stats.presented) + " presented, " + std::to_string(frame_stats.unchanged) + " unchanged, " +
+			std::to_string(frame_stats.repainted_pixels / (int64_t)frame_stats.presented * 100 / ((int64_t)frame_w * frame_h)) + "% of the screen repainted on average");
+
+	const SdlGeometryBatch::Stats &geometry_stats = geometry.stats();
+	if (geometry_stats.batches > 0)
+		debug_print("geometry: " + std::to_string(geometry_stats.batches) + " batches, " +
+			std::to_string(geometry_stats.triangles / geometry_stats.batches) + " triangles per batch on average");
+
+	const SdlTextCache::Stats &text_stats = text_cache.stats();
+	if (text_stats.hits + text_stats.misses > 0)
+		debug_print("text cache: " + std::to_string(text_stats.hits) + " hits, " + std::to_string(text_stats.misses) + " misses, " +
+			std::to_string(text_stats.evictions) + " evictions, " + std::to_string(text_stats.entries) + " entries in " + std::to_string(text_stats.bytes) + " bytes");
+
+	int status = 0;
+	if (!frame_time_samples.empty()) {
+		std::vector<uint32_t> sorted = frame_time_samples;
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&sorted](int p) { return sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)]; };
+		debug_print("frame CPU times: " + std::to_string(sorted.size()) + " frames, p50 " + std::to_string(percentile(50)) + " us, p90 " + std::to_string(percentile(90)) +
+			" us, p99 " + std::to_string(percentile(99)) + " us, max " + std::to_string(sorted.back()) + " us");
+		if (frame_time_limit > 0 && percentile(frame_time_percentile) > frame_time_limit) {
+			debug_print("frame CPU time p" + std::to_string(frame_time_percentile) + " over the limit of " + std::to_string(frame_time_limit) + " us");
+			status = 1;
+		}
+	} else if (frame_time_limit > 0) {
+		debug_print("no frame times to check against the limit");
+		status = 1;
+	}
+
 	on_quit_list.fulfill_all(false);
+	return status;
 }
 
 void SdlPlatform::quit() {
@@ -343,74 +521,289 @@ void SdlPlatform::quit() {
 }
 
 void SdlPlatform::set_color(Color c) {
-	SDL_SetRenderDrawColor(sdlrend, c.R, c.G, c.B, 255);
 	current_color = c;
 }
 
+SdlDisplayList::Command SdlPlatform::make_command(SdlDisplayList::Type type) const {
+	SdlDisplayList::Command cmd {};
+	cmd.type = type;
+	cmd.r = current_color.R;
+	cmd.g = current_color.G;
+	cmd.b = current_color.B;
+	return cmd;
+}
+
+SdlDisplayList::Box SdlPlatform::pixel_box(float x0, float y0, float x1, float y1) const {
+	// Antialiased edges and pixel snapping can reach slightly outside
+	const int margin = 2;
+	float px0 = x0 * s + ox, px1 = x1 * s + ox;
+	float py0 = y0 * s + oy, py1 = y1 * s + oy;
+	return {
+		(int)std::floor(std::min(px0, px1)) - margin,
+		(int)std::floor(std::min(py0, py1)) - margin,
+		(int)std::ceil(std::max(px0, px1)) + margin,
+		(int)std::ceil(std::max(py0, py1)) + margin
+	};
+}
+
 void SdlPlatform::draw_line(float x1, float y1, float x2, float y2) {
-	SDL_RenderDrawLineF(sdlrend, x1 * s + ox, y1 * s + oy, x2 * s + ox, y2 * s + oy);
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::Line);
+	cmd.x = x1;
+	cmd.y = y1;
+	cmd.w = x2;
+	cmd.h = y2;
+	cmd.box = pixel_box(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2));
+	display_lists[current_list].add(std::move(cmd));
 }
 
 void SdlPlatform::draw_rect(float x, float y, float w, float h) {
-	SDL_FRect rect { x * s + ox, y * s + oy, w * s, h * s };
-	SDL_RenderDrawRectF(sdlrend, &rect);
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::Rect);
+	cmd.x = x;
+	cmd.y = y;
+	cmd.w = w;
+	cmd.h = h;
+	cmd.box = pixel_box(x, y, x + w, y + h);
+	display_lists[current_list].add(std::move(cmd));
 }
 
 void SdlPlatform::draw_rect_filled(float x, float y, float w, float h) {
-	SDL_FRect rect { x * s + ox, y * s + oy, w * s, h * s };
-	SDL_RenderFillRectF(sdlrend, &rect);
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::RectFilled);
+	cmd.x = x;
+	cmd.y = y;
+	cmd.w = w;
+	cmd.h = h;
+	cmd.box = pixel_box(x, y, x + w, y + h);
+	display_lists[current_list].add(std::move(cmd));
 }
 
 void SdlPlatform::draw_image(const Image &base, float x, float y) {
-	const SdlImage &img = dynamic_cast<const SdlImage&>(base);
-	auto size = img.size();
-	if (s > 0.0f) {
-		SDL_FRect rect { std::floor(x * s + ox), std::floor(y * s + oy), size.first * s, size.second * s };
-		SDL_RenderCopyF(sdlrend, img.get(), nullptr, &rect);
+	SdlDisplayList::Command cmd;
+	if (const SdlTextImage *text = dynamic_cast<const SdlTextImage*>(&base)) {
+		if (text->get_layout()->quads.empty())
+			return;
+		Color c = text->get_color();
+		cmd = make_command(SdlDisplayList::Type::Text);
+		cmd.r = c.R;
+		cmd.g = c.G;
+		cmd.b = c.B;
+		cmd.text = text->get_layout();
+		cmd.atlas = text->get_font()->atlas.get();
+		cmd.font = text->get_font();
 	} else {
-		SDL_FRect rect { std::floor((x + size.first) * s + ox), std::floor((y + size.second) * s + oy), size.first * -s, size.second * -s };
-		SDL_RenderCopyExF(sdlrend, img.get(), nullptr, &rect, 180.0, nullptr, SDL_FLIP_NONE);
+		cmd = make_command(SdlDisplayList::Type::Image);
+		cmd.image = dynamic_cast<const SdlImage&>(base).get();
 	}
+	auto size = base.size();
+	cmd.x = x;
+	cmd.y = y;
+	cmd.w = size.first;
+	cmd.h = size.second;
+	cmd.box = pixel_box(x, y, x + size.first, y + size.second);
+	display_lists[current_list].add(std::move(cmd));
 }
 
 void SdlPlatform::draw_circle_filled(float x, float y, float r) {
-	Color c = current_color;
-	filledCircleRGBA(sdlrend, x * s + ox, y * s + oy, r * s, c.R, c.G, c.B, 255);
-	aacircleRGBA(sdlrend, x * s + ox, y * s + oy, r * s, c.R, c.G, c.B, 255);
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::Circle);
+	cmd.x = x;
+	cmd.y = y;
+	cmd.w = r;
+	cmd.box = pixel_box(x - r, y - r, x + r, y + r);
+	display_lists[current_list].add(std::move(cmd));
 }
 
 void SdlPlatform::draw_arc_filled(float cx, float cy, float rmin, float rmax, float ang0, float ang1) {
-    const int n = 51;
-    std::vector<std::pair<float, float>> poly;
-    poly.resize(2 * n);
-    for(int i = 0; i < n; i++)
-    {
-        float an = ang0 + (ang1 - ang0) * i / (n - 1);
-        float c = std::cos(an);
-        float s = std::sin(an);
-        poly[i].first = rmin * c + cx;
-        poly[i].second = rmin * s + cy;
-        poly[2 * n - 1 - i].first = rmax * c + cx;
-        poly[2 * n - 1 - i].second = rmax * s + cy;
-    }
-    draw_polygon_filled(poly);
-}
-
-void SdlPlatform::draw_polygon_filled(const std::vector<std::pair<float, float>> &poly) {
-	std::vector<int16_t> sx, sy;
-	sx.reserve(poly.size());
-	sy.reserve(poly.size());
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::Arc);
+	cmd.x = cx;
+	cmd.y = cy;
+	cmd.w = rmin;
+	cmd.h = rmax;
+	cmd.a0 = ang0;
+	cmd.a1 = ang1;
+	float r = std::max(rmin, rmax);
+	cmd.box = pixel_box(cx - r, cy - r, cx + r, cy + r);
+	display_lists[current_list].add(std::move(cmd));
+}
+
+void SdlPlatform::draw_convex_polygon_filled(const std::vector<std::pair<float, float>> &poly) {
+	if (poly.empty())
+		return;
+	SdlDisplayList &list = display_lists[current_list];
+	SdlDisplayList::Command cmd = make_command(SdlDisplayList::Type::Polygon);
+	cmd.first = list.points.size();
+	cmd.count = poly.size();
+	float x0 = poly[0].first, x1 = x0, y0 = poly[0].second, y1 = y0;
 	for (const std::pair<float, float> &v : poly) {
-		sx.push_back(v.first * s + ox);
-		sy.push_back(v.second * s + oy);
+		x0 = std::min(x0, v.first);
+		x1 = std::max(x1, v.first);
+		y0 = std::min(y0, v.second);
+		y1 = std::max(y1, v.second);
 	}
-	Color c = current_color;
-	filledPolygonRGBA(sdlrend, sx.data(), sy.data(), poly.size(), c.R, c.G, c.B, 255);
-	aapolygonRGBA(sdlrend, sx.data(), sy.data(), poly.size(), c.R, c.G, c.B, 255);
+	list.points.insert(list.points.end(), poly.begin(), poly.end());
+	cmd.box = pixel_box(x0, y0, x1, y1);
+	list.add(std::move(cmd));
 }
 
-void SdlPlatform::draw_convex_polygon_filled(const std::vector<std::pair<float, float>> &poly) {
-	draw_polygon_filled(poly);
+void SdlPlatform::render_command(const SdlDisplayList &list, const SdlDisplayList::Command &cmd) {
+	SdlGeometryBatch::Rgba color = { cmd.r, cmd.g, cmd.b, 255 };
+	switch (cmd.type) {
+		case SdlDisplayList::Type::Circle:
+			geometry.circle(cmd.x, cmd.y, cmd.w, color);
+			return;
+		case SdlDisplayList::Type::Arc:
+			geometry.arc(cmd.x, cmd.y, cmd.w, cmd.h, cmd.a0, cmd.a1, color);
+			return;
+		case SdlDisplayList::Type::Polygon:
+			geometry.convex(&list.points[cmd.first], cmd.count, color);
+			return;
+		default:
+			break;
+	}
+	// Anything else is drawn on top of the shapes before it
+	geometry.flush(sdlrend);
+	SDL_SetRenderDrawColor(sdlrend, cmd.r, cmd.g, cmd.b, 255);
+	switch (cmd.type) {
+		case SdlDisplayList::Type::Line:
+			SDL_RenderDrawLineF(sdlrend, cmd.x * s + ox, cmd.y * s + oy, cmd.w * s + ox, cmd.h * s + oy);
+			break;
+		case SdlDisplayList::Type::Rect: {
+			SDL_FRect rect { cmd.x * s + ox, cmd.y * s + oy, cmd.w * s, cmd.h * s };
+			SDL_RenderDrawRectF(sdlrend, &rect);
+			break;
+		}
+		case SdlDisplayList::Type::RectFilled: {
+			SDL_FRect rect { cmd.x * s + ox, cmd.y * s + oy, cmd.w * s, cmd.h * s };
+			SDL_RenderFillRectF(sdlrend, &rect);
+			break;
+		}
+		case SdlDisplayList::Type::Image: {
+			SDL_Rect src { cmd.image.x, cmd.image.y, cmd.image.w, cmd.image.h };
+			if (s > 0.0f) {
+				SDL_FRect rect { std::floor(cmd.x * s + ox), std::floor(cmd.y * s + oy), cmd.w * s, cmd.h * s };
+				SDL_RenderCopyF(sdlrend, cmd.image.tex, &src, &rect);
+			} else {
+				SDL_FRect rect { std::floor((cmd.x + cmd.w) * s + ox), std::floor((cmd.y + cmd.h) * s + oy), cmd.w * -s, cmd.h * -s };
+				SDL_RenderCopyExF(sdlrend, cmd.image.tex, &src, &rect, 180.0, nullptr, SDL_FLIP_NONE);
+			}
+			break;
+		}
+		case SdlDisplayList::Type::Text:
+			render_text(cmd);
+			break;
+		default:
+			break;
+	}
+}
+
+void SdlPlatform::render_text(const SdlDisplayList::Command &cmd) {
+	const std::vector<SdlGlyphAtlas::Quad> &quads = cmd.text->quads;
+	// Same pixel snapping as images. When rotated, positions grow
+	// leftwards and upwards from the bottom-right corner.
+	float dir = s > 0.0f ? 1.0f : -1.0f;
+	float bx = s > 0.0f ? std::floor(cmd.x * s + ox) : std::floor((cmd.x + cmd.w) * s + ox) - cmd.w * s;
+	float by = s > 0.0f ? std::floor(cmd.y * s + oy) : std::floor((cmd.y + cmd.h) * s + oy) - cmd.h * s;
+	SDL_Color color = { cmd.r, cmd.g, cmd.b, 255 };
+	const float inv = 1.0f / SdlGlyphAtlas::PAGE_SIZE;
+	static std::vector<SDL_Vertex> vertices;
+	static std::vector<int> indices;
+	// Glyphs of one string nearly always share a page, so this is a
+	// single draw call
+	int page = quads.front().glyph->page;
+	size_t done = 0;
+	while (done < quads.size()) {
+		vertices.clear();
+		indices.clear();
+		int next_page = -1;
+		for (const SdlGlyphAtlas::Quad &q : quads) {
+			const SdlGlyphAtlas::Glyph &g = *q.glyph;
+			if (g.page != page) {
+				if (g.page > page && (next_page < 0 || g.page < next_page))
+					next_page = g.page;
+				continue;
+			}
+			int base = vertices.size();
+			float x0 = bx + q.x * dir, y0 = by + q.y * dir;
+			float x1 = bx + (q.x + g.w) * dir, y1 = by + (q.y + g.h) * dir;
+			float u0 = g.x * inv, v0 = g.y * inv;
+			float u1 = (g.x + g.w) * inv, v1 = (g.y + g.h) * inv;
+			vertices.push_back({{x0, y0}, color, {u0, v0}});
+			vertices.push_back({{x1, y0}, color, {u1, v0}});
+			vertices.push_back({{x0, y1}, color, {u0, v1}});
+			vertices.push_back({{x1, y1}, color, {u1, v1}});
+			indices.insert(indices.end(), {base, base + 1, base + 2, base + 2, base + 1, base + 3});
+			done++;
+		}
+		SDL_RenderGeometry(sdlrend, cmd.atlas->page(page), vertices.data(), vertices.size(), indices.data(), indices.size());
+		if (next_page < 0)
+			break;
+		page = next_page;
+	}
+}
+
+bool SdlPlatform::render_frame() {
+	SdlDisplayList &list = display_lists[current_list];
+	SdlDisplayList &prev = display_lists[1 - current_list];
+	SdlDisplayList::Box screen { 0, 0, frame_w, frame_h };
+
+	// Without a frame texture, the back buffer is all there is, and it
+	// does not keep its contents after being presented
+	static std::vector<SdlDisplayList::Box> dirty;
+	if (full_redraw || !retained || frame == nullptr) {
+		dirty.assign(1, screen);
+		full_redraw = false;
+	} else {
+		list.diff(prev, dirty, 8);
+	}
+
+	if (!dirty.empty()) {
+		if (frame != nullptr)
+			SDL_SetRenderTarget(sdlrend, frame);
+		for (SdlDisplayList::Box box : dirty) {
+			box = { std::max(box.x0, 0), std::max(box.y0, 0), std::min(box.x1, frame_w), std::min(box.y1, frame_h) };
+			if (box.empty())
+				continue;
+			frame_stats.repainted_pixels += box.area();
+			SDL_Rect clip { box.x0, box.y0, box.x1 - box.x0, box.y1 - box.y0 };
+			SDL_RenderSetClipRect(sdlrend, &clip);
+			SDL_SetRenderDrawColor(sdlrend, 0, 0, 0, 255);
+			SDL_RenderFillRect(sdlrend, &clip);
+			for (const SdlDisplayList::Command &cmd : list.commands) {
+				if (cmd.box.intersects(box))
+					render_command(list, cmd);
+			}
+			geometry.flush(sdlrend);
+		}
+		SDL_RenderSetClipRect(sdlrend, nullptr);
+		if (frame != nullptr) {
+			SDL_SetRenderTarget(sdlrend, nullptr);
+			SDL_RenderCopy(sdlrend, frame, nullptr, nullptr);
+		}
+		SDL_RenderPresent(sdlrend);
+		frame_stats.presented++;
+	} else {
+		frame_stats.unchanged++;
+	}
+
+	prev.clear();
+	current_list = 1 - current_list;
+	return !dirty.empty();
+}
+
+void SdlPlatform::write_snapshot(const std::string &name) {
+	if (frame == nullptr) {
+		debug_print("snapshot " + name + " skipped: no frame texture");
+		return;
+	}
+	std::vector<uint8_t> pixels((size_t)frame_w * frame_h * 3);
+	SDL_SetRenderTarget(sdlrend, frame);
+	int result = SDL_RenderReadPixels(sdlrend, nullptr, SDL_PIXELFORMAT_RGB24, pixels.data(), frame_w * 3);
+	SDL_SetRenderTarget(sdlrend, nullptr);
+	if (result != 0) {
+		debug_print("snapshot " + name + " failed: " + SDL_GetError());
+		return;
+	}
+	std::string path = snapshot_dir + name + ".png";
+	if (!fstream_file_impl.write_file(path, encode_png(pixels.data(), frame_w, frame_h, frame_w * 3)))
+		debug_print("snapshot " + name + " failed: cannot write " + path);
 }
 
 PlatformUtil::Promise<void> SdlPlatform::on_present_request() {
@@ -421,22 +814,50 @@ void SdlPlatform::present() {
 	present_count++;
 }
 
+PlatformUtil::Promise<void> SdlPlatform::on_present_completed() {
+	return on_present_completed_list.create_and_add();
+}
+
+SDL_Surface *SdlPlatform::load_bmp(const std::string_view p) {
+	std::optional<FileView> file = map_file(p);
+	SDL_Surface *surf = file ? SDL_LoadBMP_RW(SDL_RWFromConstMem(file->data(), file->size()), 1) : nullptr;
+	if (surf == nullptr)
+		printf("Error loading BMP %s. SDL Error: %s\n", std::string(p).c_str(), SDL_GetError());
+	return surf;
+}
+
+void SdlPlatform::preload_images(const std::string_view dir) {
+	// Loading every bitmap up front lets them be packed tallest first,
+	// which fills the atlas shelves better than the order of first use
+	std::error_code ec;
+	std::filesystem::path root(assets_dir);
+	std::vector<std::pair<std::string, SDL_Surface*>> surfaces;
+	for (std::filesystem::recursive_directory_iterator it(root / dir, ec), end; !ec && it != end; it.increment(ec)) {
+		if (!it->is_regular_file(ec) || it->path().extension() != ".bmp")
+			continue;
+		std::string path = it->path().lexically_relative(root).generic_string();
+		SDL_Surface *surf = load_bmp(path);
+		if (surf != nullptr)
+			surfaces.push_back({std::move(path), surf});
+	}
+	std::stable_sort(surfaces.begin(), surfaces.end(), [](const auto &a, const auto &b) { return a.second->h > b.second->h; });
+	for (auto &entry : surfaces) {
+		image_atlas->add(entry.first, entry.second);
+		SDL_FreeSurface(entry.second);
+	}
+}
+
 std::unique_ptr<SdlPlatform::Image> SdlPlatform::load_image(const std::string_view p) {
-	std::string path = assets_dir + std::string(p);
-	SDL_Surface *surf = SDL_LoadBMP(path.c_str());
-	if (surf == nullptr) {
-		printf("Error loading BMP %s. SDL Error: %s\n", path.c_str(), SDL_GetError());
-		return nullptr;
+	const SdlImageAtlas::Region *region = image_atlas->find(p);
+	if (region == nullptr) {
+		SDL_Surface *surf = load_bmp(p);
+		region = &image_atlas->add(p, surf);
+		if (surf != nullptr)
+			SDL_FreeSurface(surf);
 	}
-	SDL_Texture *tex = SDL_CreateTextureFromSurface(sdlrend, surf);
-	if (tex == nullptr) {
-		printf("SDL_CreateTextureFromSurface failed: %s\n", SDL_GetError());
-		SDL_FreeSurface(surf);
+	if (region->tex == nullptr)
 		return nullptr;
-	}
-	std::unique_ptr<SdlImage> img = std::make_unique<SdlImage>(tex, surf->w, surf->h, 1.0f);
-	SDL_FreeSurface(surf);
-	return img;
+	return std::make_unique<SdlImage>(*region, 1.0f);
 }
 
 std::unique_ptr<SdlPlatform::Font> SdlPlatform::load_font(float ascent, bool bold, const std::string_view lang) {
@@ -458,22 +879,30 @@ std::unique_ptr<SdlPlatform::Font> SdlPlatform::load_font(float ascent, bool bol
 #if SIMRAIL
 		if (lang == "zh_Hans") {
 			// Simplified Chinese
-			path = assets_dir + (!bold ? "fonts/NotoSansSC-Regular.ttf" : "fonts/NotoSansSC-Bold.ttf");
+			path = !bold ? "fonts/NotoSansSC-Regular.ttf" : "fonts/NotoSansSC-Bold.ttf";
 		}
 		else if (lang == "zh_Hant") {
 			// Traditional  Chinese
-			path = assets_dir + (!bold ? "fonts/NotoSansTC-Regular.ttf" : "fonts/NotoSansTC-Bold.ttf");
+			path = !bold ? "fonts/NotoSansTC-Regular.ttf" : "fonts/NotoSansTC-Bold.ttf";
 		}
 		else {
 			// Other languages
-			path = assets_dir + (!bold ? "fonts/Play-Regular.ttf" : "fonts/Play-Bold.ttf");
+			path = !bold ? "fonts/Play-Regular.ttf" : "fonts/Play-Bold.ttf";
 		}
 #else
-		path = assets_dir + "fonts/" + (!bold ? get_config("font", "swiss.ttf") : get_config("fontBold", "swissb.ttf"));
+		path = "fonts/" + (!bold ? get_config("font", "swiss.ttf") : get_config("fontBold", "swissb.ttf"));
 #endif
 
+		// SDL_ttf reads glyphs lazily, so the mapping is kept alive by the
+		// font wrapper for as long as the font is open.
+		std::optional<FileView> file = map_file(path);
+		if (!file) {
+			debug_print("load_font failed: " + path);
+			return nullptr;
+		}
+
 		float size_probe = ascent * 2.0f * scale;
-		font = TTF_OpenFont(path.c_str(), size_probe);
+		font = TTF_OpenFontRW(SDL_RWFromConstMem(file->data(), file->size()), 1, size_probe);
 		if (font == nullptr) {
 			debug_print("load_font failed: " + path);
 			return nullptr;
@@ -489,42 +918,60 @@ std::unique_ptr<SdlPlatform::Font> SdlPlatform::load_font(float ascent, bool bol
 #endif
 		TTF_CloseFont(font);
 
-		font = TTF_OpenFont(path.c_str(), size_probe * adjust);
+		font = TTF_OpenFontRW(SDL_RWFromConstMem(file->data(), file->size()), 1, size_probe * adjust);
 		if (font == nullptr) {
 			debug_print("load_font failed: " + path);
 			return nullptr;
 		}
 
-		wrapper = std::make_shared<SdlFontWrapper>(font);
+		wrapper = std::make_shared<SdlFontWrapper>(font, *file);
+		wrapper->atlas = std::make_unique<SdlGlyphAtlas>(sdlrend, font);
 		loaded_fonts.insert_or_assign({ascent, bold, lang_str}, wrapper);
 	}
 
 	return std::make_unique<SdlFont>(wrapper, scale);
 }
 
+std::shared_ptr<const SdlTextLayout> SdlPlatform::layout_text(const std::vector<std::string_view> &lines, SdlGlyphAtlas &atlas, float width, int align) {
+	std::shared_ptr<SdlTextLayout> layout = std::make_shared<SdlTextLayout>();
+	std::vector<SdlGlyphAtlas::Quad> &quads = layout->quads;
+	std::vector<std::pair<size_t, float>> line_ends;
+	float max_width = 0;
+	for (size_t i = 0; i < lines.size(); i++) {
+		std::string_view line = lines[i];
+		while (!line.empty() && line.back() == ' ')
+			line.remove_suffix(1);
+		float w = atlas.layout_line(line, 0, i * atlas.line_skip(), quads);
+		line_ends.push_back({quads.size(), w});
+		max_width = std::max(max_width, w);
+	}
+	// As with TTF_RenderUTF8_Blended_Wrapped(), text that had to be
+	// wrapped fills the wrap width, and lines are aligned within it
+	float total_width = width > 0 && lines.size() > 1 ? std::max(width * std::abs(s), max_width) : max_width;
+	size_t begin = 0;
+	for (auto &end : line_ends) {
+		float dx = align == 0 ? std::floor((total_width - end.second) / 2) : (align == 1 ? total_width - end.second : 0);
+		for (size_t i = begin; i < end.first; i++)
+			quads[i].x += dx;
+		begin = end.first;
+	}
+	layout->w = total_width;
+	layout->h = (lines.size() - 1) * atlas.line_skip() + atlas.line_height();
+	return layout;
+}
+
 std::unique_ptr<SdlPlatform::Image> SdlPlatform::make_text_image(const std::string_view text, const Font &base, Color c) {
 	if (text.empty())
 		return nullptr;
 
 	const SdlFont &font = dynamic_cast<const SdlFont&>(base);
-
-	SDL_Color color = { c.R, c.G, c.B };
-	SDL_Surface *surf = TTF_RenderUTF8_Blended(font.get(), std::string(text).c_str(), color);
-	if (surf == nullptr) {
-		printf("TTF render failed\n");
-		return nullptr;
+	const std::shared_ptr<SdlFontWrapper> &wrapper = font.get_wrapper();
+	std::shared_ptr<const SdlTextLayout> layout = text_cache.find(wrapper.get(), text, 0, -1);
+	if (!layout) {
+		layout = layout_text({text}, *wrapper->atlas, 0, -1);
+		text_cache.insert(wrapper, text, 0, -1, layout);
 	}
-
-	SDL_Texture *tex = SDL_CreateTextureFromSurface(sdlrend, surf);
-	if (tex == nullptr) {
-		printf("SDL_CreateTextureFromSurface failed: %s\n", SDL_GetError());
-		SDL_FreeSurface(surf);
-		return nullptr;
-	}
-
-	std::unique_ptr<SdlImage> img = std::make_unique<SdlImage>(tex, surf->w, surf->h, std::abs(s));
-	SDL_FreeSurface(surf);
-	return img;
+	return std::make_unique<SdlTextImage>(wrapper, std::move(layout), c, std::abs(s));
 }
 
 std::unique_ptr<SdlPlatform::Image> SdlPlatform::make_wrapped_text_image(const std::string_view text, const Font &base, float width, int align, Color c) {
@@ -532,46 +979,52 @@ std::unique_ptr<SdlPlatform::Image> SdlPlatform::make_wrapped_text_image(const s
 		return nullptr;
 
 	const SdlFont &font = dynamic_cast<const SdlFont&>(base);
-
-	TTF_SetFontWrappedAlign(font.get(), align == 0 ? TTF_WRAPPED_ALIGN_CENTER : (align == 1 ? TTF_WRAPPED_ALIGN_RIGHT : TTF_WRAPPED_ALIGN_LEFT));
-
-	//if (aspect & 2) TTF_SetFontStyle(font, TTF_STYLE_UNDERLINE);
-	SDL_Color color = { c.R, c.G, c.B };
-	SDL_Surface *surf = TTF_RenderUTF8_Blended_Wrapped(font.get(), std::string(text).c_str(), color, width * std::abs(s));
-	if (surf == nullptr) {
-		printf("TTF render failed\n");
-		return nullptr;
-	}
-
-	SDL_Texture *tex = SDL_CreateTextureFromSurface(sdlrend, surf);
-	if (tex == nullptr) {
-		printf("SDL_CreateTextureFromSurface failed: %s\n", SDL_GetError());
-		SDL_FreeSurface(surf);
-		return nullptr;
+	const std::shared_ptr<SdlFontWrapper> &wrapper = font.get_wrapper();
+	std::shared_ptr<const SdlTextLayout> layout = text_cache.find(wrapper.get(), text, width, align);
+	if (!layout) {
+		std::vector<std::string_view> lines;
+		size_t start = 0;
+		for (;;) {
+			size_t newline = text.find('\n', start);
+			std::string_view paragraph = text.substr(start, newline == std::string_view::npos ? std::string_view::npos : newline - start);
+			if (width > 0 && !paragraph.empty()) {
+				size_t pos = 0;
+				while (pos < paragraph.size()) {
+					size_t p = font.calc_wrap_point(paragraph.substr(pos), width);
+					lines.push_back(paragraph.substr(pos, p));
+					pos += p;
+				}
+			} else {
+				lines.push_back(paragraph);
+			}
+			if (newline == std::string_view::npos)
+				break;
+			start = newline + 1;
+		}
+		layout = layout_text(lines, *wrapper->atlas, width, align);
+		text_cache.insert(wrapper, text, width, align, layout);
 	}
-
-	std::unique_ptr<SdlImage> img = std::make_unique<SdlImage>(tex, surf->w, surf->h, std::abs(s));
-	SDL_FreeSurface(surf);
-	return img;
+	return std::make_unique<SdlTextImage>(wrapper, std::move(layout), c, std::abs(s));
 }
 
-SdlPlatform::SdlImage::SdlImage(SDL_Texture *tex, float w, float h, float s) : tex(tex), w(w), h(h), scale(s) {
+SdlPlatform::SdlImage::SdlImage(const SdlImageAtlas::Region &region, float s) : region(region), scale(s) {
 
 }
 
-SdlPlatform::SdlImage::~SdlImage() {
-	SDL_DestroyTexture(tex);
+std::pair<float, float> SdlPlatform::SdlImage::size() const {
+	return std::make_pair(region.w / scale, region.h / scale);
 }
 
-SDL_Texture* SdlPlatform::SdlImage::get() const {
-	return tex;
+SdlPlatform::SdlTextImage::SdlTextImage(std::shared_ptr<SdlFontWrapper> font, std::shared_ptr<const SdlTextLayout> layout, Color c, float s) :
+	font(std::move(font)), layout(std::move(layout)), color(c), scale(s) {
+
 }
 
-std::pair<float, float> SdlPlatform::SdlImage::size() const {
-	return std::make_pair(w / scale, h / scale);
+std::pair<float, float> SdlPlatform::SdlTextImage::size() const {
+	return std::make_pair(layout->w / scale, layout->h / scale);
 }
 
-SdlPlatform::SdlFontWrapper::SdlFontWrapper(TTF_Font *f) : font(f) {
+SdlPlatform::SdlFontWrapper::SdlFontWrapper(TTF_Font *f, const FileView &file) : font(f), file(file) {
 
 }
 
@@ -692,12 +1145,14 @@ int SdlPlatform::get_volume() {
 }
 
 std::unique_ptr<SdlPlatform::SoundData> SdlPlatform::load_sound(const std::string_view path) {
-	std::string file = assets_dir + "sound/" + std::string(path) + ".wav";
+	std::optional<FileView> file = map_file("sound/" + std::string(path) + ".wav");
+	if (!file)
+		return nullptr;
 
 	SDL_AudioSpec spec;
 	uint8_t* buffer;
 	uint32_t len;
-	if (!SDL_LoadWAV(file.c_str(), &spec, &buffer, &len))
+	if (!SDL_LoadWAV_RW(SDL_RWFromConstMem(file->data(), file->size()), 1, &spec, &buffer, &len))
 		return nullptr;
 
 	SDL_AudioCVT cvt;
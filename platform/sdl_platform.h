@@ -8,27 +8,42 @@
 
 #include <map>
 #include <atomic>
+#include <deque>
 #include <optional>
 #include <functional>
 #include "platform.h"
 #include "bus_socket_impl.h"
 #include "libc_time_impl.h"
 #include "fstream_file_impl.h"
-#include "console_fd_poller.h"
+#include "mmap_file_impl.h"
+#include "async_file_writer.h"
+#include "timer_wheel.h"
+#include "epoll_fd_poller.h"
+#include "sdl_display_list.h"
+#include "sdl_geometry.h"
+#include "sdl_glyph_atlas.h"
+#include "sdl_image_atlas.h"
+#include "sdl_text_cache.h"
 
 struct SDL_Renderer;
+struct SDL_Surface;
 struct SDL_Texture;
 struct SDL_Window;
 struct _TTF_Font;
 typedef struct _TTF_Font TTF_Font;
 
 class SdlPlatform final : public UiPlatform {
+public:
+	class SdlTextImage;
+
 private:
 	struct SdlFontWrapper
 	{
 		TTF_Font* font;
+		FileView file;
+		std::unique_ptr<SdlGlyphAtlas> atlas;
 
-		SdlFontWrapper(TTF_Font *f);
+		SdlFontWrapper(TTF_Font *f, const FileView &file);
 		~SdlFontWrapper();
 	};
 
@@ -47,7 +62,7 @@ private:
 		std::atomic<bool> stop;
 	};
 
-	ConsoleFdPoller poller;
+	DefaultFdPoller poller;
 
 	SDL_Renderer *sdlrend;
 	SDL_Window *sdlwindow;
@@ -59,11 +74,13 @@ private:
 	int audio_device;
 	int audio_volume;
 	std::map<std::tuple<float, bool, std::string>, std::shared_ptr<SdlFontWrapper>> loaded_fonts;
+	std::unique_ptr<SdlImageAtlas> image_atlas;
 	float s, ox, oy;
-	std::multimap<int64_t, PlatformUtil::Fulfiller<void>> timer_queue;
+	TimerWheel timers;
 	PlatformUtil::FulfillerList<void> on_close_list;
 	PlatformUtil::FulfillerList<void> on_quit_list;
 	PlatformUtil::FulfillerList<void> on_present_list;
+	PlatformUtil::FulfillerList<void> on_present_completed_list;
 	PlatformUtil::FulfillerList<InputEvent> on_input_list;
 	int present_count;
 	bool running;
@@ -74,25 +91,86 @@ private:
 	BusSocketImpl bus_socket_impl;
 	LibcTimeImpl libc_time_impl;
 	FstreamFileImpl fstream_file_impl;
-	std::vector<std::unique_ptr<PlatformUtil::TypeErasedFulfiller>> event_list;
+	MmapFileImpl mmap_file_impl;
+	AsyncFileWriter file_writer;
+	PlatformUtil::DeferredQueue event_list;
 
 	std::vector<std::shared_ptr<PlaybackState>> playback_list;
 	static void mixer_func_proxy(void *ptr, unsigned char *stream, int len);
 	void mixer_func(int16_t *buffer, size_t len);
 	bool poll_sdl();
-	void draw_polygon_filled(const std::vector<std::pair<float, float>> &poly);
+
+	// Draw calls are recorded, and at present only the areas where they
+	// differ from the previous frame are drawn again into frame, which
+	// keeps the picture between frames
+	struct FrameStats {
+		uint64_t presented = 0;
+		uint64_t unchanged = 0;
+		int64_t repainted_pixels = 0;
+	};
+	SdlDisplayList display_lists[2];
+	int current_list;
+	SDL_Texture *frame;
+	int frame_w, frame_h;
+	bool retained;
+	bool full_redraw;
+	int64_t idle_frame_interval;
+	int64_t next_present_time;
+	FrameStats frame_stats;
+	// Arcs, circles and polygons between other draw calls, drawn together
+	SdlGeometryBatch geometry;
+	SdlDisplayList::Command make_command(SdlDisplayList::Type type) const;
+	SdlDisplayList::Box pixel_box(float x0, float y0, float x1, float y1) const;
+	void render_command(const SdlDisplayList &list, const SdlDisplayList::Command &cmd);
+	void render_text(const SdlDisplayList::Command &cmd);
+	bool render_frame();
+	// Without a display, driven by a bus replay: snapshots of the frame
+	// are written when the replay reaches a marker, and the CPU time taken
+	// by each frame is kept for the statistics printed at exit. With a
+	// limit, event_loop() fails if the given percentile goes over it.
+	bool headless;
+	bool pending_quit;
+	std::string snapshot_dir;
+	std::deque<std::string> pending_snapshots;
+	bool frame_times;
+	std::vector<uint32_t> frame_time_samples;
+	int frame_time_percentile;
+	int64_t frame_time_limit;
+	void write_snapshot(const std::string &name);
+	SDL_Surface *load_bmp(const std::string_view path);
+	void preload_images(const std::string_view dir);
+	SdlTextCache text_cache;
+	std::shared_ptr<const SdlTextLayout> layout_text(const std::vector<std::string_view> &lines, SdlGlyphAtlas &atlas, float width, int align);
 
 public:
+	// Region of a texture owned by the image atlas
 	class SdlImage final : public Image
 	{
 	private:
-		SDL_Texture* tex;
-		float w, h, scale;
+		SdlImageAtlas::Region region;
+		float scale;
+
+	public:
+		SdlImage(const SdlImageAtlas::Region &region, float s);
+		const SdlImageAtlas::Region &get() const { return region; }
+		std::pair<float, float> size() const override;
+	};
+
+	// Text laid out on the glyph atlas of its font. Drawing it only
+	// submits quads, no texture is created for it.
+	class SdlTextImage final : public Image
+	{
+	private:
+		std::shared_ptr<SdlFontWrapper> font;
+		std::shared_ptr<const SdlTextLayout> layout;
+		Color color;
+		float scale;
 
 	public:
-		SdlImage(SDL_Texture *tex, float w, float h, float s);
-		SDL_Texture* get() const;
-		~SdlImage() override;
+		SdlTextImage(std::shared_ptr<SdlFontWrapper> font, std::shared_ptr<const SdlTextLayout> layout, Color c, float s);
+		const std::shared_ptr<SdlFontWrapper> &get_font() const { return font; }
+		const std::shared_ptr<const SdlTextLayout> &get_layout() const { return layout; }
+		Color get_color() const { return color; }
 		std::pair<float, float> size() const override;
 	};
 
@@ -104,6 +182,7 @@ public:
 	public:
 		SdlFont(std::shared_ptr<SdlFontWrapper> wrapper, float scale);
 		TTF_Font* get() const;
+		const std::shared_ptr<SdlFontWrapper> &get_wrapper() const { return font; }
 		std::pair<float, float> calc_size(const std::string_view str, float wrap_width = 0.0f) const override;
 		size_t calc_wrap_point(const std::string_view str, float wrap_width) const override;
 	};
@@ -128,7 +207,8 @@ public:
 	};
 
 	SdlPlatform(float virtual_w, float virtual_h, const std::vector<std::string> &args);
-	void event_loop();
+	// Returns the exit status of the program
+	int event_loop();
 
 	~SdlPlatform() override;
 
@@ -136,7 +216,11 @@ public:
 
 	std::unique_ptr<BusSocket> open_socket(const std::string_view channel, uint32_t tid) override;
 	std::optional<std::string> read_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE) override;
+	std::optional<FileView> map_file(const std::string_view path, FileType file_type=ETCS_ASSET_FILE) override;
 	bool write_file(const std::string_view path, const std::string_view contents) override;
+	PlatformUtil::Promise<bool> write_file_async(const std::string_view path, std::string &&contents) override;
+	std::optional<FileWriteStats> file_write_stats() override;
+	std::optional<TimerStats> timer_stats() override;
 	void debug_print(const std::string_view msg) override;
 
 	PlatformUtil::Promise<void> delay(int ms) override;
@@ -155,6 +239,7 @@ public:
 	void draw_convex_polygon_filled(const std::vector<std::pair<float, float>> &poly) override;
 	PlatformUtil::Promise<void> on_present_request() override;
 	void present() override;
+	PlatformUtil::Promise<void> on_present_completed() override;
 	std::unique_ptr<Image> load_image(const std::string_view path) override;
 	std::unique_ptr<Font> load_font(float size, bool bold, const std::string_view lang) override;
 	std::unique_ptr<Image> make_text_image(const std::string_view text, const Font &font, Color c) override;
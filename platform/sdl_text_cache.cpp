@@ -0,0 +1,76 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "sdl_text_cache.h"
+#include <functional>
+
+// Rough per-entry cost besides the text and quads: list node, index
+// node and layout control block
+static constexpr size_t ENTRY_OVERHEAD = 160;
+
+SdlTextCache::SdlTextCache(size_t budget_bytes) : budget(budget_bytes) {
+}
+
+size_t SdlTextCache::hash_of(const void *font, const std::string_view text, float width, int align) {
+	size_t h = std::hash<std::string_view>()(text);
+	h ^= std::hash<const void*>()(font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= std::hash<float>()(width) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= std::hash<int>()(align) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	return h;
+}
+
+std::shared_ptr<const SdlTextLayout> SdlTextCache::find(const void *font, const std::string_view text, float width, int align) {
+	auto it = index.find(hash_of(font, text, width, align));
+	if (it == index.end() || it->second->font.get() != font || it->second->text != text ||
+		it->second->width != width || it->second->align != align) {
+		counters.misses++;
+		return nullptr;
+	}
+	counters.hits++;
+	entries.splice(entries.begin(), entries, it->second);
+	return it->second->layout;
+}
+
+void SdlTextCache::erase(std::list<Entry>::iterator it) {
+	counters.bytes -= it->bytes;
+	counters.entries--;
+	index.erase(it->hash);
+	entries.erase(it);
+}
+
+void SdlTextCache::insert(std::shared_ptr<const void> font, const std::string_view text, float width, int align, std::shared_ptr<const SdlTextLayout> layout) {
+	size_t hash = hash_of(font.get(), text, width, align);
+	auto it = index.find(hash);
+	// A colliding entry is replaced
+	if (it != index.end())
+		erase(it->second);
+	size_t bytes = text.size() + layout->quads.size() * sizeof(SdlGlyphAtlas::Quad) + ENTRY_OVERHEAD;
+	if (bytes > budget)
+		return;
+	while (counters.bytes + bytes > budget && !entries.empty()) {
+		erase(std::prev(entries.end()));
+		counters.evictions++;
+	}
+	entries.push_front({hash, std::move(font), std::string(text), width, align, std::move(layout), bytes});
+	index[hash] = entries.begin();
+	counters.bytes += bytes;
+	counters.entries++;
+}
+
+void SdlTextCache::set_budget(size_t budget_bytes) {
+	budget = budget_bytes;
+	while (counters.bytes > budget && !entries.empty()) {
+		erase(std::prev(entries.end()));
+		counters.evictions++;
+	}
+}
+
+void SdlTextCache::clear() {
+	entries.clear();
+	index.clear();
+	counters.bytes = 0;
+	counters.entries = 0;
+}
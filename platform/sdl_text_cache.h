@@ -0,0 +1,64 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "sdl_glyph_atlas.h"
+
+// Glyph quads of a string laid out with one font, in pixels
+struct SdlTextLayout {
+	std::vector<SdlGlyphAtlas::Quad> quads;
+	float w, h;
+};
+
+// Least recently used layouts, so that labels drawn every frame are not
+// laid out again. Colour is applied when drawing, so one entry serves a
+// string in every colour. The owner of a font is kept alive by the
+// entries that use it, as their quads point into its atlas.
+class SdlTextCache {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+	};
+
+private:
+	struct Entry {
+		size_t hash;
+		std::shared_ptr<const void> font;
+		std::string text;
+		float width;
+		int align;
+		std::shared_ptr<const SdlTextLayout> layout;
+		size_t bytes;
+	};
+
+	std::list<Entry> entries;
+	std::unordered_map<size_t, std::list<Entry>::iterator> index;
+	size_t budget;
+	Stats counters;
+
+	static size_t hash_of(const void *font, const std::string_view text, float width, int align);
+	void erase(std::list<Entry>::iterator it);
+
+public:
+	explicit SdlTextCache(size_t budget_bytes);
+
+	// Null on a miss. width is 0 and align -1 for text that is not wrapped.
+	std::shared_ptr<const SdlTextLayout> find(const void *font, const std::string_view text, float width, int align);
+	void insert(std::shared_ptr<const void> font, const std::string_view text, float width, int align, std::shared_ptr<const SdlTextLayout> layout);
+	void set_budget(size_t budget_bytes);
+	void clear();
+	const Stats &stats() const { return counters; }
+};
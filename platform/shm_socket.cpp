@@ -0,0 +1,417 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "shm_socket.h"
+
+#ifdef PLATFORM_HAS_SHM_SOCKET
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#define SHM_MAGIC 0x45544353
+#define SHM_RING_SIZE (256 * 1024)
+// Largest chunk handed to a single receive() fulfilment
+#define SHM_READ_CHUNK 65536
+
+// Positions are running byte counts, so head == tail means empty and
+// head - tail == SHM_RING_SIZE means full. Each counter is only ever
+// stored by one side and lives in its own cache line.
+struct ShmSocket::Ring
+{
+	alignas(64) std::atomic<uint64_t> head;
+	alignas(64) std::atomic<uint64_t> tail;
+	alignas(64) std::atomic<uint32_t> consumer_waiting;
+	std::atomic<uint32_t> producer_waiting;
+	alignas(64) char data[SHM_RING_SIZE];
+};
+
+struct ShmSocket::Shared
+{
+	uint32_t magic;
+	uint32_t ring_size;
+	// Client to server, then server to client
+	Ring rings[2];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory rings need lock-free atomics");
+
+static socklen_t shm_address(const std::string_view name, sockaddr_un &addr) {
+	addr = {};
+	addr.sun_family = AF_UNIX;
+	// Abstract namespace, so that no socket file is left behind
+	std::string path = "etcs-bus-" + std::string(name);
+	size_t n = std::min(path.size(), sizeof(addr.sun_path) - 1);
+	memcpy(addr.sun_path + 1, path.data(), n);
+	return offsetof(sockaddr_un, sun_path) + 1 + n;
+}
+
+static void mark_nonblocking(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void ShmSocket::signal_peer() {
+	uint64_t one = 1;
+	ssize_t ret = write(peer_wake_fd, &one, sizeof(one));
+	(void)ret;
+}
+
+size_t ShmSocket::write_ring(const std::string_view data) {
+	uint64_t head = tx_ring->head.load(std::memory_order_relaxed);
+	uint64_t tail = tx_ring->tail.load(std::memory_order_acquire);
+	size_t n = std::min<size_t>(SHM_RING_SIZE - (head - tail), data.size());
+	if (n == 0)
+		return 0;
+	size_t pos = head % SHM_RING_SIZE;
+	size_t first = std::min<size_t>(n, SHM_RING_SIZE - pos);
+	memcpy(tx_ring->data + pos, data.data(), first);
+	memcpy(tx_ring->data, data.data() + first, n - first);
+	tx_ring->head.store(head + n, std::memory_order_release);
+	// Pairs with the fence in update(): either the consumer sees the new
+	// head, or we see its waiting flag and wake it up
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (tx_ring->consumer_waiting.exchange(0))
+		signal_peer();
+	return n;
+}
+
+void ShmSocket::close_socket() {
+	if (ctrl_fd == -1)
+		return;
+	wake_promise = {};
+	ctrl_promise = {};
+	rx_list.push_data({});
+	poller.forget_fd(ctrl_fd);
+	close(ctrl_fd);
+	ctrl_fd = -1;
+	if (wake_fd != -1) {
+		poller.forget_fd(wake_fd);
+		close(wake_fd);
+		wake_fd = -1;
+	}
+	if (peer_wake_fd != -1) {
+		close(peer_wake_fd);
+		peer_wake_fd = -1;
+	}
+	if (shared != nullptr) {
+		munmap(shared, sizeof(Shared));
+		shared = nullptr;
+	}
+	rx_ring = tx_ring = nullptr;
+	tx_backlog.clear();
+	tx_latency.discard();
+	update_congestion(0);
+}
+
+void ShmSocket::ctrl_ready(short rev) {
+	char c;
+	ssize_t ret = recv(ctrl_fd, &c, 1, 0);
+	if ((rev & POLLERR) || ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		// Whatever the peer wrote before leaving is still delivered
+		peer_closed = true;
+		ctrl_promise = {};
+		update();
+		return;
+	}
+	ctrl_promise = poller.on_fd_ready(ctrl_fd, POLLIN).then([this](short rev) { ctrl_ready(rev); });
+}
+
+void ShmSocket::update() {
+	while (ctrl_fd != -1) {
+		if (!tx_backlog.empty()) {
+			size_t n = write_ring(tx_backlog);
+			tx_backlog.erase(0, n);
+			tx_latency.written(n);
+			update_congestion(tx_backlog.size());
+		}
+
+		uint64_t tail = rx_ring->tail.load(std::memory_order_relaxed);
+		uint64_t head = rx_ring->head.load(std::memory_order_acquire);
+		while (head != tail && rx_list.pending_fulfillers() > 0) {
+			size_t n = std::min<size_t>(head - tail, SHM_READ_CHUNK);
+			size_t pos = tail % SHM_RING_SIZE;
+			size_t first = std::min<size_t>(n, SHM_RING_SIZE - pos);
+			std::string buf;
+			buf.resize(n);
+			memcpy(buf.data(), rx_ring->data + pos, first);
+			memcpy(buf.data() + first, rx_ring->data, n - first);
+			tail += n;
+			rx_ring->tail.store(tail, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (rx_ring->producer_waiting.exchange(0))
+				signal_peer();
+			rx_list.push_data(std::move(buf));
+			head = rx_ring->head.load(std::memory_order_acquire);
+		}
+
+		if (peer_closed && head == tail) {
+			close_socket();
+			return;
+		}
+
+		bool want_rx = head == tail && rx_list.pending_fulfillers() > 0;
+		bool want_tx = !tx_backlog.empty();
+		if (!want_rx && !want_tx)
+			return;
+		if (want_rx)
+			rx_ring->consumer_waiting.store(1);
+		if (want_tx)
+			tx_ring->producer_waiting.store(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		// The peer may have moved before it could see the flags
+		if (want_rx && rx_ring->head.load(std::memory_order_acquire) != tail)
+			continue;
+		if (want_tx && tx_ring->head.load(std::memory_order_relaxed) - tx_ring->tail.load(std::memory_order_acquire) < SHM_RING_SIZE)
+			continue;
+
+		if (!wake_pending) {
+			wake_pending = true;
+			wake_promise = poller.on_fd_ready(wake_fd, POLLIN).then([this](short rev) {
+				wake_pending = false;
+				uint64_t count;
+				ssize_t ret = read(wake_fd, &count, sizeof(count));
+				(void)ret;
+				update();
+			});
+		}
+		return;
+	}
+}
+
+bool ShmSocket::attach(int ctrl, int mem_fd, int wake, int peer_wake, bool server) {
+	ctrl_fd = ctrl;
+	wake_fd = wake;
+	peer_wake_fd = peer_wake;
+	mark_nonblocking(ctrl_fd);
+	mark_nonblocking(wake_fd);
+
+	struct stat st;
+	void *mem = MAP_FAILED;
+	if (fstat(mem_fd, &st) == 0 && (size_t)st.st_size == sizeof(Shared))
+		mem = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+	if (mem == MAP_FAILED)
+		return false;
+	shared = static_cast<Shared*>(mem);
+
+	if (!server) {
+		new (shared) Shared();
+		shared->magic = SHM_MAGIC;
+		shared->ring_size = SHM_RING_SIZE;
+	} else if (shared->magic != SHM_MAGIC || shared->ring_size != SHM_RING_SIZE) {
+		return false;
+	}
+	rx_ring = &shared->rings[server ? 0 : 1];
+	tx_ring = &shared->rings[server ? 1 : 0];
+
+	ctrl_promise = poller.on_fd_ready(ctrl_fd, POLLIN).then([this](short rev) { ctrl_ready(rev); });
+	return true;
+}
+
+void ShmSocket::send(const std::string_view data) {
+	if (ctrl_fd == -1 || peer_closed || data.empty())
+		return;
+	tx_latency.queued(data.size());
+	if (!tx_backlog.empty()) {
+		tx_backlog += data;
+		update_congestion(tx_backlog.size());
+		return;
+	}
+	size_t n = write_ring(data);
+	tx_latency.written(n);
+	if (n < data.size()) {
+		tx_backlog.assign(data.substr(n));
+		update_congestion(tx_backlog.size());
+		update();
+	}
+}
+
+void ShmSocket::send(Frame frame) {
+	if (frame)
+		send(std::string_view(*frame));
+}
+
+PlatformUtil::Promise<std::string> ShmSocket::receive() {
+	PlatformUtil::Promise<std::string> promise = rx_list.create_and_add();
+	update();
+	return promise;
+}
+
+size_t ShmSocket::queued_bytes() const {
+	if (tx_ring == nullptr)
+		return 0;
+	return tx_backlog.size() + (tx_ring->head.load(std::memory_order_relaxed) - tx_ring->tail.load(std::memory_order_relaxed));
+}
+
+ShmSocket::ShmSocket(FdPoller &p) : ctrl_fd(-1), wake_fd(-1), peer_wake_fd(-1), shared(nullptr), rx_ring(nullptr), tx_ring(nullptr), wake_pending(false), peer_closed(false), poller(p) {
+}
+
+ShmSocket::ShmSocket(const std::string_view name, FdPoller &p) : ShmSocket(p) {
+	sockaddr_un addr;
+	socklen_t len = shm_address(name, addr);
+	int ctrl = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	int mem_fd = memfd_create("etcs-bus", MFD_CLOEXEC);
+	int wake = eventfd(0, EFD_CLOEXEC);
+	int peer_wake = eventfd(0, EFD_CLOEXEC);
+	// The connection is local, so a blocking connect returns immediately
+	bool ok = ctrl >= 0 && mem_fd >= 0 && wake >= 0 && peer_wake >= 0
+		&& ::connect(ctrl, (sockaddr*)&addr, len) == 0
+		&& ftruncate(mem_fd, sizeof(Shared)) == 0;
+	if (!ok) {
+		for (int fd : { ctrl, mem_fd, wake, peer_wake }) {
+			if (fd >= 0)
+				close(fd);
+		}
+		rx_list.push_data({});
+		return;
+	}
+
+	// The block must be initialised before the server can map it
+	if (!attach(ctrl, mem_fd, wake, peer_wake, false)) {
+		close(mem_fd);
+		close_socket();
+		return;
+	}
+
+	// Sent in the order the server expects: memory, its own eventfd, ours
+	int fds[3] = { mem_fd, peer_wake, wake };
+	char cbuf[CMSG_SPACE(sizeof(fds))] = {};
+	char byte = 0;
+	iovec iov = { &byte, 1 };
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	ssize_t ret = sendmsg(ctrl_fd, &msg, MSG_NOSIGNAL);
+	close(mem_fd);
+	if (ret != 1)
+		close_socket();
+}
+
+ShmSocket::~ShmSocket() {
+	close_socket();
+}
+
+void ShmListener::close_socket() {
+	for (auto &h : handshakes) {
+		h.second = {};
+		poller.forget_fd(h.first);
+		close(h.first);
+	}
+	handshakes.clear();
+	if (listen_fd == -1)
+		return;
+	promise = {};
+	poller.forget_fd(listen_fd);
+	close(listen_fd);
+	listen_fd = -1;
+}
+
+void ShmListener::fd_ready(short rev) {
+	if (rev & (POLLERR | POLLHUP)) {
+		close_socket();
+		return;
+	}
+	if (rev & POLLIN) {
+		int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd >= 0) {
+			// Only peers running as the same user may share our memory
+			ucred cred;
+			socklen_t len = sizeof(cred);
+			if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == geteuid())
+				handshakes.emplace_back(fd, poller.on_fd_ready(fd, POLLIN).then([this, fd](short rev) { handshake_ready(fd, rev); }));
+			else
+				close(fd);
+		} else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+			close_socket();
+		}
+	}
+	if (listen_fd != -1)
+		promise = poller.on_fd_ready(listen_fd, POLLIN).then([this](short rev) { fd_ready(rev); });
+}
+
+void ShmListener::handshake_ready(int fd, short rev) {
+	auto it = std::find_if(handshakes.begin(), handshakes.end(), [fd](const auto &h) { return h.first == fd; });
+	if (it == handshakes.end())
+		return;
+
+	char byte;
+	iovec iov = { &byte, 1 };
+	char cbuf[CMSG_SPACE(3 * sizeof(int))];
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	ssize_t ret = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && !(rev & (POLLERR | POLLHUP))) {
+		it->second = poller.on_fd_ready(fd, POLLIN).then([this, fd](short rev) { handshake_ready(fd, rev); });
+		return;
+	}
+	handshakes.erase(it);
+
+	std::vector<int> fds;
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); ret > 0 && cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		size_t start = fds.size();
+		fds.resize(start + count);
+		memcpy(fds.data() + start, CMSG_DATA(cmsg), count * sizeof(int));
+	}
+	if (ret != 1 || fds.size() != 3 || (msg.msg_flags & MSG_CTRUNC)) {
+		for (int f : fds)
+			close(f);
+		poller.forget_fd(fd);
+		close(fd);
+		return;
+	}
+
+	poller.forget_fd(fd);
+	std::unique_ptr<ShmSocket> sock(new ShmSocket(poller));
+	bool ok = sock->attach(fd, fds[0], fds[1], fds[2], true);
+	close(fds[0]);
+	if (ok)
+		list.push_data(std::move(sock));
+}
+
+ShmListener::ShmListener(const std::string_view name, FdPoller &p) : poller(p) {
+	sockaddr_un addr;
+	socklen_t len = shm_address(name, addr);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd < 0)
+		return;
+	if (bind(listen_fd, (sockaddr*)&addr, len) < 0 || listen(listen_fd, 10) < 0) {
+		close(listen_fd);
+		listen_fd = -1;
+		return;
+	}
+	promise = poller.on_fd_ready(listen_fd, POLLIN).then([this](short rev) { fd_ready(rev); });
+}
+
+ShmListener::~ShmListener() {
+	close_socket();
+}
+
+PlatformUtil::Promise<std::unique_ptr<StreamSocket>> ShmListener::accept() {
+	return list.create_and_add();
+}
+#endif
@@ -0,0 +1,83 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include "tcp_socket.h"
+
+// memfd_create is only available from Android API level 30
+#if defined(__linux__) && !defined(__ANDROID__)
+#define PLATFORM_HAS_SHM_SOCKET
+
+// Byte stream between two processes on the same host, carried by a pair
+// of single-producer/single-consumer rings in a shared memory block.
+// A peer sleeping on an empty (or full) ring is woken through its eventfd,
+// so a steady stream needs no system calls at all. The client creates the
+// block and the eventfds and passes them over a unix socket, which then
+// stays open only so that each side notices when the other one goes away.
+// Only data that did not fit in the ring counts towards the high-water mark.
+class ShmSocket final : public StreamSocket
+{
+private:
+	struct Ring;
+	struct Shared;
+
+	int ctrl_fd;
+	int wake_fd;
+	int peer_wake_fd;
+	Shared *shared;
+	Ring *rx_ring;
+	Ring *tx_ring;
+	PlatformUtil::FulfillerBufferedQueue<std::string> rx_list;
+	std::string tx_backlog;
+	SendLatency tx_latency;
+	PlatformUtil::Promise<short> wake_promise;
+	PlatformUtil::Promise<short> ctrl_promise;
+	bool wake_pending, peer_closed;
+	FdPoller& poller;
+
+	size_t write_ring(const std::string_view data);
+	void signal_peer();
+	void close_socket();
+	void ctrl_ready(short rev);
+	void update();
+
+	ShmSocket(FdPoller &p);
+	bool attach(int ctrl, int mem_fd, int wake, int peer_wake, bool server);
+
+	friend class ShmListener;
+public:
+	// Connects to the listener with the given name. Failure to connect is
+	// reported like a closed connection, through receive().
+	ShmSocket(const std::string_view name, FdPoller &p);
+	~ShmSocket() override;
+	void send(const std::string_view data) override;
+	void send(Frame frame) override;
+	PlatformUtil::Promise<std::string> receive() override;
+	size_t queued_bytes() const override;
+	const Log2Histogram &send_latency() const override { return tx_latency.histogram(); }
+};
+
+class ShmListener : private PlatformUtil::NoCopy
+{
+private:
+	int listen_fd;
+	PlatformUtil::FulfillerBufferedQueue<std::unique_ptr<StreamSocket>> list;
+	PlatformUtil::Promise<short> promise;
+	// Connections whose shared memory block has not arrived yet
+	std::vector<std::pair<int, PlatformUtil::Promise<short>>> handshakes;
+	FdPoller& poller;
+
+	void close_socket();
+	void fd_ready(short rev);
+	void handshake_ready(int fd, short rev);
+
+public:
+	ShmListener(const std::string_view name, FdPoller &p);
+	~ShmListener();
+	PlatformUtil::Promise<std::unique_ptr<StreamSocket>> accept();
+};
+#endif
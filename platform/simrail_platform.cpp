@@ -309,6 +309,9 @@ void SimrailUiPlatform::present() {
 	if (!pending_atlas) {
 		ImGui::Render();
 		api::present(ImGui::GetDrawData());
+		// The host has taken the frame; a frame skipped while the atlas
+		// is rebuilt completes nothing
+		on_present_completed_list.fulfill_all();
 	}
 
 	if (pending_atlas) {
@@ -327,6 +330,10 @@ void SimrailUiPlatform::present() {
 	drawlist = ImGui::GetBackgroundDrawList();
 }
 
+Promise<void> SimrailUiPlatform::on_present_completed() {
+	return on_present_completed_list.create_and_add();
+}
+
 void SimrailUiPlatform::build_atlas() {
 	pending_atlas = std::make_unique<ImFontAtlas>();
 
@@ -24,7 +24,7 @@ private:
 		PlatformUtil::Promise<BasePlatform::BusSocket::ReceiveResult> receive() override;
 	};
 
-	std::vector<std::unique_ptr<PlatformUtil::TypeErasedFulfiller>> event_list;
+	PlatformUtil::DeferredQueue event_list;
 
 public:
 	SimrailBasePlatform();
@@ -89,6 +89,8 @@ private:
 	PlatformUtil::Promise<InputEvent> input_promise;
 	void handle_event(InputEvent ev);
 
+	PlatformUtil::FulfillerList<void> on_present_completed_list;
+
 	int last_volume;
 	int last_brightness;
 
@@ -167,6 +169,7 @@ public:
 	void draw_convex_polygon_filled(const std::vector<std::pair<float, float>> &poly) override;
 	PlatformUtil::Promise<void> on_present_request() override;
 	void present() override;
+	PlatformUtil::Promise<void> on_present_completed() override;
 	std::unique_ptr<Image> load_image(const std::string_view path) override;
 	std::unique_ptr<Font> load_font(float size, bool bold, const std::string_view lang) override;
 	std::unique_ptr<Image> make_text_image(const std::string_view text, const Font &font, Color c) override;
@@ -36,6 +36,7 @@ void TcpListener::close_socket() {
 	if (listen_fd == -1)
 		return;
 	promise = {};
+	poller.forget_fd(listen_fd);
 #ifdef _WIN32
 	closesocket(listen_fd);
 #else
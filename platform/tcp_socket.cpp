@@ -11,6 +11,10 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #else
 #include <winsock2.h>
@@ -24,6 +28,31 @@
 #define SHUT_WR SD_SEND
 #endif
 
+// Segments gathered into a single send call
+#define TX_MAX_SEGMENTS 64
+
+void StreamSocket::set_high_water_mark(size_t bytes) {
+	high_water_mark = bytes;
+	update_congestion(backlog_bytes);
+}
+
+PlatformUtil::Promise<void> StreamSocket::on_drain() {
+	PlatformUtil::Promise<void> promise = drain_list.create_and_add();
+	if (!congested)
+		drain_list.fulfill_all();
+	return promise;
+}
+
+void StreamSocket::update_congestion(size_t backlog) {
+	backlog_bytes = backlog;
+	if (congested && backlog <= high_water_mark / 2) {
+		congested = false;
+		drain_list.fulfill_all();
+	} else if (!congested && backlog > high_water_mark) {
+		congested = true;
+	}
+}
+
 void TcpSocket::mark_nonblocking(int fd) {
 	unsigned long one = 1;
 #ifdef _WIN32
@@ -42,6 +71,11 @@ void TcpSocket::close_socket() {
 		rx_list.push_data({});
 	if (!shut_wr)
 		shut_list.fulfill_all();
+	tx_queue.clear();
+	tx_bytes = 0;
+	tx_latency.discard();
+	update_congestion(0);
+	poller.forget_fd(peer_fd);
 #ifdef _WIN32
 	closesocket(peer_fd);
 #else
@@ -61,20 +95,64 @@ void TcpSocket::handle_error() {
 #endif
 }
 
+void TcpSocket::flush_tx() {
+#ifdef _WIN32
+	WSABUF bufs[TX_MAX_SEGMENTS];
+#else
+	iovec bufs[TX_MAX_SEGMENTS];
+#endif
+	int count = 0;
+	for (auto it = tx_queue.begin(); it != tx_queue.end() && count < TX_MAX_SEGMENTS; ++it, ++count) {
+		std::string_view d = it->data();
+#ifdef _WIN32
+		bufs[count].buf = (CHAR*)d.data();
+		bufs[count].len = d.size();
+#else
+		bufs[count].iov_base = (void*)d.data();
+		bufs[count].iov_len = d.size();
+#endif
+	}
+
+#ifdef _WIN32
+	DWORD sent;
+	ssize_t ret = WSASend(peer_fd, bufs, count, &sent, 0, nullptr, nullptr) == 0 ? (ssize_t)sent : -1;
+#else
+	msghdr msg = {};
+	msg.msg_iov = bufs;
+	msg.msg_iovlen = count;
+	ssize_t ret = sendmsg(peer_fd, &msg, MSG_NOSIGNAL);
+#endif
+	if (ret < 0) {
+		handle_error();
+		return;
+	}
+
+	size_t left = ret;
+	tx_bytes -= left;
+	tx_latency.written(left);
+	update_congestion(tx_bytes);
+	while (left > 0) {
+		TxSegment &seg = tx_queue.front();
+		size_t size = seg.data().size();
+		if (left < size) {
+			seg.offset += left;
+			break;
+		}
+		left -= size;
+		tx_queue.pop_front();
+	}
+}
+
 void TcpSocket::update() {
-	if (peer_fd != -1 && !tx_pending && (!tx_buffer.empty() || (shut_wrq && !shut_wr))) {
+	if (peer_fd != -1 && !tx_pending && (!tx_queue.empty() || (shut_wrq && !shut_wr))) {
 		tx_pending = true;
 		tx_promise = poller.on_fd_ready(peer_fd, POLLOUT).then([this](int rev) {
 			tx_pending = false;
 			if (rev & (POLLERR | POLLHUP)) {
 				close_socket();
 			} else if (peer_fd != -1 && (rev & POLLOUT)) {
-				if (!tx_buffer.empty()) {
-					ssize_t ret = ::send(peer_fd, tx_buffer.data(), tx_buffer.size(), MSG_NOSIGNAL);
-					if (ret < 0)
-						handle_error();
-					else
-						tx_buffer.erase(0, ret);
+				if (!tx_queue.empty()) {
+					flush_tx();
 				} else {
 					shut_wr = true;
 					shut_list.fulfill_all();
@@ -124,10 +202,29 @@ void TcpSocket::connect(const std::string_view hostname, int port) {
 	freeaddrinfo(res);
 }
 
+void TcpSocket::queued(size_t size) {
+	tx_bytes += size;
+	tx_latency.queued(size);
+	update_congestion(tx_bytes);
+	update();
+}
+
 void TcpSocket::send(const std::string_view data) {
-	if (!shut_wrq) {
-		tx_buffer += data;
-		update();
+	if (!shut_wrq && peer_fd != -1 && !data.empty()) {
+		// Only a segment that has not started sending grows, and only up
+		// to a cap, so that a steady stream still frees sent segments
+		if (tx_queue.empty() || tx_queue.back().frame || tx_queue.back().offset > 0 || tx_queue.back().owned.size() >= MAX_SEGMENT_SIZE)
+			tx_queue.push_back(TxSegment{ nullptr, {}, 0 });
+		tx_queue.back().owned += data;
+		queued(data.size());
+	}
+}
+
+void TcpSocket::send(Frame frame) {
+	if (!shut_wrq && peer_fd != -1 && frame && !frame->empty()) {
+		size_t size = frame->size();
+		tx_queue.push_back(TxSegment{ std::move(frame), {}, 0 });
+		queued(size);
 	}
 }
 
@@ -142,17 +239,24 @@ PlatformUtil::Promise<void> TcpSocket::on_shutdown() {
 	return shut_list.create_and_add();
 }
 
+void TcpSocket::set_nodelay(bool enable) {
+	if (peer_fd == -1)
+		return;
+	int flag = enable ? 1 : 0;
+	setsockopt(peer_fd, IPPROTO_TCP, TCP_NODELAY, (char*)&flag, sizeof(flag));
+}
+
 PlatformUtil::Promise<std::string> TcpSocket::receive() {
 	PlatformUtil::Promise<std::string> promise = rx_list.create_and_add();
 	update();
 	return std::move(promise);
 }
 
-TcpSocket::TcpSocket(const std::string_view hostname, int port, FdPoller &p) : poller(p), rx_pending(false), tx_pending(false), shut_rd(false), shut_wr(false), shut_wrq(false) {
+TcpSocket::TcpSocket(const std::string_view hostname, int port, FdPoller &p) : tx_bytes(0), poller(p), rx_pending(false), tx_pending(false), shut_rd(false), shut_wr(false), shut_wrq(false) {
 	connect(hostname, port);
 }
 
-TcpSocket::TcpSocket(int fd, FdPoller &p) : poller(p), rx_pending(false), tx_pending(false), shut_rd(false), shut_wr(false), shut_wrq(false) {
+TcpSocket::TcpSocket(int fd, FdPoller &p) : tx_bytes(0), poller(p), rx_pending(false), tx_pending(false), shut_rd(false), shut_wr(false), shut_wrq(false) {
 	peer_fd = fd;
 }
 
@@ -6,20 +6,82 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
 #include "platform.h"
+#include "bus_metrics.h"
 
 class FdPoller {
 public:
 	virtual PlatformUtil::Promise<short> on_fd_ready(int fd, short ev) = 0;
+	// Must be called before closing a descriptor passed to on_fd_ready
+	virtual void forget_fd(int fd) {}
 };
 
-class TcpSocket : private PlatformUtil::NoCopy
+// Reliable, ordered byte stream to a peer. An empty string from
+// receive() means that the peer has closed the connection.
+class StreamSocket : private PlatformUtil::NoCopy
 {
+public:
+	// Immutable buffer that can be queued on several sockets without copying
+	typedef std::shared_ptr<const std::string> Frame;
+
+	virtual ~StreamSocket() = default;
+	virtual void send(const std::string_view data) = 0;
+	virtual void send(Frame frame) = 0;
+	virtual PlatformUtil::Promise<std::string> receive() = 0;
+	// Bytes accepted by send() that the peer has not been handed yet
+	virtual size_t queued_bytes() const = 0;
+	// Time from send() until the data was handed to the peer
+	virtual const Log2Histogram &send_latency() const = 0;
+
+	// Once more than this many bytes are waiting to be sent, writable()
+	// turns false until the queue has drained to half of it. Sending is
+	// never refused; callers that care are expected to hold back.
+	void set_high_water_mark(size_t bytes);
+	bool writable() const { return !congested; }
+	// Fulfilled when writable() becomes true again, or the socket closes
+	PlatformUtil::Promise<void> on_drain();
+
+protected:
+	// Default for set_high_water_mark()
+	static constexpr size_t DEFAULT_HIGH_WATER_MARK = 1024 * 1024;
+
+	// To be called by implementations whenever their backlog changes
+	void update_congestion(size_t backlog);
+
 private:
+	PlatformUtil::FulfillerList<void> drain_list;
+	size_t high_water_mark = DEFAULT_HIGH_WATER_MARK;
+	size_t backlog_bytes = 0;
+	bool congested = false;
+};
+
+class TcpSocket final : public StreamSocket
+{
+private:
+	// Size above which data sent is queued in a new segment
+	static constexpr size_t MAX_SEGMENT_SIZE = 64 * 1024;
+
+	// Pending output is a chain of segments, either shared frames or a
+	// private buffer that small copied writes are appended to
+	struct TxSegment {
+		Frame frame;
+		std::string owned;
+		size_t offset;
+
+		std::string_view data() const {
+			std::string_view d = frame ? std::string_view(*frame) : std::string_view(owned);
+			return d.substr(offset);
+		}
+	};
+
 	int peer_fd;
 	PlatformUtil::FulfillerBufferedQueue<std::string> rx_list;
 	PlatformUtil::FulfillerList<void> shut_list;
-	std::string tx_buffer;
+	std::deque<TxSegment> tx_queue;
+	size_t tx_bytes;
+	SendLatency tx_latency;
 	PlatformUtil::Promise<short> rx_promise;
 	PlatformUtil::Promise<short> tx_promise;
 	bool rx_pending, tx_pending, shut_rd, shut_wr, shut_wrq;
@@ -28,14 +90,23 @@ private:
 	void mark_nonblocking(int fd);
 	void close_socket();
 	void handle_error();
+	void queued(size_t size);
+	void flush_tx();
 	void update();
 	void connect(const std::string_view hostname, int port);
 public:
 	TcpSocket(const std::string_view hostname, int port, FdPoller &p);
 	TcpSocket(int fd, FdPoller &p);
-	~TcpSocket();
-	void send(const std::string_view data);
+	~TcpSocket() override;
+	void send(const std::string_view data) override;
+	void send(Frame frame) override;
 	void shutdown();
 	PlatformUtil::Promise<void> on_shutdown();
-	PlatformUtil::Promise<std::string> receive();
+
+	size_t queued_bytes() const override { return tx_bytes; }
+	const Log2Histogram &send_latency() const override { return tx_latency.histogram(); }
+
+	// Disables Nagle's algorithm, for small latency-sensitive writes
+	void set_nodelay(bool enable);
+	PlatformUtil::Promise<std::string> receive() override;
 };
@@ -0,0 +1,223 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#include "timer_wheel.h"
+
+static inline uint32_t digit(int64_t t, int level) {
+	return ((uint64_t)t >> (level * 6)) & 63;
+}
+
+static inline uint32_t first_slot(uint64_t bits) {
+#ifdef __GNUC__
+	return __builtin_ctzll(bits);
+#else
+	uint32_t s = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		s++;
+	}
+	return s;
+#endif
+}
+
+static inline uint64_t slots_after(uint32_t d) {
+	return d == 63 ? 0 : ~(uint64_t)0 << (d + 1);
+}
+
+TimerWheel::TimerWheel() {
+	free_list = NIL;
+	for (int l = 0; l < LEVELS; l++) {
+		for (uint32_t s = 0; s < SLOTS; s++)
+			slots[l][s] = NIL;
+		occupied[l] = 0;
+	}
+	overflow = NIL;
+	current = 0;
+	count = 0;
+}
+
+uint32_t TimerWheel::allocate() {
+	if (free_list == NIL) {
+		uint32_t base = chunks.size() * CHUNK;
+		chunks.push_back(std::make_unique<Node[]>(CHUNK));
+		for (uint32_t i = CHUNK; i > 0; i--) {
+			chunks.back()[i - 1].next = free_list;
+			free_list = base + i - 1;
+		}
+	}
+	uint32_t i = free_list;
+	free_list = node(i).next;
+	count++;
+	return i;
+}
+
+void TimerWheel::release(uint32_t i) {
+	node(i).next = free_list;
+	free_list = i;
+	count--;
+}
+
+void TimerWheel::insert(uint32_t i) {
+	Node &n = node(i);
+	int64_t t = n.expiry < current ? current : n.expiry;
+	for (int l = 0; l < LEVELS; l++) {
+		int shift = (l + 1) * LEVEL_BITS;
+		if (((uint64_t)t >> shift) == ((uint64_t)current >> shift)) {
+			uint32_t s = digit(t, l);
+			n.next = slots[l][s];
+			slots[l][s] = i;
+			occupied[l] |= (uint64_t)1 << s;
+			return;
+		}
+	}
+	n.next = overflow;
+	overflow = i;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot) {
+	uint32_t i = slots[level][slot];
+	slots[level][slot] = NIL;
+	occupied[level] &= ~((uint64_t)1 << slot);
+	while (i != NIL) {
+		uint32_t next = node(i).next;
+		insert(i);
+		i = next;
+	}
+}
+
+void TimerWheel::reinsert_overflow() {
+	uint32_t i = overflow;
+	overflow = NIL;
+	while (i != NIL) {
+		uint32_t next = node(i).next;
+		insert(i);
+		i = next;
+	}
+}
+
+void TimerWheel::fire_current(int64_t now) {
+	uint32_t s = digit(current, 0);
+	uint32_t i = slots[0][s];
+	slots[0][s] = NIL;
+	occupied[0] &= ~((uint64_t)1 << s);
+	// Callbacks may schedule new timers, so the list is detached first and
+	// every node is recycled before its callback runs
+	while (i != NIL) {
+		Node &n = node(i);
+		uint32_t next = n.next;
+		PlatformUtil::Fulfiller<void> f = std::move(n.fulfiller);
+		int64_t lateness = now - n.expiry;
+		release(i);
+		if (f.is_pending()) {
+			counters.fired++;
+			counters.last_lateness = lateness;
+			counters.total_lateness += lateness;
+			if (lateness > counters.max_lateness)
+				counters.max_lateness = lateness;
+			f.fulfill(false);
+		} else {
+			counters.cancelled++;
+		}
+		i = next;
+	}
+}
+
+int64_t TimerWheel::next_event() const {
+	int64_t best = -1;
+	for (int l = 0; l < LEVELS; l++) {
+		uint64_t bits = occupied[l] & slots_after(digit(current, l));
+		if (bits == 0)
+			continue;
+		uint64_t high = ~(((uint64_t)1 << ((l + 1) * LEVEL_BITS)) - 1);
+		int64_t t = ((uint64_t)current & high) | ((uint64_t)first_slot(bits) << (l * LEVEL_BITS));
+		if (best < 0 || t < best)
+			best = t;
+	}
+	if (overflow != NIL) {
+		int64_t t = ((uint64_t)current | (((uint64_t)1 << (LEVELS * LEVEL_BITS)) - 1)) + 1;
+		if (best < 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+PlatformUtil::Promise<void> TimerWheel::delay(int64_t now, int ms) {
+	if (count == 0 && now > current)
+		current = now;
+	auto pair = PlatformUtil::PromiseFactory::create<void>();
+	uint32_t i = allocate();
+	Node &n = node(i);
+	n.fulfiller = std::move(pair.second);
+	n.expiry = now + ms;
+	insert(i);
+	return std::move(pair.first);
+}
+
+bool TimerWheel::advance(int64_t now) {
+	uint64_t before = counters.fired + counters.cancelled;
+	while (count > 0) {
+		if (overflow != NIL && ((uint64_t)current & (((uint64_t)1 << (LEVELS * LEVEL_BITS)) - 1)) == 0)
+			reinsert_overflow();
+		for (int l = LEVELS - 1; l > 0; l--) {
+			if (((uint64_t)current & (((uint64_t)1 << (l * LEVEL_BITS)) - 1)) == 0 && (occupied[l] & ((uint64_t)1 << digit(current, l))))
+				cascade(l, digit(current, l));
+		}
+		fire_current(now);
+
+		int64_t next = next_event();
+		if (next < 0 || next > now)
+			next = now;
+		if (next <= current)
+			break;
+		// Timers scheduled from callbacks at or before the current time are
+		// still in the current slot, and must follow the wheel to its new position
+		uint32_t s = digit(current, 0);
+		uint32_t i = slots[0][s];
+		slots[0][s] = NIL;
+		occupied[0] &= ~((uint64_t)1 << s);
+		current = next;
+		while (i != NIL) {
+			uint32_t n = node(i).next;
+			insert(i);
+			i = n;
+		}
+	}
+	if (count == 0 && now > current)
+		current = now;
+	return counters.fired + counters.cancelled != before;
+}
+
+int64_t TimerWheel::next_expiry() const {
+	if (count == 0)
+		return -1;
+	if (occupied[0] & ((uint64_t)1 << digit(current, 0)))
+		return current;
+	return next_event();
+}
+
+void TimerWheel::clear() {
+	auto drop = [this](uint32_t i) {
+		while (i != NIL) {
+			uint32_t next = node(i).next;
+			{
+				PlatformUtil::Fulfiller<void> f = std::move(node(i).fulfiller);
+			}
+			release(i);
+			i = next;
+		}
+	};
+	for (int l = 0; l < LEVELS; l++) {
+		for (uint32_t s = 0; s < SLOTS; s++) {
+			uint32_t i = slots[l][s];
+			slots[l][s] = NIL;
+			drop(i);
+		}
+		occupied[l] = 0;
+	}
+	uint32_t i = overflow;
+	overflow = NIL;
+	drop(i);
+}
@@ -0,0 +1,66 @@
+ /*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "platform.h"
+
+// Hierarchical timer wheel with millisecond resolution. Four levels of 64
+// slots cover about 4.6 hours; later timers wait in an overflow list that
+// is looked at again each time the whole wheel turns over. Timers live in
+// pooled nodes, so scheduling one does not allocate once the pool has grown.
+// Dropping the returned promise cancels the timer: its node is recycled
+// without being called when its slot comes up.
+class TimerWheel : private PlatformUtil::NoCopy {
+public:
+	typedef BasePlatform::TimerStats Stats;
+
+private:
+	static constexpr int LEVEL_BITS = 6;
+	static constexpr int LEVELS = 4;
+	static constexpr uint32_t SLOTS = 1 << LEVEL_BITS;
+	static constexpr uint32_t CHUNK = 64;
+	static constexpr uint32_t NIL = UINT32_MAX;
+
+	struct Node {
+		PlatformUtil::Fulfiller<void> fulfiller;
+		int64_t expiry;
+		uint32_t next;
+	};
+
+	std::vector<std::unique_ptr<Node[]>> chunks;
+	uint32_t free_list;
+	uint32_t slots[LEVELS][SLOTS];
+	uint64_t occupied[LEVELS];
+	uint32_t overflow;
+	int64_t current;
+	size_t count;
+	Stats counters;
+
+	Node& node(uint32_t i) { return chunks[i / CHUNK][i % CHUNK]; }
+	uint32_t allocate();
+	void release(uint32_t i);
+	void insert(uint32_t i);
+	void cascade(int level, uint32_t slot);
+	void reinsert_overflow();
+	void fire_current(int64_t now);
+	int64_t next_event() const;
+
+public:
+	TimerWheel();
+
+	PlatformUtil::Promise<void> delay(int64_t now, int ms);
+	// Fires every timer due at now, in expiry order. Returns false if none was due.
+	bool advance(int64_t now);
+	// Time at which advance() next needs to be called, or -1 if no timer is pending
+	int64_t next_expiry() const;
+	size_t pending() const { return count; }
+	void clear();
+	const Stats& stats() const { return counters; }
+};
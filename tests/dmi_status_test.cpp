@@ -0,0 +1,128 @@
+/*
+ * European Train Control System
+ * Copyright (C) 2019-2023  César Benito <cesarbema2009@hotmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include "dmi_status.h"
+static int failures = 0;
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+// Positions along the line of the elements in the lists
+static const double speed_positions[] = {0, 1200, 2500, 4000};
+static const double gradient_positions[] = {0, 800, 1500, 3100};
+static const double condition_positions[] = {900, 2200};
+// Status of a train whose front is at the given odometer reading
+static dmi_status status_at(double front, uint32_t id)
+{
+    dmi_status s;
+    s.update_id = id;
+    s.allowed_speed = 44.4;
+    s.intervention_speed = 46.1;
+    s.target_speed = 22.2;
+    s.speed = 40;
+    s.target_distance = 1200 - front;
+    s.mode = 3;
+    s.level = 3;
+    s.list_origin = front;
+    for (double p : speed_positions)
+        s.speed_targets.push_back({p > front ? p - front : 0, 30 + p / 100});
+    for (double p : gradient_positions)
+        s.gradients.push_back({p > front ? p - front : 0, (int)(p / 100) - 10});
+    // Passed track conditions are still sent, behind the front
+    for (double p : condition_positions)
+        s.track_conditions.push_back({p - front, 3, p > 2000, 0});
+    s.active_track_conditions = {5, 7};
+    return s;
+}
+// Whole metres, as the encoding keeps them
+static bool same_distance(double a, double b)
+{
+    return std::abs(a - b) <= 0.5;
+}
+static void check_equal(const dmi_status &a, const dmi_status &b)
+{
+    CHECK(a.update_id == b.update_id);
+    CHECK(a.allowed_speed == b.allowed_speed);
+    CHECK(a.target_speed == b.target_speed);
+    CHECK(a.mode == b.mode);
+    CHECK(a.list_origin == b.list_origin);
+    CHECK(a.speed_targets.size() == b.speed_targets.size());
+    for (size_t i = 0; i < a.speed_targets.size() && i < b.speed_targets.size(); i++) {
+        CHECK(same_distance(a.speed_targets[i].distance, b.speed_targets[i].distance));
+        CHECK(a.speed_targets[i].speed == b.speed_targets[i].speed);
+    }
+    CHECK(a.gradients.size() == b.gradients.size());
+    for (size_t i = 0; i < a.gradients.size() && i < b.gradients.size(); i++) {
+        CHECK(same_distance(a.gradients[i].distance, b.gradients[i].distance));
+        CHECK(a.gradients[i].value == b.gradients[i].value);
+    }
+    CHECK(a.track_conditions.size() == b.track_conditions.size());
+    for (size_t i = 0; i < a.track_conditions.size() && i < b.track_conditions.size(); i++) {
+        CHECK(same_distance(a.track_conditions[i].distance, b.track_conditions[i].distance));
+        CHECK(a.track_conditions[i].yellow == b.track_conditions[i].yellow);
+    }
+    CHECK(a.active_track_conditions == b.active_track_conditions);
+}
+int main()
+{
+    dmi_status_encoder encoder;
+    dmi_status_decoder decoder;
+    dmi_status decoded;
+
+    // The first message carries every list
+    std::string first = encoder.encode(status_at(100, 1));
+    CHECK(decoder.decode(first, decoded));
+    check_equal(status_at(100, 1), decoded);
+
+    // While the train runs, list positions stay put and only the scalar
+    // part is sent again
+    size_t moving_size = 0;
+    for (int i = 1; i <= 50; i++) {
+        double front = 100 + 11.3 * i;
+        dmi_status s = status_at(front, 1 + i);
+        std::string data = encoder.encode(s);
+        CHECK(decoder.decode(data, decoded));
+        check_equal(s, decoded);
+        if (i == 1)
+            moving_size = data.size();
+        CHECK(data.size() == moving_size);
+    }
+    CHECK(moving_size < first.size());
+
+    // Passing an element changes its list, which is then sent in full
+    dmi_status passed = status_at(850, 100);
+    std::string data = encoder.encode(passed);
+    CHECK(data.size() > moving_size);
+    CHECK(decoder.decode(data, decoded));
+    check_equal(passed, decoded);
+
+    // Elements behind the front stay behind it, even just behind
+    dmi_status close = status_at(899.8, 102);
+    CHECK(decoder.decode(encoder.encode(close), decoded));
+    CHECK(decoded.track_conditions[0].distance > 0);
+    close = status_at(900.2, 103);
+    CHECK(decoder.decode(encoder.encode(close), decoded));
+    CHECK(decoded.track_conditions[0].distance < 0);
+    CHECK(decoded.speed_targets[0].distance == 0);
+
+    // A new decoder needs every list again
+    dmi_status_decoder late;
+    encoder.reset();
+    dmi_status s = status_at(900, 101);
+    CHECK(late.decode(encoder.encode(s), decoded));
+    check_equal(s, decoded);
+
+    // Messages from another version or cut short are refused
+    std::string other = encoder.encode(s);
+    other[0]++;
+    CHECK(!late.decode(other, decoded));
+    CHECK(!late.decode(first.substr(0, first.size() - 5), decoded));
+
+    printf("first message %zu bytes, moving train %zu bytes\n", first.size(), moving_size);
+    return failures != 0;
+}